@@ -38,8 +38,12 @@
 #include <cmath>
 #include <algorithm>
 #include <vector>
-#include <cfloat>
+#include <cstring>
+#include <new>
 #include "AE_EffectPixelFormat.h"
+#include "ReptAll_Instances.h"
+#include "ReptAll_Source.h"
+#include "ReptAll_TransformCache.h"
 
 #ifdef _MSC_VER
 // Suppress C4984: 'if constexpr' is a C++17 language extension
@@ -62,87 +66,6 @@
 #define M_PI 3.14159265358979323846
 #endif
 
-// Maximum copy count to prevent performance issues
-#define MAX_COPIES 1000
-
-// Precomputed transform parameters for optimization
-struct TransformParams {
-	PF_FpLong centerX;
-	PF_FpLong centerY;
-	PF_FpLong translateX;
-	PF_FpLong translateY;
-	PF_FpLong cosZ;      // Precomputed cosine
-	PF_FpLong sinZ;      // Precomputed sine
-	PF_FpLong scale;     // Scale factor (1.0 = 100%)
-};
-
-// Template for bilinear sampling - eliminates code duplication
-// Use integer template parameter to avoid C++20 requirement
-template<typename PixelType, int MaxChannelInt>
-static PixelType
-SampleBilinearTmpl(
-	PF_EffectWorld *srcP,
-	PF_FpLong x,
-	PF_FpLong y)
-{
-	PixelType result = {0, 0, 0, 0};
-
-	if (x < 0 || y < 0 || x >= srcP->width - 1 || y >= srcP->height - 1) {
-		return result;
-	}
-
-	A_long x0 = (A_long)x;
-	A_long y0 = (A_long)y;
-	A_long x1 = x0 + 1;
-	A_long y1 = y0 + 1;
-
-	PF_FpLong fx = x - x0;
-	PF_FpLong fy = y - y0;
-
-	// Check for zero width/height
-	if (srcP->width <= 0 || srcP->height <= 0) {
-		return result;
-	}
-
-	// Overflow protection for rowbytes calculation
-	// Use multiplication to detect overflow: if y * rowbytes > LONG_MAX
-	if (srcP->rowbytes > 0 && ((y0 > LONG_MAX / srcP->rowbytes) || (y1 > LONG_MAX / srcP->rowbytes))) {
-		return result;
-	}
-
-	PixelType *row0 = (PixelType*)((char*)srcP->data + y0 * srcP->rowbytes);
-	PixelType *row1 = (PixelType*)((char*)srcP->data + y1 * srcP->rowbytes);
-
-	PixelType p00 = row0[x0];
-	PixelType p10 = row0[x1];
-	PixelType p01 = row1[x0];
-	PixelType p11 = row1[x1];
-
-	// Bilinear interpolation weights
-	PF_FpLong w00 = (1.0 - fx) * (1.0 - fy);
-	PF_FpLong w10 = fx * (1.0 - fy);
-	PF_FpLong w01 = (1.0 - fx) * fy;
-	PF_FpLong w11 = fx * fy;
-
-	// Apply interpolation
-	// MaxChannelInt == 1 indicates float (1.0), other values indicate integer
-	if constexpr (MaxChannelInt == 1) {
-		// Float: no rounding, no clamping needed
-		result.alpha = p00.alpha * w00 + p10.alpha * w10 + p01.alpha * w01 + p11.alpha * w11;
-		result.red   = p00.red * w00 + p10.red * w10 + p01.red * w01 + p11.red * w11;
-		result.green = p00.green * w00 + p10.green * w10 + p01.green * w01 + p11.green * w11;
-		result.blue  = p00.blue * w00 + p10.blue * w10 + p01.blue * w01 + p11.blue * w11;
-	} else {
-		// Integer: round and clamp
-		result.alpha = (decltype(result.alpha))(p00.alpha * w00 + p10.alpha * w10 + p01.alpha * w01 + p11.alpha * w11 + 0.5);
-		result.red   = (decltype(result.red))(p00.red * w00 + p10.red * w10 + p01.red * w01 + p11.red * w11 + 0.5);
-		result.green = (decltype(result.green))(p00.green * w00 + p10.green * w10 + p01.green * w01 + p11.green * w11 + 0.5);
-		result.blue  = (decltype(result.blue))(p00.blue * w00 + p10.blue * w10 + p01.blue * w01 + p11.blue * w11 + 0.5);
-	}
-
-	return result;
-}
-
 static PF_Err 
 About (	
 	PF_InData		*in_data,
@@ -176,16 +99,56 @@ GlobalSetup (
 										STAGE_VERSION, 
 										BUILD_VERSION);
 
-	out_data->out_flags =  PF_OutFlag_DEEP_COLOR_AWARE;
+	// Motion blur follows the comp shutter; params and the camera are read at
+	// shutter open and close, and AE derives the time span from those checkouts
+	// PiPL flags (0x06080002): WIDE_TIME_INPUT | I_USE_SHUTTER_ANGLE |
+	//                          DEEP_COLOR_AWARE | FLOAT_COLOR_AWARE
+	out_data->out_flags =  PF_OutFlag_DEEP_COLOR_AWARE |
+						   PF_OutFlag_WIDE_TIME_INPUT |
+						   PF_OutFlag_I_USE_SHUTTER_ANGLE;
 	
 	// 3D camera/light support - always enabled
-	// PiPL flags (0x1400): I_USE_3D_CAMERA | I_USE_3D_LIGHTS
+	// SmartFX lets us return a result rect covering only the visible copies
+	// Multi-Frame Rendering: the render pipeline keeps no sequence state.
+	// Process-wide state shared by concurrent renders:
+	//   transform cache (ReptAll_TransformCache.cpp)   - g_cacheMutex
+	//   source coverage LRU (ReptAll_Source.cpp)        - g_coverageMutex
+	//   instance arena pool (ReptAll_Instances.cpp)     - g_poolMutex
+	//   trace file appends (ReptAll_Stats.cpp)          - g_traceMutex
+	//   SIMD kernel choice and stats flags from the environment
+	//                                                   - magic statics, read once
+	// Cached transforms and coverage are handed out as shared pointers and
+	// never modified once stored; everything else is per render.
+	// PiPL flags (0x08021406): I_USE_3D_CAMERA | I_USE_3D_LIGHTS |
+	//                          SUPPORTS_SMART_RENDER | FLOAT_COLOR_AWARE |
+	//                          AUTOMATIC_WIDE_TIME_INPUT |
+	//                          SUPPORTS_THREADED_RENDERING
 	out_data->out_flags2 = PF_OutFlag2_I_USE_3D_CAMERA |
-						   PF_OutFlag2_I_USE_3D_LIGHTS;
+						   PF_OutFlag2_I_USE_3D_LIGHTS |
+						   PF_OutFlag2_SUPPORTS_SMART_RENDER |
+						   PF_OutFlag2_FLOAT_COLOR_AWARE |
+						   PF_OutFlag2_AUTOMATIC_WIDE_TIME_INPUT |
+						   PF_OutFlag2_SUPPORTS_THREADED_RENDERING;
 	
 	return PF_Err_NONE;
 }
 
+static PF_Err 
+GlobalSetdown (	
+	PF_InData		*in_data,
+	PF_OutData		*out_data,
+	PF_ParamDef		*params[],
+	PF_LayerDef		*output )
+{
+	// Release cached transforms, source coverage and pooled instance arenas
+	// when the plug-in is unloaded
+	ClearTransformCache();
+	ClearSourceCoverageCache();
+	ReleaseCopyInstancePool();
+
+	return PF_Err_NONE;
+}
+
 static PF_Err 
 ParamsSetup (	
 	PF_InData		*in_data,
@@ -202,7 +165,7 @@ ParamsSetup (
 					REPTALL_COUNT_MIN, 
 					REPTALL_COUNT_MAX, 
 					REPTALL_COUNT_MIN, 
-					REPTALL_COUNT_MAX, 
+					REPTALL_COUNT_SLIDER_MAX, 
 					REPTALL_COUNT_DFLT,
 					COPIES_X_DISK_ID);
 
@@ -297,153 +260,280 @@ ParamsSetup (
 							PF_ValueDisplayFlag_PERCENT,
 							STEP_SCALE_DISK_ID);
 
-	out_data->num_params = REPTALL_NUM_PARAMS;
-	
-	return err;
-}
+	// Front to Back - Normal blend composites the nearest copy first and
+	// stops sampling pixels once they are opaque
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_CHECKBOX(	STR(StrID_FrontToBack_Param_Name),
+						STR(StrID_FrontToBack_Checkbox),
+						REPTALL_FRONT_TO_BACK_DFLT,
+						0,
+						FRONT_TO_BACK_DISK_ID);
 
-// Optimized 2D affine transformation with precomputed cos/sin
-inline static void
-ApplyTransform2DOptimized(
-	PF_FpLong srcX,
-	PF_FpLong srcY,
-	const TransformParams& params,
-	PF_FpLong *dstX,
-	PF_FpLong *dstY)
-{
-	// Translate to origin
-	PF_FpLong x = srcX - params.centerX;
-	PF_FpLong y = srcY - params.centerY;
+	// Random group
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_TOPIC(	STR(StrID_Random_Topic_Name),
+					RANDOM_TOPIC_DISK_ID);
 
-	// Apply rotation (using precomputed cos/sin)
-	PF_FpLong rx = x * params.cosZ - y * params.sinZ;
-	PF_FpLong ry = x * params.sinZ + y * params.cosZ;
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_SLIDER(	STR(StrID_RandomSeed_Param_Name),
+					REPTALL_SEED_MIN,
+					REPTALL_SEED_MAX,
+					REPTALL_SEED_MIN,
+					REPTALL_SEED_SLIDER_MAX,
+					REPTALL_SEED_DFLT,
+					RANDOM_SEED_DISK_ID);
 
-	// Apply scale
-	rx *= params.scale;
-	ry *= params.scale;
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_FLOAT_SLIDERX(	STR(StrID_RandomStrength_Param_Name),
+							REPTALL_PERCENT_MIN,
+							REPTALL_PERCENT_MAX,
+							REPTALL_PERCENT_MIN,
+							REPTALL_PERCENT_MAX,
+							REPTALL_PERCENT_MAX,
+							PF_Precision_TENTHS,
+							0,
+							PF_ValueDisplayFlag_PERCENT,
+							RANDOM_STRENGTH_DISK_ID);
 
-	// Translate back + apply translation offset
-	*dstX = rx + params.centerX + params.translateX;
-	*dstY = ry + params.centerY + params.translateY;
-}
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_POPUP(	STR(StrID_RandomDistribution_Param_Name),
+					DISTRIBUTION_POPUP_COUNT,
+					DISTRIBUTION_POPUP_CENTERED,
+					STR(StrID_RandomDistribution_Choices),
+					RANDOM_DISTRIBUTION_DISK_ID);
 
-// Wrapper functions for template-based bilinear sampling
-static PF_Pixel
-SampleBilinear8(PF_EffectWorld *srcP, PF_FpLong x, PF_FpLong y) {
-	return SampleBilinearTmpl<PF_Pixel, PF_MAX_CHAN8>(srcP, x, y);
-}
+	// Fields - where the effectors act
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_TOPIC(	STR(StrID_Fields_Topic_Name),
+					FIELDS_TOPIC_DISK_ID);
 
-static PF_Pixel16
-SampleBilinear16(PF_EffectWorld *srcP, PF_FpLong x, PF_FpLong y) {
-	return SampleBilinearTmpl<PF_Pixel16, PF_MAX_CHAN16>(srcP, x, y);
-}
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_TOPIC(	STR(StrID_SpatialField_Topic_Name),
+					SPATIAL_FIELD_TOPIC_DISK_ID);
 
-// Alpha-over compositing for 8-bit (premultiplied alpha)
-static void
-CompositePremult8(
-	PF_Pixel *dstP,
-	const PF_Pixel *srcP)
-{
-	if (srcP->alpha == 0) return;
-	if (srcP->alpha == PF_MAX_CHAN8) {
-		*dstP = *srcP;
-		return;
-	}
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_POPUP(	STR(StrID_FieldType_Param_Name),
+					FIELD_SHAPE_POPUP_COUNT,
+					FIELD_SHAPE_POPUP_NONE,
+					STR(StrID_SpatialFieldType_Choices),
+					SPATIAL_FIELD_TYPE_DISK_ID);
 
-	// Alpha-over: dst = src + dst * (1 - srcAlpha)
-	PF_FpLong srcA = srcP->alpha / (PF_FpLong)PF_MAX_CHAN8;
-	// Clamp srcA to prevent negative values
-	if (srcA < 0.0) srcA = 0.0;
-	if (srcA > 1.0) srcA = 1.0;
-	PF_FpLong oneMinusSrcA = 1.0 - srcA;
-
-	// Validate finite values
-	if (!std::isfinite(oneMinusSrcA)) oneMinusSrcA = 0.0;
-
-	PF_FpLong newAlpha = srcP->alpha + dstP->alpha * oneMinusSrcA;
-	PF_FpLong newRed = srcP->red + dstP->red * oneMinusSrcA;
-	PF_FpLong newGreen = srcP->green + dstP->green * oneMinusSrcA;
-	PF_FpLong newBlue = srcP->blue + dstP->blue * oneMinusSrcA;
-
-	// Clamp to valid range
-	dstP->alpha = (A_u_char)MIN(MAX(newAlpha + 0.5, 0.0), PF_MAX_CHAN8);
-	dstP->red   = (A_u_char)MIN(MAX(newRed + 0.5, 0.0), PF_MAX_CHAN8);
-	dstP->green = (A_u_char)MIN(MAX(newGreen + 0.5, 0.0), PF_MAX_CHAN8);
-	dstP->blue  = (A_u_char)MIN(MAX(newBlue + 0.5, 0.0), PF_MAX_CHAN8);
-}
+	for (int i = 0; i < 3; i++) {
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_FLOAT_SLIDERX(	STR(StrID_FieldCenterX_Param_Name + i),
+								REPTALL_FIELD_CENTER_MIN,
+								REPTALL_FIELD_CENTER_MAX,
+								-REPTALL_FIELD_CENTER_SLIDER_MAX,
+								REPTALL_FIELD_CENTER_SLIDER_MAX,
+								0.0,
+								PF_Precision_TENTHS,
+								0,
+								0,
+								SPATIAL_FIELD_CENTER_X_DISK_ID + i);
+	}
 
-// Alpha-over compositing for 16-bit (premultiplied alpha)
-static void
-CompositePremult16(
-	PF_Pixel16 *dstP,
-	const PF_Pixel16 *srcP)
-{
-	if (srcP->alpha == 0) return;
-	if (srcP->alpha == PF_MAX_CHAN16) {
-		*dstP = *srcP;
-		return;
+	for (int i = 0; i < 3; i++) {
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_FLOAT_SLIDERX(	STR(StrID_FieldSizeX_Param_Name + i),
+								REPTALL_FIELD_SIZE_MIN,
+								REPTALL_FIELD_SIZE_MAX,
+								REPTALL_FIELD_SIZE_MIN,
+								REPTALL_FIELD_SIZE_SLIDER_MAX,
+								REPTALL_FIELD_SIZE_DFLT,
+								PF_Precision_TENTHS,
+								0,
+								0,
+								SPATIAL_FIELD_SIZE_X_DISK_ID + i);
 	}
 
-	PF_FpLong srcA = srcP->alpha / (PF_FpLong)PF_MAX_CHAN16;
-	// Clamp srcA to prevent negative values
-	if (srcA < 0.0) srcA = 0.0;
-	if (srcA > 1.0) srcA = 1.0;
-	PF_FpLong oneMinusSrcA = 1.0 - srcA;
-
-	// Validate finite values
-	if (!std::isfinite(oneMinusSrcA)) oneMinusSrcA = 0.0;
-
-	PF_FpLong newAlpha = srcP->alpha + dstP->alpha * oneMinusSrcA;
-	PF_FpLong newRed = srcP->red + dstP->red * oneMinusSrcA;
-	PF_FpLong newGreen = srcP->green + dstP->green * oneMinusSrcA;
-	PF_FpLong newBlue = srcP->blue + dstP->blue * oneMinusSrcA;
-
-	// Clamp to valid range
-	dstP->alpha = (A_u_short)MIN(MAX(newAlpha + 0.5, 0.0), PF_MAX_CHAN16);
-	dstP->red   = (A_u_short)MIN(MAX(newRed + 0.5, 0.0), PF_MAX_CHAN16);
-	dstP->green = (A_u_short)MIN(MAX(newGreen + 0.5, 0.0), PF_MAX_CHAN16);
-	dstP->blue  = (A_u_short)MIN(MAX(newBlue + 0.5, 0.0), PF_MAX_CHAN16);
-}
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_POPUP(	STR(StrID_FieldCurve_Param_Name),
+					FIELD_CURVE_POPUP_COUNT,
+					FIELD_CURVE_POPUP_EASE_IN_OUT,
+					STR(StrID_FieldCurve_Choices),
+					SPATIAL_FIELD_CURVE_DISK_ID);
 
-// Wrapper for 32-bit Float
-static PF_PixelFloat
-SampleBilinearFloat(PF_EffectWorld *srcP, PF_FpLong x, PF_FpLong y) {
-	return SampleBilinearTmpl<PF_PixelFloat, 1>(srcP, x, y);
-}
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_CHECKBOX(	STR(StrID_FieldInvert_Param_Name),
+						STR(StrID_FieldInvert_Checkbox),
+						FALSE,
+						0,
+						SPATIAL_FIELD_INVERT_DISK_ID);
 
-// Alpha-over compositing for 32-bit Float (premultiplied alpha)
-static void
-CompositePremultFloat(
-	PF_PixelFloat *dstP,
-	const PF_PixelFloat *srcP)
-{
-	if (srcP->alpha <= 0.0) return;
-	if (srcP->alpha >= 1.0) {
-		*dstP = *srcP;
-		return;
+	AEFX_CLR_STRUCT(def);
+	PF_END_TOPIC(SPATIAL_FIELD_TOPIC_END_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_TOPIC(	STR(StrID_IndexField_Topic_Name),
+					INDEX_FIELD_TOPIC_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_POPUP(	STR(StrID_FieldType_Param_Name),
+					FIELD_INDEX_POPUP_COUNT,
+					FIELD_INDEX_POPUP_NONE,
+					STR(StrID_IndexFieldType_Choices),
+					INDEX_FIELD_TYPE_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_FLOAT_SLIDERX(	STR(StrID_FieldStart_Param_Name),
+							REPTALL_PERCENT_MIN,
+							REPTALL_PERCENT_MAX,
+							REPTALL_PERCENT_MIN,
+							REPTALL_PERCENT_MAX,
+							REPTALL_PERCENT_MIN,
+							PF_Precision_TENTHS,
+							0,
+							PF_ValueDisplayFlag_PERCENT,
+							INDEX_FIELD_START_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_FLOAT_SLIDERX(	STR(StrID_FieldEnd_Param_Name),
+							REPTALL_PERCENT_MIN,
+							REPTALL_PERCENT_MAX,
+							REPTALL_PERCENT_MIN,
+							REPTALL_PERCENT_MAX,
+							REPTALL_PERCENT_MAX,
+							PF_Precision_TENTHS,
+							0,
+							PF_ValueDisplayFlag_PERCENT,
+							INDEX_FIELD_END_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_POPUP(	STR(StrID_FieldCurve_Param_Name),
+					FIELD_CURVE_POPUP_COUNT,
+					FIELD_CURVE_POPUP_EASE_IN_OUT,
+					STR(StrID_FieldCurve_Choices),
+					INDEX_FIELD_CURVE_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_END_TOPIC(INDEX_FIELD_TOPIC_END_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_ADD_POPUP(	STR(StrID_FieldCombine_Param_Name),
+					FIELD_COMBINE_POPUP_COUNT,
+					FIELD_COMBINE_POPUP_MULTIPLY,
+					STR(StrID_FieldCombine_Choices),
+					FIELD_COMBINE_DISK_ID);
+
+	AEFX_CLR_STRUCT(def);
+	PF_END_TOPIC(FIELDS_TOPIC_END_DISK_ID);
+
+	// Effector groups. Every effector starts off, so projects saved before
+	// the group existed render unchanged; Effector 1's amounts are the
+	// PARAMETER_SPEC.md starting point for when it is switched on.
+	for (A_long e = 0; e < REPTALL_EFFECTOR_COUNT && !err; e++) {
+		const A_long diskId = EFFECTOR_1_DISK_ID + e * EFFECTOR_PARAM_COUNT;
+		const PF_FpLong positionDflt[3] = {e == 0 ? 30.0 : 0.0, 0.0, 0.0};
+		const PF_FpLong rotationDflt[3] = {0.0, e == 0 ? 20.0 : 0.0, 0.0};
+
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_TOPIC(	STR(StrID_Effector1_Topic_Name + e),
+						diskId + EFFECTOR_TOPIC);
+
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_CHECKBOX(	STR(StrID_EffectorEnable_Param_Name),
+							STR(StrID_EffectorEnable_Checkbox),
+							FALSE,
+							0,
+							diskId + EFFECTOR_ENABLE);
+
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_FLOAT_SLIDERX(	STR(StrID_EffectorStrength_Param_Name),
+								REPTALL_PERCENT_MIN,
+								REPTALL_PERCENT_MAX,
+								REPTALL_PERCENT_MIN,
+								REPTALL_PERCENT_MAX,
+								REPTALL_PERCENT_MAX,
+								PF_Precision_TENTHS,
+								0,
+								PF_ValueDisplayFlag_PERCENT,
+								diskId + EFFECTOR_STRENGTH);
+
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_SLIDER(	STR(StrID_EffectorSeedOffset_Param_Name),
+						REPTALL_SEED_MIN,
+						REPTALL_SEED_MAX,
+						REPTALL_SEED_MIN,
+						REPTALL_SEED_SLIDER_MAX,
+						e * REPTALL_SEED_OFFSET_STEP,
+						diskId + EFFECTOR_SEED_OFFSET);
+
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_FLOAT_SLIDERX(	STR(StrID_EffectorProbability_Param_Name),
+								REPTALL_PERCENT_MIN,
+								REPTALL_PERCENT_MAX,
+								REPTALL_PERCENT_MIN,
+								REPTALL_PERCENT_MAX,
+								REPTALL_PERCENT_MAX,
+								PF_Precision_TENTHS,
+								0,
+								PF_ValueDisplayFlag_PERCENT,
+								diskId + EFFECTOR_PROBABILITY);
+
+		for (int i = 0; i < 3; i++) {
+			AEFX_CLR_STRUCT(def);
+			PF_ADD_FLOAT_SLIDERX(	STR(StrID_EffectorPositionX_Param_Name + i),
+									REPTALL_TRANSLATE_MIN,
+									REPTALL_TRANSLATE_MAX,
+									REPTALL_TRANSLATE_MIN,
+									REPTALL_TRANSLATE_MAX,
+									positionDflt[i],
+									PF_Precision_TENTHS,
+									0,
+									0,
+									diskId + EFFECTOR_POSITION_X + i);
+		}
+
+		for (int i = 0; i < 3; i++) {
+			AEFX_CLR_STRUCT(def);
+			PF_ADD_FLOAT_SLIDERX(	STR(StrID_EffectorRotationX_Param_Name + i),
+									REPTALL_ROTATE_MIN,
+									REPTALL_ROTATE_MAX,
+									REPTALL_ROTATE_MIN,
+									REPTALL_ROTATE_MAX,
+									rotationDflt[i],
+									PF_Precision_TENTHS,
+									0,
+									0,
+									diskId + EFFECTOR_ROTATION_X + i);
+		}
+
+		for (int i = 0; i < 3; i++) {
+			AEFX_CLR_STRUCT(def);
+			PF_ADD_FLOAT_SLIDERX(	STR(StrID_EffectorScaleX_Param_Name + i),
+									REPTALL_PERCENT_MIN,
+									REPTALL_PERCENT_MAX,
+									REPTALL_PERCENT_MIN,
+									REPTALL_PERCENT_MAX,
+									0.0,
+									PF_Precision_TENTHS,
+									0,
+									PF_ValueDisplayFlag_PERCENT,
+									diskId + EFFECTOR_SCALE_X + i);
+		}
+
+		AEFX_CLR_STRUCT(def);
+		PF_ADD_FLOAT_SLIDERX(	STR(StrID_EffectorOpacity_Param_Name),
+								REPTALL_PERCENT_MIN,
+								REPTALL_PERCENT_MAX,
+								REPTALL_PERCENT_MIN,
+								REPTALL_PERCENT_MAX,
+								0.0,
+								PF_Precision_TENTHS,
+								0,
+								PF_ValueDisplayFlag_PERCENT,
+								diskId + EFFECTOR_OPACITY);
+
+		AEFX_CLR_STRUCT(def);
+		PF_END_TOPIC(diskId + EFFECTOR_TOPIC_END);
 	}
 
-	// Alpha-over: dst = src + dst * (1 - srcAlpha)
-	PF_FpLong srcA = srcP->alpha;
-	// Clamp srcA to prevent negative values
-	if (srcA < 0.0) srcA = 0.0;
-	if (srcA > 1.0) srcA = 1.0;
-	PF_FpLong oneMinusSrcA = 1.0 - srcA;
-
-	// Validate finite values
-	if (!std::isfinite(oneMinusSrcA)) oneMinusSrcA = 0.0;
-
-	dstP->alpha = srcP->alpha + dstP->alpha * oneMinusSrcA;
-	dstP->red   = srcP->red + dstP->red * oneMinusSrcA;
-	dstP->green = srcP->green + dstP->green * oneMinusSrcA;
-	dstP->blue  = srcP->blue + dstP->blue * oneMinusSrcA;
-
-	// Clamp to prevent negative values
-	if (dstP->alpha < 0.0) dstP->alpha = 0.0;
-	if (dstP->red < 0.0) dstP->red = 0.0;
-	if (dstP->green < 0.0) dstP->green = 0.0;
-	if (dstP->blue < 0.0) dstP->blue = 0.0;
+	AEFX_CLR_STRUCT(def);
+	PF_END_TOPIC(RANDOM_TOPIC_END_DISK_ID);
+
+	out_data->num_params = REPTALL_NUM_PARAMS;
+	
+	return err;
 }
 
 // ============================================================================
@@ -464,13 +554,11 @@ ExtractParameters(
 	// Initialize state to defaults
 	outState->Clear();
 
-	// Validate required parameters
-	if (!params[REPTALL_INPUT] || !params[REPTALL_COPIES_X] ||
-		!params[REPTALL_STEP_X] || !params[REPTALL_STEP_Y] ||
-		!params[REPTALL_STEP_Z] || !params[REPTALL_STEP_ROTATE_X] ||
-		!params[REPTALL_STEP_ROTATE_Y] || !params[REPTALL_STEP_ROTATE_Z] ||
-		!params[REPTALL_STEP_SCALE]) {
-		return PF_Err_BAD_CALLBACK_PARAM;
+	// Validate required parameters (every registered one is read)
+	for (A_long i = 0; i < REPTALL_NUM_PARAMS; i++) {
+		if (!params[i]) {
+			return PF_Err_BAD_CALLBACK_PARAM;
+		}
 	}
 
 	// Extract 3D grid count (currently only X supported, Y/Z reserved for future)
@@ -489,6 +577,49 @@ ExtractParameters(
 	// Extract scale step (uniform)
 	outState->step_scale = params[REPTALL_STEP_SCALE]->u.fs_d.value;
 
+	// Rendering options
+	outState->front_to_back = params[REPTALL_FRONT_TO_BACK]->u.bd.value ? TRUE : FALSE;
+
+	// Random group
+	outState->random_seed = params[REPTALL_RANDOM_SEED]->u.sd.value;
+	outState->random_strength = params[REPTALL_RANDOM_STRENGTH]->u.fs_d.value;
+	outState->random_distribution = (params[REPTALL_RANDOM_DISTRIBUTION]->u.pd.value == DISTRIBUTION_POPUP_UNIFORM)
+									? RANDOM_DISTRIBUTION_UNIFORM : RANDOM_DISTRIBUTION_CENTERED;
+
+	// Fields; the popups list the field enums in order
+	SpatialField& spatial = outState->spatial_field;
+	spatial.shape = params[REPTALL_SPATIAL_FIELD_TYPE]->u.pd.value - FIELD_SHAPE_POPUP_NONE;
+	for (int i = 0; i < 3; i++) {
+		spatial.center[i] = params[REPTALL_SPATIAL_FIELD_CENTER_X + i]->u.fs_d.value;
+		spatial.size[i] = params[REPTALL_SPATIAL_FIELD_SIZE_X + i]->u.fs_d.value;
+	}
+	spatial.curve = params[REPTALL_SPATIAL_FIELD_CURVE]->u.pd.value - FIELD_CURVE_POPUP_LINEAR;
+	spatial.invert = params[REPTALL_SPATIAL_FIELD_INVERT]->u.bd.value ? TRUE : FALSE;
+
+	IndexField& index = outState->index_field;
+	index.type = params[REPTALL_INDEX_FIELD_TYPE]->u.pd.value - FIELD_INDEX_POPUP_NONE;
+	index.start = params[REPTALL_INDEX_FIELD_START]->u.fs_d.value;
+	index.end = params[REPTALL_INDEX_FIELD_END]->u.fs_d.value;
+	index.curve = params[REPTALL_INDEX_FIELD_CURVE]->u.pd.value - FIELD_CURVE_POPUP_LINEAR;
+
+	outState->field_combine = params[REPTALL_FIELD_COMBINE]->u.pd.value - FIELD_COMBINE_POPUP_MULTIPLY;
+
+	for (A_long e = 0; e < REPTALL_EFFECTOR_COUNT; e++) {
+		PF_ParamDef **group = params + REPTALL_EFFECTOR_1 + e * EFFECTOR_PARAM_COUNT;
+		CopyEffector& effector = outState->effector[e];
+
+		effector.enabled = group[EFFECTOR_ENABLE]->u.bd.value ? TRUE : FALSE;
+		effector.strength = group[EFFECTOR_STRENGTH]->u.fs_d.value;
+		effector.seed_offset = group[EFFECTOR_SEED_OFFSET]->u.sd.value;
+		effector.probability = group[EFFECTOR_PROBABILITY]->u.fs_d.value;
+		for (int i = 0; i < 3; i++) {
+			effector.position[i] = group[EFFECTOR_POSITION_X + i]->u.fs_d.value;
+			effector.rotation[i] = group[EFFECTOR_ROTATION_X + i]->u.fs_d.value;
+			effector.scale[i] = group[EFFECTOR_SCALE_X + i]->u.fs_d.value;
+		}
+		effector.opacity = group[EFFECTOR_OPACITY]->u.fs_d.value;
+	}
+
 	// Set defaults for other parameters (will be exposed in future parameters)
 	outState->offset = 0.0;
 	for (int i = 0; i < 3; i++) {
@@ -502,72 +633,41 @@ ExtractParameters(
 	outState->camera_aware = TRUE;
 	outState->composite_mode = 0;
 
+	// Draft quality (AE's "Draft" or fast previews) trades the bilinear
+	// filter for nearest-neighbor sampling
+	outState->draft = (in_data->quality == PF_Quality_LO);
+
 	return err;
 }
 
 // ============================================================================
-// PHASE 2: Compute transform for each copy (handles stepping)
+// PHASE 2a: Query the active 3D camera
 // ============================================================================
 PF_Err
-ComputeCopyTransforms(
+QueryCopyCamera(
+	PF_InData			*in_data,
 	const ReptAllState	*state,
-	CopyTransform		*transforms,
-	A_long				*numTransforms,
-	PF_InData			*in_data)
+	A_long				time,
+	A_u_long			time_scale,
+	CopyCamera			*camera)
 {
 	PF_Err err = PF_Err_NONE;
-	AEGP_SuiteHandler suites(in_data->pica_basicP);
 
-	if (!state || !transforms || !numTransforms) {
+	if (!in_data || !state || !camera) {
 		return PF_Err_BAD_CALLBACK_PARAM;
 	}
 
-	// Validate maximum copy count
-	for (int i = 0; i < 3; i++) {
-		if (state->copies[i] < 1 || state->copies[i] > MAX_COPIES) {
-			return PF_Err_BAD_CALLBACK_PARAM;
-		}
-	}
-
-	// Get total number of copies with overflow check
-	A_long totalX = state->copies[0];
-	A_long totalY = state->copies[1];
-	A_long totalZ = state->copies[2];
-
-	// Check for multiplication overflow
-	if (totalX > 0 && totalY > LONG_MAX / totalX) {
-		return PF_Err_BAD_CALLBACK_PARAM;
-	}
-	A_long totalXY = totalX * totalY;
-
-	if (totalXY > 0 && totalZ > LONG_MAX / totalXY) {
-		return PF_Err_BAD_CALLBACK_PARAM;
-	}
-
-	*numTransforms = totalXY * totalZ;
-
-	// Additional maximum copy count validation
-	if (*numTransforms > MAX_COPIES) {
-		return PF_Err_BAD_CALLBACK_PARAM;
-	}
-
-	// ===== Get 3D Camera Information =====
-	A_Matrix4 camera_matrix;
-	A_FpLong focal_length = 0.0;
-	PF_Boolean has_camera = FALSE;
-	AEFX_CLR_STRUCT(camera_matrix);
-
-	PF_FpLong camera_x = 0.0, camera_y = 0.0, camera_z = 0.0;
-	PF_FpLong camera_fwd_x = 0.0, camera_fwd_y = 0.0, camera_fwd_z = 0.0;
+	camera->Clear();
 
 	if (state->camera_aware && in_data->appl_id != 'PrMr') {
+		AEGP_SuiteHandler suites(in_data->pica_basicP);
 		A_Time comp_timeT = {0, 1};
 		AEGP_LayerH camera_layerH = NULL;
 
 		ERR(suites.PFInterfaceSuite1()->AEGP_ConvertEffectToCompTime(
 			in_data->effect_ref,
-			in_data->current_time,
-			in_data->time_scale,
+			time,
+			time_scale,
 			&comp_timeT));
 		if (!err) {
 			ERR(suites.PFInterfaceSuite1()->AEGP_GetEffectCamera(
@@ -577,12 +677,14 @@ ComputeCopyTransforms(
 		}
 
 		if (camera_layerH && !err) {
-			has_camera = TRUE;
+			camera->has_camera = TRUE;
+			camera->layer_center[0] = in_data->width / 2.0;
+			camera->layer_center[1] = in_data->height / 2.0;
 
 			ERR(suites.LayerSuite5()->AEGP_GetLayerToWorldXform(
 				camera_layerH,
 				&comp_timeT,
-				&camera_matrix));
+				&camera->matrix));
 
 			if (!err) {
 				AEGP_StreamVal stream_val;
@@ -598,197 +700,154 @@ ComputeCopyTransforms(
 					NULL));
 
 				if (!err) {
-					focal_length = stream_val.one_d;
+					camera->focal_length = stream_val.one_d;
 					// AEGP_StreamVal is a union, not a pointer-allocated struct
 					// No disposal needed for values returned by AEGP_GetLayerStreamValue
 				}
-
-				// Extract camera position and direction
-				camera_x = camera_matrix.mat[3][0];
-				camera_y = camera_matrix.mat[3][1];
-				camera_z = camera_matrix.mat[3][2];
-
-				camera_fwd_x = -camera_matrix.mat[2][0];
-				camera_fwd_y = -camera_matrix.mat[2][1];
-				camera_fwd_z = -camera_matrix.mat[2][2];
-
-				PF_FpLong fwd_len = sqrt(camera_fwd_x*camera_fwd_x +
-										  camera_fwd_y*camera_fwd_y +
-										  camera_fwd_z*camera_fwd_z);
-				if (fwd_len > 0.0001) {
-					camera_fwd_x /= fwd_len;
-					camera_fwd_y /= fwd_len;
-					camera_fwd_z /= fwd_len;
-				}
 			}
 		}
 	}
 
-	// ===== Compute transform for each copy =====
-	A_long transformIndex = 0;
-
-	for (A_long z = 0; z < state->copies[2]; z++) {
-		for (A_long y = 0; y < state->copies[1]; y++) {
-			for (A_long x = 0; x < state->copies[0]; x++) {
-				A_long copyIndex = z * state->copies[0] * state->copies[1] +
-								   y * state->copies[0] + x;
-
-				CopyTransform& transform = transforms[transformIndex++];
-				transform.Clear();
-
-				// Calculate cumulative position
-				transform.position[0] = state->position[0] + state->step_position[0] * x;
-				transform.position[1] = state->position[1] + state->step_position[1] * y;
-				transform.position[2] = state->position[2] + state->step_position[2] * z;
-
-				// Calculate cumulative rotation
-				transform.rotation[0] = state->rotation[0] + state->step_rotation[0] * copyIndex;
-				transform.rotation[1] = state->rotation[1] + state->step_rotation[1] * copyIndex;
-				transform.rotation[2] = state->rotation[2] + state->step_rotation[2] * copyIndex;
-
-				// Calculate cumulative scale (compound) - use exponential formula instead of O(n^2) loop
-				// scale = base_scale * (step_scale / 100.0) ^ copyIndex
-				PF_FpLong stepScaleRatio = state->step_scale / 100.0;
-				PF_FpLong baseScale = state->scale;
-
-				// Validate inputs
-				if (!std::isfinite(stepScaleRatio) || stepScaleRatio < 0.001) stepScaleRatio = 0.001;
-				if (stepScaleRatio > 10.0) stepScaleRatio = 10.0;
-				if (!std::isfinite(baseScale) || baseScale < 0.001) baseScale = 0.001;
-				if (baseScale > 1000.0) baseScale = 1000.0;
-
-				if (copyIndex > 0) {
-					// Use pow for exponential calculation: base * ratio^copyIndex
-					transform.scale = baseScale * std::pow(stepScaleRatio, copyIndex);
-
-					// Clamp result to reasonable range
-					if (!std::isfinite(transform.scale) || transform.scale < 0.001) transform.scale = 0.001;
-					if (transform.scale > 10000.0) transform.scale = 10000.0;
-				} else {
-					transform.scale = baseScale;
-				}
+	return err;
+}
 
-				// Calculate opacity (linear interpolation)
-				if (*numTransforms > 1) {
-					transform.opacity = state->opacity_start +
-						(state->opacity_end - state->opacity_start) * copyIndex / (*numTransforms - 1);
-				} else {
-					transform.opacity = state->opacity_start;
-				}
+// Host services RenderCopies uses inside AE; refcon of the AE RenderHost
+struct AERenderHostData {
+	PF_InData				*in_data;
+	const RenderGeometry	*geometry;
+};
 
-				// Calculate camera depth for sorting
-				if (has_camera) {
-					PF_FpLong dx = transform.position[0] - camera_x;
-					PF_FpLong dy = transform.position[1] - camera_y;
-					PF_FpLong dz = transform.position[2] - camera_z;
-
-					transform.camera_depth = dx * camera_fwd_x +
-											 dy * camera_fwd_y +
-											 dz * camera_fwd_z;
-
-					// Apply perspective scaling
-					if (focal_length > 0.0) {
-						PF_FpLong depth = transform.camera_depth;
-						PF_FpLong perspectiveScale = 1.0;
-						PF_FpLong denominator = focal_length - depth;
-
-						if (denominator > 1.0) {
-							perspectiveScale = focal_length / denominator;
-						} else if (denominator < -1.0) {
-							perspectiveScale = 0.001;
-						} else {
-							perspectiveScale = (denominator > 0) ? 10.0 : 0.001;
-						}
-
-						if (perspectiveScale < 0.001) perspectiveScale = 0.001;
-						if (perspectiveScale > 100.0) perspectiveScale = 100.0;
-
-						transform.scale *= perspectiveScale;
-						transform.view_scale = perspectiveScale;
-					}
-				} else {
-					transform.camera_depth = transform.position[2];
-					transform.view_scale = 1.0;
-				}
+// Spreads the render workers over AE's render threads
+static PF_Err
+IterateAE(
+	void				*refcon,
+	void				*workerRefcon,
+	RenderWorkerFunc	worker)
+{
+	AERenderHostData *hostData = reinterpret_cast<AERenderHostData*>(refcon);
+	AEGP_SuiteHandler suites(hostData->in_data->pica_basicP);
 
-				transform.visible = (transform.opacity > 0.0 && transform.scale > 0.001);
-
-				// Validate and clamp opacity
-				if (!std::isfinite(transform.opacity)) transform.opacity = 100.0;
-				if (transform.opacity < 0.0) transform.opacity = 0.0;
-				if (transform.opacity > 100.0) transform.opacity = 100.0;
-
-				// Store precomputed 2D transform params for rendering
-				// (legacy compatibility for current rendering code)
-				PF_FpLong invRotateZ = -transform.rotation[2];
-				PF_FpLong radZ = invRotateZ * M_PI / 180.0;
-
-				transform.world_matrix[0] = cos(radZ);  // cosZ
-				transform.world_matrix[1] = sin(radZ);  // sinZ
-				transform.world_matrix[2] = 0.0;  // centerX - set by caller
-				transform.world_matrix[3] = 0.0;  // centerY - set by caller
-
-				if (has_camera) {
-					transform.world_matrix[4] = transform.position[0] - camera_x;  // translateX
-					transform.world_matrix[5] = transform.position[1] - camera_y;  // translateY
-				} else {
-					transform.world_matrix[4] = transform.position[0];
-					transform.world_matrix[5] = transform.position[1];
-				}
-			}
+	return suites.Iterate8Suite2()->iterate_generic(PF_Iterations_ONCE_PER_PROCESSOR,
+													workerRefcon,
+													worker);
+}
+
+static PF_Err
+AbortAE(void *refcon)
+{
+	AERenderHostData *hostData = reinterpret_cast<AERenderHostData*>(refcon);
+
+	return PF_ABORT(hostData->in_data);
+}
+
+// Alpha coverage of the source buffer, from the cache when the host reports
+// the input layer unchanged for this frame
+// Hosts without PF_GetCurrentState get a fresh, uncached scan.
+static PF_Err
+AcquireSourceCoverageAE(
+	void					*refcon,
+	const PF_EffectWorld	*srcP,
+	A_long					depth,
+	SourceCoverageRef		*coverage)
+{
+	PF_Err err = PF_Err_NONE;
+	AERenderHostData *hostData = reinterpret_cast<AERenderHostData*>(refcon);
+	PF_InData *in_data = hostData->in_data;
+	SourceFrameKey key;
+	PF_Boolean haveKey = FALSE;
+
+	memset(&key, 0, sizeof(key));
+
+	PF_ParamUtilsSuite3 *param_suiteP = NULL;
+	A_Err suite_err = in_data->pica_basicP->AcquireSuite(
+		kPFParamUtilsSuite,
+		kPFParamUtilsSuiteVersion3,
+		(const void**)&param_suiteP);
+
+	if (suite_err == A_Err_NONE && param_suiteP) {
+		A_Time start = {in_data->current_time, in_data->time_scale};
+		A_Time duration = {in_data->time_step, in_data->time_scale};
+
+		if (param_suiteP->PF_GetCurrentState(in_data->effect_ref, REPTALL_INPUT, &start, &duration, &key.state) == PF_Err_NONE) {
+			key.origin[0] = hostData->geometry->src_origin[0];
+			key.origin[1] = hostData->geometry->src_origin[1];
+			key.width = srcP->width;
+			key.height = srcP->height;
+			key.depth = depth;
+			key.downsample[0] = in_data->downsample_x;
+			key.downsample[1] = in_data->downsample_y;
+			haveKey = TRUE;
 		}
+		in_data->pica_basicP->ReleaseSuite(kPFParamUtilsSuite, kPFParamUtilsSuiteVersion3);
+	}
+
+	if (!haveKey) {
+		// RenderCopies scans the source itself
+		return err;
+	}
+
+	*coverage = LookupSourceCoverage(key);
+	if (*coverage) {
+		return err;
+	}
+
+	std::shared_ptr<SourceCoverage> scanned;
+	try {
+		scanned = std::make_shared<SourceCoverage>();
+	} catch (const std::bad_alloc&) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	ERR(BuildSourceCoverage(srcP, depth == 32, depth == 16, scanned.get()));
+
+	if (!err) {
+		*coverage = scanned;
+		StoreSourceCoverage(key, *coverage);
 	}
 
 	return err;
 }
 
-// ============================================================================
-// PHASE 3: Sort copies by camera depth for proper Z-order
-// ============================================================================
-void
-SortCopiesByDepth(
-	CopyTransform	*transforms,
-	A_long			count,
-	PF_Boolean		cameraAware)
+// Geometry of a full-layer render at the downsample factors of in_data
+// width and height are the layer size in (downsampled) buffer pixels.
+static void
+ClearRenderGeometryAE(
+	const PF_InData		*in_data,
+	A_long				width,
+	A_long				height,
+	RenderGeometry		*geometry)
 {
-	if (!transforms || count <= 1) {
-		return;
-	}
+	geometry->Clear(width, height);
 
-	// Sort by camera depth (ascending - furthest first)
-	std::sort(transforms, transforms + count,
-		[](const CopyTransform& a, const CopyTransform& b) {
-			return a.camera_depth < b.camera_depth;
-		});
+	const PF_RationalScale *downsample[2] = {&in_data->downsample_x, &in_data->downsample_y};
+	for (int i = 0; i < 2; i++) {
+		if (downsample[i]->num > 0 && downsample[i]->den > 0) {
+			geometry->downsample[i] = (PF_FpLong)downsample[i]->num / downsample[i]->den;
+		}
+	}
 }
 
-// ============================================================================
-// PHASE 4: Render each copy with bilinear sampling
-// ============================================================================
-PF_Err
-RenderCopies(
-	PF_InData			*in_data,
-	PF_OutData			*out_data,
-	const ReptAllState	*state,
-	const CopyTransform	*transforms,
-	A_long				transformCount,
-	PF_EffectWorld		*srcP,
-	PF_LayerDef			*output)
+// PHASE 4 inside AE: output depth from the world, threads and abort from AE
+// motion is NULL without motion blur. stats (NULL unless instrumentation is
+// on) gets the phase 4 time and counters, and is drawn over the output when
+// the overlay is enabled.
+static PF_Err
+RenderCopiesAE(
+	PF_InData					*in_data,
+	const ReptAllState			*state,
+	const CopyInstanceBuffer	*instances,
+	const CopyMotion			*motion,
+	const RenderGeometry		*geometry,
+	PF_EffectWorld				*srcP,
+	PF_EffectWorld				*output,
+	RenderStats					*stats)
 {
 	PF_Err err = PF_Err_NONE;
-	AEGP_SuiteHandler suites(in_data->pica_basicP);
 
-	if (!state || !transforms || !srcP || !output) {
-		return PF_Err_BAD_CALLBACK_PARAM;
-	}
-
-	// Check bit depth using pixel format
 	// PF_WORLD_IS_DEEP checks for 16-bit (ARGB64)
 	// For 32-bit float (ARGB128), we need to use PF_WorldSuite2->PF_GetPixelFormat()
-	PF_Boolean deepB = PF_WORLD_IS_DEEP(output);
-	PF_Boolean floatB = FALSE;
+	A_long depth = PF_WORLD_IS_DEEP(output) ? 16 : 8;
 
-	// Detect 32-bit float format using PF_WorldSuite2
 	PF_PixelFormat pixfmt = PF_PixelFormat_INVALID;
 	PF_WorldSuite2 *world_suiteP = NULL;
 	A_Err suite_err = in_data->pica_basicP->AcquireSuite(
@@ -799,170 +858,116 @@ RenderCopies(
 	if (suite_err == A_Err_NONE && world_suiteP) {
 		PF_Err fmt_err = world_suiteP->PF_GetPixelFormat(output, &pixfmt);
 		if (fmt_err == PF_Err_NONE && pixfmt == PF_PixelFormat_ARGB128) {
-			floatB = TRUE;
+			depth = 32;
 		}
+		// Balance the acquire; concurrent MFR renders each hold their own reference
+		in_data->pica_basicP->ReleaseSuite(kPFWorldSuite, kPFWorldSuiteVersion2);
 	}
 
-	// Calculate center point
-	PF_FpLong centerX = srcP->width / 2.0;
-	PF_FpLong centerY = srcP->height / 2.0;
-
-	// Clear output
-	if (floatB) {
-		PF_PixelFloat clearColor = {0, 0, 0, 0};
-		ERR(suites.FillMatteSuite2()->fill_float(in_data->effect_ref, &clearColor, NULL, output));
-	} else if (deepB) {
-		PF_Pixel16 clearColor = {0, 0, 0, 0};
-		ERR(suites.FillMatteSuite2()->fill16(in_data->effect_ref, &clearColor, NULL, output));
-	} else {
-		PF_Pixel clearColor = {0, 0, 0, 0};
-		ERR(suites.FillMatteSuite2()->fill(in_data->effect_ref, &clearColor, NULL, output));
+	AERenderHostData hostData = {in_data, geometry};
+	RenderHost host;
+	host.refcon = &hostData;
+	host.iterate = IterateAE;
+	host.abort = AbortAE;
+	host.acquire_coverage = AcquireSourceCoverageAE;
+	host.stats = stats;
+
+	ERR(RenderCopies(&host, state, instances, motion, geometry, depth, srcP, output));
+
+	if (!err && stats && IsRenderStatsOverlayEnabled()) {
+		// SmartFX outputs cover the result rect, which PreRender extended
+		// over the overlay at the layer origin
+		DrawRenderStatsOverlay(*stats, depth, geometry->layer_size[0], geometry->layer_size[1],
+							   geometry->dst_origin, output);
 	}
 
-	// Render each copy in sorted order
-	for (A_long i = 0; i < transformCount && !err; i++) {
-		const CopyTransform& transform = transforms[i];
+	return err;
+}
 
-		if (!transform.visible) {
-			continue;
-		}
+// SmartFX does not pass params, and motion blur needs them at other times;
+// check out every non-layer parameter at time / time_scale
+static PF_Err
+CheckoutParams(
+	PF_InData		*in_data,
+	A_long			time,
+	A_long			time_step,
+	A_u_long		time_scale,
+	PF_ParamDef		paramDefs[],
+	PF_ParamDef		*params[])
+{
+	PF_Err err = PF_Err_NONE;
 
-		// Build transform params from precomputed data
-		TransformParams params;
-		params.centerX = centerX;
-		params.centerY = centerY;
-		params.cosZ = transform.world_matrix[0];
-		params.sinZ = transform.world_matrix[1];
-		params.translateX = transform.world_matrix[4];
-		params.translateY = transform.world_matrix[5];
-		params.scale = transform.scale / 100.0;
-
-		// Validate finite values for scale
-		PF_FpLong safeScale = transform.scale;
-		if (!std::isfinite(safeScale) || safeScale < 0.001) safeScale = 0.001;
-		if (safeScale > 1000.0) safeScale = 1000.0;
-
-		PF_FpLong invScale = 100.0 / safeScale;
-		if (!std::isfinite(invScale) || invScale < 0.001) invScale = 0.001;
-		if (invScale > 1000.0) invScale = 1000.0;
-
-		// Iterate through output pixels
-		for (A_long y = 0; y < output->height && !err; y++) {
-			if (floatB) {
-				PF_PixelFloat *dstRow = (PF_PixelFloat*)((char*)output->data + y * output->rowbytes);
-				for (A_long x = 0; x < output->width; x++) {
-					PF_FpLong srcX, srcY;
-					ApplyTransform2DOptimized((PF_FpLong)x, (PF_FpLong)y, params, &srcX, &srcY);
-					srcX = centerX + (srcX - centerX) * invScale;
-					srcY = centerY + (srcY - centerY) * invScale;
-
-					PF_PixelFloat srcPix = SampleBilinearFloat(srcP, srcX, srcY);
-					if (srcPix.alpha > 0.0) {
-						// Apply opacity with clamping
-						PF_FpLong opacity = transform.opacity;
-						if (!std::isfinite(opacity)) opacity = 100.0;
-						if (opacity < 0.0) opacity = 0.0;
-						if (opacity > 100.0) opacity = 100.0;
-
-						if (opacity < 100.0) {
-							srcPix.alpha *= opacity / 100.0;
-						}
-						CompositePremultFloat(&dstRow[x], &srcPix);
-					}
-				}
-			} else if (deepB) {
-				PF_Pixel16 *dstRow = (PF_Pixel16*)((char*)output->data + y * output->rowbytes);
-				for (A_long x = 0; x < output->width; x++) {
-					PF_FpLong srcX, srcY;
-					ApplyTransform2DOptimized((PF_FpLong)x, (PF_FpLong)y, params, &srcX, &srcY);
-					srcX = centerX + (srcX - centerX) * invScale;
-					srcY = centerY + (srcY - centerY) * invScale;
-
-					PF_Pixel16 srcPix = SampleBilinear16(srcP, srcX, srcY);
-					if (srcPix.alpha > 0) {
-						// Apply opacity with clamping
-						PF_FpLong opacity = transform.opacity;
-						if (!std::isfinite(opacity)) opacity = 100.0;
-						if (opacity < 0.0) opacity = 0.0;
-						if (opacity > 100.0) opacity = 100.0;
-
-						if (opacity < 100.0) {
-							srcPix.alpha = (A_u_short)(srcPix.alpha * opacity / 100.0);
-						}
-						CompositePremult16(&dstRow[x], &srcPix);
-					}
-				}
-			} else {
-				PF_Pixel *dstRow = (PF_Pixel*)((char*)output->data + y * output->rowbytes);
-				for (A_long x = 0; x < output->width; x++) {
-					PF_FpLong srcX, srcY;
-					ApplyTransform2DOptimized((PF_FpLong)x, (PF_FpLong)y, params, &srcX, &srcY);
-					srcX = centerX + (srcX - centerX) * invScale;
-					srcY = centerY + (srcY - centerY) * invScale;
-
-					PF_Pixel srcPix = SampleBilinear8(srcP, srcX, srcY);
-					if (srcPix.alpha > 0) {
-						// Apply opacity with clamping
-						PF_FpLong opacity = transform.opacity;
-						if (!std::isfinite(opacity)) opacity = 100.0;
-						if (opacity < 0.0) opacity = 0.0;
-						if (opacity > 100.0) opacity = 100.0;
-
-						if (opacity < 100.0) {
-							srcPix.alpha = (A_u_char)(srcPix.alpha * opacity / 100.0);
-						}
-						CompositePremult8(&dstRow[x], &srcPix);
-					}
-				}
-			}
+	for (A_long i = 0; i < REPTALL_NUM_PARAMS; i++) {
+		AEFX_CLR_STRUCT(paramDefs[i]);
+		params[i] = NULL;
+	}
+
+	// Layer pixels come through checkout_layer; only the slot is needed
+	params[REPTALL_INPUT] = &paramDefs[REPTALL_INPUT];
 
-			ERR(PF_ABORT(in_data));
+	for (A_long i = REPTALL_INPUT + 1; i < REPTALL_NUM_PARAMS && !err; i++) {
+		ERR(PF_CHECKOUT_PARAM(in_data,
+							  i,
+							  time,
+							  time_step,
+							  time_scale,
+							  &paramDefs[i]));
+		if (!err) {
+			params[i] = &paramDefs[i];
 		}
 	}
 
 	return err;
 }
 
-// ============================================================================
-// MAIN RENDER FUNCTION - Orchestrates all phases
-// ============================================================================
 static PF_Err
-Render (
+CheckinParams(
 	PF_InData		*in_data,
-	PF_OutData		*out_data,
-	PF_ParamDef		*params[],
-	PF_LayerDef		*output )
+	PF_ParamDef		*params[])
 {
-	PF_Err				err		= PF_Err_NONE;
-	AEGP_SuiteHandler	suites(in_data->pica_basicP);
+	PF_Err err = PF_Err_NONE, err2 = PF_Err_NONE;
 
-	// Validate inputs
-	if (!params || !output) {
-		return PF_Err_BAD_CALLBACK_PARAM;
+	for (A_long i = REPTALL_INPUT + 1; i < REPTALL_NUM_PARAMS; i++) {
+		if (params[i]) {
+			ERR2(PF_CHECKIN_PARAM(in_data, params[i]));
+			params[i] = NULL;
+		}
 	}
 
-	// Get source layer
-	PF_EffectWorld *srcP = &params[REPTALL_INPUT]->u.ld;
-	if (!srcP) {
-		return PF_Err_BAD_CALLBACK_PARAM;
-	}
+	return err;
+}
+
+// ============================================================================
+// PHASES 1-3: Shared by PF_Cmd_RENDER and PF_Cmd_SMART_PRE_RENDER
+// ============================================================================
+// stats (may be NULL) gets the phase times and the copy count.
+static PF_Err
+BuildSortedCopies(
+	PF_InData					*in_data,
+	PF_ParamDef					*params[],
+	ReptAllState				*state,
+	CopyInstanceList			*instances,
+	RenderStats					*stats)
+{
+	PF_Err err = PF_Err_NONE;
 
 	// ========================================================================
 	// PHASE 1: Extract parameters from UI
 	// ========================================================================
-	ReptAllState state;
-	state.Clear();
+	BeginRenderPhase(stats, RENDER_PHASE_PARAMS);
+	state->Clear();
 
-	ERR(ExtractParameters(in_data, params, &state));
+	ERR(ExtractParameters(in_data, params, state));
+	EndRenderPhase(stats, RENDER_PHASE_PARAMS);
 	if (err) return err;
 
 	// ========================================================================
 	// PHASE 2: Compute transforms for all copies
 	// ========================================================================
 	// Calculate total copies with overflow check
-	A_long totalX = state.copies[0];
-	A_long totalY = state.copies[1];
-	A_long totalZ = state.copies[2];
+	A_long totalX = state->copies[0];
+	A_long totalY = state->copies[1];
+	A_long totalZ = state->copies[2];
 
 	// Validate individual dimensions
 	if (totalX < 1 || totalX > MAX_COPIES ||
@@ -988,10 +993,34 @@ Render (
 		return PF_Err_BAD_CALLBACK_PARAM;
 	}
 
-	// Use std::vector for automatic memory management (RAII pattern)
-	std::vector<CopyTransform> transformStorage(totalCopies);
-	A_long transformCount = 0;
-	ERR(ComputeCopyTransforms(&state, transformStorage.data(), &transformCount, in_data));
+	// Phases 2-3 depend only on the state and the camera; reuse the sorted
+	// copies of an earlier render with identical inputs
+	BeginRenderPhase(stats, RENDER_PHASE_TRANSFORMS);
+	CopyCamera camera;
+	ERR(QueryCopyCamera(in_data, state, in_data->current_time, in_data->time_scale, &camera));
+	if (err) {
+		return err;
+	}
+
+	*instances = LookupCachedTransforms(state, &camera);
+	if (*instances) {
+		EndRenderPhase(stats, RENDER_PHASE_TRANSFORMS);
+		if (stats) {
+			stats->transformsCached = TRUE;
+			stats->copiesComputed = totalCopies;
+		}
+		return err;
+	}
+
+	// The latest result for the same number of copies, usually the previous
+	// frame, seeds the depth sort
+	CopyInstanceList previous = LookupRecentTransforms(totalCopies);
+
+	// Instance arrays come from a pooled arena, released with the last reference
+	std::shared_ptr<CopyInstanceBuffer> instanceStorage;
+	ERR(AcquireCopyInstances(totalCopies, &instanceStorage));
+	ERR(ComputeCopyTransforms(state, &camera, instanceStorage.get()));
+	EndRenderPhase(stats, RENDER_PHASE_TRANSFORMS);
 	if (err) {
 		return err;
 	}
@@ -999,14 +1028,402 @@ Render (
 	// ========================================================================
 	// PHASE 3: Sort copies by depth
 	// ========================================================================
-	SortCopiesByDepth(transformStorage.data(), transformCount, state.camera_aware);
+	BeginRenderPhase(stats, RENDER_PHASE_SORT);
+	ERR(SortCopiesByDepth(instanceStorage.get(), state->camera_aware,
+						  previous ? previous->order : NULL));
+	EndRenderPhase(stats, RENDER_PHASE_SORT);
+	if (err) {
+		return err;
+	}
+	if (stats) {
+		stats->copiesComputed = totalCopies;
+	}
+
+	*instances = instanceStorage;
+	StoreCachedTransforms(state, &camera, *instances);
+
+	return err;
+}
+
+// ============================================================================
+// MOTION BLUR: Copy transforms at shutter open and close
+// ============================================================================
+// The shutter of the frame at current_time opens shutter_phase degrees of a
+// frame step after it and stays open for shutter_angle degrees; AE passes an
+// angle of 0 when motion blur is off for the layer or the comp. times gets
+// open and close in units of *time_scale, a multiple of in_data->time_scale
+// fine enough for fractional shutters. Returns FALSE when there is no blur.
+static PF_Boolean
+GetShutterTimesAE(
+	PF_InData	*in_data,
+	A_long		times[2],
+	A_long		*time_step,
+	A_u_long	*time_scale)
+{
+	const PF_FpLong angle = FIX_2_FLOAT(in_data->shutter_angle);
+	const PF_FpLong phase = FIX_2_FLOAT(in_data->shutter_phase);
+
+	if (angle <= 0.0 || in_data->time_step == 0) {
+		return FALSE;
+	}
+
+	// Largest range an A_long time holds
+	const PF_FpLong timeLimit = 2147483647.0;
+
+	// A degree of a frame step is one tick at k = 360; long comps that would
+	// overflow fall back to coarser ticks
+	for (A_long k = 360; k >= 1; k /= 2) {
+		const PF_FpLong step = (PF_FpLong)in_data->time_step * k;
+		const PF_FpLong open = (PF_FpLong)in_data->current_time * k + step * phase / 360.0;
+		const PF_FpLong close = open + step * angle / 360.0;
+
+		if (fabs(open) < timeLimit && fabs(close) < timeLimit && fabs(step) < timeLimit &&
+			(PF_FpLong)in_data->time_scale * k < timeLimit) {
+			times[0] = (A_long)floor(open + 0.5);
+			times[1] = (A_long)floor(close + 0.5);
+			*time_step = (A_long)step;
+			*time_scale = in_data->time_scale * (A_u_long)k;
+			return times[0] != times[1];
+		}
+	}
+
+	return FALSE;
+}
+
+// Phase 2 at shutter open and close, for RenderCopies' motion blur
+// shutter[] stays empty when motion blur is off or the copy grid changes
+// within the shutter (copies cannot be matched up). Params are checked out
+// at both times, so AE widens the frame's dependencies to the interval.
+// Results come from the transform cache when an earlier frame computed
+// them; new ones are not sorted and not cached, RenderCopies only reads
+// their transforms.
+static PF_Err
+BuildShutterCopies(
+	PF_InData			*in_data,
+	const ReptAllState	*state,
+	CopyInstanceList	shutter[2],
+	RenderStats			*stats)
+{
+	PF_Err err = PF_Err_NONE, err2 = PF_Err_NONE;
+
+	shutter[0].reset();
+	shutter[1].reset();
+
+	A_long times[2] = {0, 0};
+	A_long timeStep = 0;
+	A_u_long timeScale = 1;
+	if (!GetShutterTimesAE(in_data, times, &timeStep, &timeScale)) {
+		return err;
+	}
+
+	// Part of the transforms phase, measured on top of it
+	const A_u_longlong start = stats ? GetStatsClock() : 0;
+	const A_long totalCopies = state->copies[0] * state->copies[1] * state->copies[2];
+
+	for (int e = 0; e < 2 && !err; e++) {
+		PF_ParamDef paramDefs[REPTALL_NUM_PARAMS];
+		PF_ParamDef *params[REPTALL_NUM_PARAMS];
+		ReptAllState shutterState;
+		CopyCamera camera;
+
+		ERR(CheckoutParams(in_data, times[e], timeStep, timeScale, paramDefs, params));
+		ERR(ExtractParameters(in_data, params, &shutterState));
+		ERR2(CheckinParams(in_data, params));
+		if (err) {
+			break;
+		}
+
+		if (!std::equal(shutterState.copies, shutterState.copies + 3, state->copies)) {
+			shutter[0].reset();
+			break;
+		}
+
+		ERR(QueryCopyCamera(in_data, &shutterState, times[e], timeScale, &camera));
+		if (!err) {
+			shutter[e] = LookupCachedTransforms(&shutterState, &camera);
+		}
+		if (!err && !shutter[e]) {
+			std::shared_ptr<CopyInstanceBuffer> instanceStorage;
+			ERR(AcquireCopyInstances(totalCopies, &instanceStorage));
+			ERR(ComputeCopyTransforms(&shutterState, &camera, instanceStorage.get()));
+			if (!err) {
+				shutter[e] = instanceStorage;
+			}
+		}
+	}
+
+	if (err || !shutter[0] || !shutter[1]) {
+		shutter[0].reset();
+		shutter[1].reset();
+	}
+
+	if (stats) {
+		stats->phaseDuration[RENDER_PHASE_TRANSFORMS] += GetStatsClock() - start;
+	}
+
+	return err;
+}
+
+// ============================================================================
+// MAIN RENDER FUNCTION - Orchestrates all phases
+// ============================================================================
+static PF_Err
+Render (
+	PF_InData		*in_data,
+	PF_OutData		*out_data,
+	PF_ParamDef		*params[],
+	PF_LayerDef		*output )
+{
+	PF_Err				err		= PF_Err_NONE;
+
+	// Validate inputs
+	if (!params || !output) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	// Get source layer
+	PF_EffectWorld *srcP = &params[REPTALL_INPUT]->u.ld;
+	if (!srcP) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	// ========================================================================
+	// PHASES 1-3: Parameters, transforms, depth order
+	// ========================================================================
+	ReptAllState state;
+	CopyInstanceList instances;
+	CopyInstanceList shutter[2];
+
+	// Instrumentation is opt-in (see ReptAll_Stats.h)
+	RenderStats stats;
+	RenderStats *statsP = IsRenderStatsEnabled() ? &stats : NULL;
+	stats.Clear();
+
+	ERR(BuildSortedCopies(in_data, params, &state, &instances, statsP));
+	ERR(BuildShutterCopies(in_data, &state, shutter, statsP));
+	if (err) {
+		return err;
+	}
 
 	// ========================================================================
 	// PHASE 4: Render all copies
 	// ========================================================================
-	ERR(RenderCopies(in_data, out_data, &state, transformStorage.data(), transformCount, srcP, output));
+	RenderGeometry geometry;
+	ClearRenderGeometryAE(in_data, srcP->width, srcP->height, &geometry);
+
+	const CopyMotion motion = {shutter[0].get(), shutter[1].get()};
+
+	ERR(RenderCopiesAE(in_data, &state, instances.get(), shutter[0] ? &motion : NULL,
+					   &geometry, srcP, output, statsP));
+
+	if (statsP) {
+		AppendRenderTrace("Render", stats);
+	}
 
-	// std::vector handles cleanup automatically (RAII)
+	// The instance arena returns to the pool once the cache lets go of it
+
+	return err;
+}
+
+// ============================================================================
+// SMARTFX - Pre-render computes tight rects, smart render fills them
+// ============================================================================
+
+// Handed from PF_Cmd_SMART_PRE_RENDER to PF_Cmd_SMART_RENDER so the copies
+// are computed once per frame
+struct ReptAllRenderData {
+	ReptAllState				state;
+	CopyInstanceList			instances;      // shared with the transform cache
+	CopyInstanceList			shutter[2];     // open, close; empty without motion blur
+	CopyMotion					motion;        // points into shutter
+	RenderGeometry				geometry;
+	PF_Boolean					hasSource;     // input layer was checked out
+	RenderStats					stats;         // phases 1-3, when instrumented
+};
+
+static void
+DeleteRenderData(void *pre_render_data)
+{
+	delete reinterpret_cast<ReptAllRenderData*>(pre_render_data);
+}
+
+static PF_Err
+PreRender(
+	PF_InData			*in_data,
+	PF_OutData			*out_data,
+	PF_PreRenderExtra	*extra)
+{
+	PF_Err err = PF_Err_NONE, err2 = PF_Err_NONE;
+
+	if (!extra || !extra->input || !extra->output || !extra->cb) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	ReptAllRenderData *dataP = new (std::nothrow) ReptAllRenderData;
+	if (!dataP) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+	dataP->hasSource = FALSE;
+	dataP->stats.Clear();
+
+	RenderStats *statsP = IsRenderStatsEnabled() ? &dataP->stats : NULL;
+
+	// ========================================================================
+	// PHASES 1-3: Parameters, transforms, depth order
+	// ========================================================================
+	PF_ParamDef paramDefs[REPTALL_NUM_PARAMS];
+	PF_ParamDef *params[REPTALL_NUM_PARAMS];
+
+	ERR(CheckoutParams(in_data, in_data->current_time, in_data->time_step, in_data->time_scale,
+					   paramDefs, params));
+	ERR(BuildSortedCopies(in_data, params, &dataP->state, &dataP->instances, statsP));
+	ERR2(CheckinParams(in_data, params));
+	if (!err) {
+		ERR(BuildShutterCopies(in_data, &dataP->state, dataP->shutter, statsP));
+	}
+	dataP->motion.open = dataP->shutter[0].get();
+	dataP->motion.close = dataP->shutter[1].get();
+	const CopyMotion *motionP = dataP->motion.open ? &dataP->motion : NULL;
+
+	// ========================================================================
+	// Result rect: union of projected copy bounds, clipped to the layer
+	// ========================================================================
+	// in_data->width/height are full resolution, the request rects are not
+	const A_long layerWidth = (A_long)ceil(in_data->width * (PF_FpLong)in_data->downsample_x.num / MAX(in_data->downsample_x.den, 1));
+	const A_long layerHeight = (A_long)ceil(in_data->height * (PF_FpLong)in_data->downsample_y.num / MAX(in_data->downsample_y.den, 1));
+	ClearRenderGeometryAE(in_data, layerWidth, layerHeight, &dataP->geometry);
+
+	PF_LRect maxRect = {0, 0, 0, 0};
+	PF_LRect resultRect = {0, 0, 0, 0};
+	PF_LRect sourceRect = {0, 0, 0, 0};
+
+	if (!err) {
+		ERR(ComputeRenderBounds(dataP->instances.get(),
+								motionP,
+								&dataP->geometry,
+								&extra->input->output_request.rect,
+								&maxRect,
+								&resultRect,
+								&sourceRect));
+	}
+
+	// ========================================================================
+	// Check out only the sampled part of the input layer
+	// ========================================================================
+	if (!err && !IsRectEmpty(sourceRect)) {
+		PF_RenderRequest req = extra->input->output_request;
+		PF_CheckoutResult in_result;
+		AEFX_CLR_STRUCT(in_result);
+
+		req.rect = sourceRect;
+		req.preserve_rgb_of_zero_alpha = FALSE;
+
+		ERR(extra->cb->checkout_layer(in_data->effect_ref,
+									  REPTALL_INPUT,
+									  REPTALL_INPUT,
+									  &req,
+									  in_data->current_time,
+									  in_data->time_step,
+									  in_data->time_scale,
+									  &in_result));
+
+		if (!err && !IsRectEmpty(in_result.result_rect)) {
+			dataP->hasSource = TRUE;
+			dataP->geometry.src_origin[0] = in_result.result_rect.left;
+			dataP->geometry.src_origin[1] = in_result.result_rect.top;
+		}
+	}
+
+	if (err) {
+		delete dataP;
+		return err;
+	}
+
+	// The stats overlay sits at the layer origin whether or not copies
+	// cover it, so the output must reach it
+	if (statsP && IsRenderStatsOverlayEnabled()) {
+		PF_LRect overlayRect;
+		GetRenderStatsOverlayRect(layerWidth, layerHeight, &overlayRect);
+		UnionRect(overlayRect, &maxRect);
+		IntersectRect(extra->input->output_request.rect, &overlayRect);
+		UnionRect(overlayRect, &resultRect);
+	}
+
+	// The output world AE allocates covers exactly the returned result rect
+	dataP->geometry.dst_origin[0] = resultRect.left;
+	dataP->geometry.dst_origin[1] = resultRect.top;
+
+	extra->output->result_rect = resultRect;
+	extra->output->max_result_rect = maxRect;
+	extra->output->solid = FALSE;
+	extra->output->pre_render_data = dataP;
+	extra->output->delete_pre_render_data_func = DeleteRenderData;
+
+	if (statsP) {
+		AppendRenderTrace("PreRender", dataP->stats);
+	}
+
+	return err;
+}
+
+static PF_Err
+SmartRender(
+	PF_InData				*in_data,
+	PF_OutData				*out_data,
+	PF_SmartRenderExtra		*extra)
+{
+	PF_Err err = PF_Err_NONE, err2 = PF_Err_NONE;
+
+	if (!extra || !extra->input || !extra->cb) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	// Read-only here: pre-render data belongs to this frame's render request
+	const ReptAllRenderData *dataP = reinterpret_cast<const ReptAllRenderData*>(extra->input->pre_render_data);
+	if (!dataP) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	PF_EffectWorld *inputP = NULL;
+	PF_EffectWorld *outputP = NULL;
+
+	// Phases 1-3 as timed by PreRender, phase 4 added here
+	RenderStats stats = dataP->stats;
+	RenderStats *statsP = IsRenderStatsEnabled() ? &stats : NULL;
+
+	if (dataP->hasSource) {
+		ERR(extra->cb->checkout_layer_pixels(in_data->effect_ref, REPTALL_INPUT, &inputP));
+	}
+	ERR(extra->cb->checkout_output(in_data->effect_ref, &outputP));
+
+	// ========================================================================
+	// PHASE 4: Render all copies into the result rect
+	// ========================================================================
+	if (!err && outputP) {
+		if (inputP) {
+			ERR(RenderCopiesAE(in_data, &dataP->state,
+							   dataP->instances.get(),
+							   dataP->motion.open ? &dataP->motion : NULL,
+							   &dataP->geometry, inputP, outputP, statsP));
+		} else {
+			// Nothing visible in the request: with no copies RenderCopies just clears
+			ERR(RenderCopiesAE(in_data, &dataP->state,
+							   NULL, NULL,
+							   &dataP->geometry, outputP, outputP, statsP));
+		}
+	}
+
+	if (dataP->hasSource) {
+		ERR2(extra->cb->checkin_layer_pixels(in_data->effect_ref, REPTALL_INPUT));
+	}
+
+	if (statsP) {
+		// PreRender already traced phases 1-3
+		for (int p = RENDER_PHASE_PARAMS; p < RENDER_PHASE_RENDER; p++) {
+			stats.phaseStart[p] = 0;
+		}
+		AppendRenderTrace("SmartRender", stats);
+	}
 
 	return err;
 }
@@ -1063,6 +1480,13 @@ EffectMain(
 								output);
 			break;
 
+		case PF_Cmd_GLOBAL_SETDOWN:
+			err = GlobalSetdown(in_data,
+								out_data,
+								params,
+								output);
+			break;
+
 		case PF_Cmd_PARAMS_SETUP:
 			err = ParamsSetup(in_data,
 								out_data,
@@ -1076,6 +1500,18 @@ EffectMain(
 						params,
 						output);
 			break;
+
+		case PF_Cmd_SMART_PRE_RENDER:
+			err = PreRender(in_data,
+							out_data,
+							reinterpret_cast<PF_PreRenderExtra*>(extra));
+			break;
+
+		case PF_Cmd_SMART_RENDER:
+			err = SmartRender(in_data,
+							  out_data,
+							  reinterpret_cast<PF_SmartRenderExtra*>(extra));
+			break;
 	}
 
 	return err;
@@ -26,28 +26,7 @@
 #ifndef REPTALL_H
 #define REPTALL_H
 
-typedef unsigned char		u_char;
-typedef unsigned short		u_short;
-typedef unsigned short		u_int16;
-typedef unsigned long		u_long;
-typedef short int			int16;
-#define PF_TABLE_BITS	12
-#define PF_TABLE_SZ_16	4096
-
-#define PF_DEEP_COLOR_AWARE 1	// make sure we get 16bpc pixels; 
-								// AE_Effect.h checks for this.
-
-#include "AEConfig.h"
-
-#ifdef AE_OS_WIN
-	typedef unsigned short PixelType;
-	#include <Windows.h>
-#endif
-
-#include "entry.h"
-#include "AE_Effect.h"
-#include "AE_EffectCB.h"
-#include "AE_Macros.h"
+#include "ReptAll_Types.h"
 #include "Param_Utils.h"
 #include "AE_EffectCBSuites.h"
 #include "String_Utils.h"
@@ -56,6 +35,7 @@ typedef short int			int16;
 #include "AEGP_SuiteHandler.h"
 
 #include "ReptAll_Strings.h"
+#include "ReptAll_Core.h"
 
 /* Versioning information */
 
@@ -66,38 +46,77 @@ typedef short int			int16;
 #define	BUILD_VERSION	1
 
 
-/* Parameter defaults */
+// Parameters of Effector group e, relative to REPTALL_EFFECTOR_1 and
+// EFFECTOR_1_DISK_ID plus e * EFFECTOR_PARAM_COUNT
+enum {
+	EFFECTOR_TOPIC = 0,
+	EFFECTOR_ENABLE,
+	EFFECTOR_STRENGTH,           // %
+	EFFECTOR_SEED_OFFSET,        // added to the master seed
+	EFFECTOR_PROBABILITY,        // % of copies affected
+	EFFECTOR_POSITION_X,         // position amount (pixels)
+	EFFECTOR_POSITION_Y,
+	EFFECTOR_POSITION_Z,
+	EFFECTOR_ROTATION_X,         // rotation amount (degrees)
+	EFFECTOR_ROTATION_Y,
+	EFFECTOR_ROTATION_Z,
+	EFFECTOR_SCALE_X,            // scale amount (%)
+	EFFECTOR_SCALE_Y,
+	EFFECTOR_SCALE_Z,
+	EFFECTOR_OPACITY,            // opacity amount (%)
+	EFFECTOR_TOPIC_END,
+
+	EFFECTOR_PARAM_COUNT
+};
 
-// 3D Repeater Parameter Defaults
-#define REPTALL_COUNT_MIN       1
-#define REPTALL_COUNT_MAX       10
-#define REPTALL_COUNT_DFLT      3
+// Distribution popup items (1-based)
+enum {
+	DISTRIBUTION_POPUP_UNIFORM = 1,
+	DISTRIBUTION_POPUP_CENTERED,
+	DISTRIBUTION_POPUP_COUNT = DISTRIBUTION_POPUP_CENTERED
+};
 
-#define REPTALL_TRANSLATE_MIN   -500.0
-#define REPTALL_TRANSLATE_MAX   500.0
-#define REPTALL_TRANSLATE_DFLT  0.0
+// Field popup items (1-based), in the order of the ReptAll_Fields.h enums
+enum {
+	FIELD_SHAPE_POPUP_NONE = 1,
+	FIELD_SHAPE_POPUP_BOX,
+	FIELD_SHAPE_POPUP_SPHERE,
+	FIELD_SHAPE_POPUP_COUNT = FIELD_SHAPE_POPUP_SPHERE
+};
 
-#define REPTALL_ROTATE_MIN      -360.0
-#define REPTALL_ROTATE_MAX      360.0
-#define REPTALL_ROTATE_DFLT     0.0
+enum {
+	FIELD_INDEX_POPUP_NONE = 1,
+	FIELD_INDEX_POPUP_RANGE,
+	FIELD_INDEX_POPUP_COUNT = FIELD_INDEX_POPUP_RANGE
+};
+
+enum {
+	FIELD_CURVE_POPUP_LINEAR = 1,
+	FIELD_CURVE_POPUP_EASE_IN_OUT,
+	FIELD_CURVE_POPUP_COUNT = FIELD_CURVE_POPUP_EASE_IN_OUT
+};
 
-#define REPTALL_SCALE_MIN       10.0
-#define REPTALL_SCALE_MAX       200.0
-#define REPTALL_SCALE_DFLT      100.0
+enum {
+	FIELD_COMBINE_POPUP_MULTIPLY = 1,
+	FIELD_COMBINE_POPUP_MIN,
+	FIELD_COMBINE_POPUP_MAX,
+	FIELD_COMBINE_POPUP_COUNT = FIELD_COMBINE_POPUP_MAX
+};
 
 // ============================================================================
 // Unified Parameter Indices
 // ============================================================================
 // Parameter indices used for array indexing - must match order in ParamsSetup
 // Bounds checking is performed at runtime through parameter count validation
+// SmartFX checks parameters out by index, so only registered parameters may
+// appear here. Copies Y/Z, base transform, opacity, offset and composite
+// parameters are planned (see PARAMETER_SPEC.md) but not registered yet.
 
 enum {
 	REPTALL_INPUT = 0,           // Source layer input
 
 	// Copy count parameters
 	REPTALL_COPIES_X = 1,        // Number of copies in X
-	REPTALL_COPIES_Y,            // Number of copies in Y
-	REPTALL_COPIES_Z,            // Number of copies in Z
 
 	// Transform step parameters
 	REPTALL_STEP_X,              // X step per copy
@@ -107,25 +126,41 @@ enum {
 	REPTALL_STEP_ROTATE_Y,       // Y rotation step per copy
 	REPTALL_STEP_ROTATE_Z,       // Z rotation step per copy
 	REPTALL_STEP_SCALE,          // Scale step per copy (%)
-	REPTALL_STEP_OPACITY,        // Opacity step per copy
-
-	// Base transform parameters
-	REPTALL_BASE_POS_X,          // Base position X
-	REPTALL_BASE_POS_Y,          // Base position Y
-	REPTALL_BASE_POS_Z,          // Base position Z
-	REPTALL_BASE_ROT_X,          // Base rotation X
-	REPTALL_BASE_ROT_Y,          // Base rotation Y
-	REPTALL_BASE_ROT_Z,          // Base rotation Z
-	REPTALL_BASE_SCALE,          // Base scale
-	REPTALL_BASE_OPACITY,        // Base opacity
-
-	// Offset/distribution parameters
-	REPTALL_OFFSET_MODE,         // Offset mode (linear/radial/etc)
-	REPTALL_OFFSET_VALUE,        // Offset value
-
-	// Camera/composite parameters
-	REPTALL_COMP_MODE,           // Composite mode (add/screen/normal/etc)
-	REPTALL_CAMERA_AWARE,        // Enable camera depth sorting
+
+	// Rendering options
+	REPTALL_FRONT_TO_BACK,       // Composite nearest copy first (Normal blend)
+
+	// Random group
+	REPTALL_RANDOM_TOPIC,
+	REPTALL_RANDOM_SEED,         // master seed
+	REPTALL_RANDOM_STRENGTH,     // master strength (%)
+	REPTALL_RANDOM_DISTRIBUTION, // popup, DISTRIBUTION_POPUP_*
+
+	// Fields (inside the Random group)
+	REPTALL_FIELDS_TOPIC,
+	REPTALL_SPATIAL_FIELD_TOPIC,
+	REPTALL_SPATIAL_FIELD_TYPE,  // popup, FIELD_SHAPE_POPUP_*
+	REPTALL_SPATIAL_FIELD_CENTER_X,
+	REPTALL_SPATIAL_FIELD_CENTER_Y,
+	REPTALL_SPATIAL_FIELD_CENTER_Z,
+	REPTALL_SPATIAL_FIELD_SIZE_X,
+	REPTALL_SPATIAL_FIELD_SIZE_Y,
+	REPTALL_SPATIAL_FIELD_SIZE_Z,
+	REPTALL_SPATIAL_FIELD_CURVE, // popup, FIELD_CURVE_POPUP_*
+	REPTALL_SPATIAL_FIELD_INVERT,
+	REPTALL_SPATIAL_FIELD_TOPIC_END,
+	REPTALL_INDEX_FIELD_TOPIC,
+	REPTALL_INDEX_FIELD_TYPE,    // popup, FIELD_INDEX_POPUP_*
+	REPTALL_INDEX_FIELD_START,   // %
+	REPTALL_INDEX_FIELD_END,     // %
+	REPTALL_INDEX_FIELD_CURVE,   // popup, FIELD_CURVE_POPUP_*
+	REPTALL_INDEX_FIELD_TOPIC_END,
+	REPTALL_FIELD_COMBINE,       // popup, FIELD_COMBINE_POPUP_*
+	REPTALL_FIELDS_TOPIC_END,
+
+	REPTALL_EFFECTOR_1,          // first of REPTALL_EFFECTOR_COUNT groups of
+	                             // EFFECTOR_PARAM_COUNT parameters
+	REPTALL_RANDOM_TOPIC_END = REPTALL_EFFECTOR_1 + REPTALL_EFFECTOR_COUNT * EFFECTOR_PARAM_COUNT,
 
 	REPTALL_NUM_PARAMS           // Must be last, represents total parameter count
 };
@@ -155,98 +190,38 @@ enum {
 	OFFSET_VALUE_DISK_ID,
 	COMP_MODE_DISK_ID,
 	CAMERA_AWARE_DISK_ID,
+	FRONT_TO_BACK_DISK_ID,
+	RANDOM_TOPIC_DISK_ID,
+	RANDOM_SEED_DISK_ID,
+	RANDOM_STRENGTH_DISK_ID,
+	RANDOM_DISTRIBUTION_DISK_ID,
+	RANDOM_TOPIC_END_DISK_ID,
+	EFFECTOR_1_DISK_ID,          // REPTALL_EFFECTOR_COUNT * EFFECTOR_PARAM_COUNT IDs
+	EFFECTOR_DISK_ID_END = EFFECTOR_1_DISK_ID + REPTALL_EFFECTOR_COUNT * EFFECTOR_PARAM_COUNT,
+	FIELDS_TOPIC_DISK_ID = EFFECTOR_DISK_ID_END,
+	SPATIAL_FIELD_TOPIC_DISK_ID,
+	SPATIAL_FIELD_TYPE_DISK_ID,
+	SPATIAL_FIELD_CENTER_X_DISK_ID,
+	SPATIAL_FIELD_CENTER_Y_DISK_ID,
+	SPATIAL_FIELD_CENTER_Z_DISK_ID,
+	SPATIAL_FIELD_SIZE_X_DISK_ID,
+	SPATIAL_FIELD_SIZE_Y_DISK_ID,
+	SPATIAL_FIELD_SIZE_Z_DISK_ID,
+	SPATIAL_FIELD_CURVE_DISK_ID,
+	SPATIAL_FIELD_INVERT_DISK_ID,
+	SPATIAL_FIELD_TOPIC_END_DISK_ID,
+	INDEX_FIELD_TOPIC_DISK_ID,
+	INDEX_FIELD_TYPE_DISK_ID,
+	INDEX_FIELD_START_DISK_ID,
+	INDEX_FIELD_END_DISK_ID,
+	INDEX_FIELD_CURVE_DISK_ID,
+	INDEX_FIELD_TOPIC_END_DISK_ID,
+	FIELD_COMBINE_DISK_ID,
+	FIELDS_TOPIC_END_DISK_ID,
 };
 
 // ============================================================================
-// Data Structures - Scalable architecture for full parameter support
-// ============================================================================
-
-// Per-copy transform state
-// Represents the complete transform of a single copy
-struct CopyTransform {
-	PF_FpLong position[3];        // x, y, z position
-	PF_FpLong rotation[3];        // x, y, z rotation (degrees)
-	PF_FpLong scale;              // uniform scale (percent)
-	PF_FpLong opacity;            // opacity (0-100)
-	PF_FpLong world_matrix[16];   // 4x4 transformation matrix
-	PF_FpLong view_scale;         // perspective scale factor
-	A_Boolean visible;            // visibility flag
-	PF_FpLong camera_depth;       // distance from camera for sorting
-
-	// Constructor for auto-initialization
-	CopyTransform() {
-		Clear();
-	}
-
-	// Initialize to default values
-	void Clear() {
-		for (int i = 0; i < 3; i++) {
-			position[i] = 0.0;
-			rotation[i] = 0.0;
-		}
-		scale = 100.0;
-		opacity = 100.0;
-		for (int i = 0; i < 16; i++) {
-			world_matrix[i] = (i % 5 == 0) ? 1.0 : 0.0;  // Identity matrix
-		}
-		view_scale = 1.0;
-		visible = TRUE;
-		camera_depth = 0.0;
-	}
-};
-
-// Complete parameter state
-// Holds all user-adjustable parameters from the effect UI
-struct ReptAllState {
-	// 3D grid dimensions
-	A_long copies[3];             // copies in X, Y, Z directions
-
-	// Offset/distribution
-	PF_FpLong offset;             // global offset value
-
-	// Anchor point
-	PF_FpLong anchor[3];          // anchor x, y, z
-
-	// Base transform (initial state before stepping)
-	PF_FpLong position[3];        // base position x, y, z
-	PF_FpLong scale;              // base uniform scale (percent)
-	PF_FpLong rotation[3];        // base rotation x, y, z
-
-	// Step values (increment per copy)
-	PF_FpLong step_position[3];   // step x, y, z per copy
-	PF_FpLong step_rotation[3];   // step rotation x, y, z per copy
-	PF_FpLong step_scale;         // step uniform scale (percent)
-
-	// Opacity
-	PF_FpLong opacity_start;      // starting opacity (first copy)
-	PF_FpLong opacity_end;        // ending opacity (last copy)
-
-	// Rendering options
-	A_Boolean camera_aware;       // enable depth-based sorting
-	A_long composite_mode;        // blending mode
-
-	// Initialize to defaults
-	void Clear() {
-		for (int i = 0; i < 3; i++) {
-			copies[i] = (i == 0) ? REPTALL_COUNT_DFLT : 1;
-			anchor[i] = 0.0;
-			position[i] = 0.0;
-			rotation[i] = 0.0;
-			step_position[i] = (i == 0) ? REPTALL_TRANSLATE_DFLT : 0.0;
-			step_rotation[i] = 0.0;
-		}
-		scale = 100.0;
-		step_scale = 100.0;
-		offset = 0.0;
-		opacity_start = 100.0;
-		opacity_end = 100.0;
-		camera_aware = TRUE;
-		composite_mode = 0;  // Normal blend
-	}
-};
-
-// ============================================================================
-// Helper Function Declarations - Split Render() into phases
+// Host-side phases (the rest live in ReptAll_Core.h)
 // ============================================================================
 
 #ifdef __cplusplus
@@ -259,28 +234,14 @@ extern "C" {
 		PF_ParamDef		*params[],
 		ReptAllState	*outState);
 
-	// Phase 2: Compute transform for each copy (handles stepping)
-	PF_Err ComputeCopyTransforms(
-		const ReptAllState	*state,
-		CopyTransform		*transforms,
-		A_long				*numTransforms,
-		PF_InData			*in_data);
-
-	// Phase 3: Sort copies by camera depth for proper Z-order
-	void SortCopiesByDepth(
-		CopyTransform	*transforms,
-		A_long			count,
-		PF_Boolean		cameraAware);
-
-	// Phase 4: Render each copy with bilinear sampling
-	PF_Err RenderCopies(
-		PF_InData		*in_data,
-		PF_OutData		*out_data,
+	// Phase 2a: Query the active 3D camera at time / time_scale (honours
+	// state->camera_aware)
+	PF_Err QueryCopyCamera(
+		PF_InData			*in_data,
 		const ReptAllState	*state,
-		const CopyTransform	*transforms,
-		A_long			transformCount,
-		PF_EffectWorld	*srcP,
-		PF_LayerDef		*output);
+		A_long				time,
+		A_u_long			time_scale,
+		CopyCamera			*camera);
 
 #ifdef __cplusplus
 }
@@ -49,10 +49,14 @@ resource 'PiPL' (16000) {
 		},
 		/* [10] */
 		AE_Effect_Global_OutFlags {
-		0x06000000	/* PF_OutFlag_DEEP_COLOR_AWARE (0x02000000) | PF_OutFlag_FLOAT_COLOR_AWARE (0x04000000) */
+		0x06080002	/* PF_OutFlag_WIDE_TIME_INPUT (0x2) | PF_OutFlag_I_USE_SHUTTER_ANGLE (0x80000) |
+		               PF_OutFlag_DEEP_COLOR_AWARE (0x02000000) | PF_OutFlag_FLOAT_COLOR_AWARE (0x04000000) */
 		},
 		AE_Effect_Global_OutFlags_2 {
-		6  /* PF_OutFlag2_I_USE_3D_CAMERA (0x2) | PF_OutFlag2_I_USE_3D_LIGHTS (0x4) */
+		0x08021406  /* PF_OutFlag2_I_USE_3D_CAMERA (0x2) | PF_OutFlag2_I_USE_3D_LIGHTS (0x4) |
+		               PF_OutFlag2_SUPPORTS_SMART_RENDER (0x400) | PF_OutFlag2_FLOAT_COLOR_AWARE (0x1000) |
+		               PF_OutFlag2_AUTOMATIC_WIDE_TIME_INPUT (0x20000) |
+		               PF_OutFlag2_SUPPORTS_THREADED_RENDERING (0x8000000) */
 	},
 		/* [11] */
 		AE_Effect_Match_Name {
@@ -0,0 +1,673 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Bench.cpp
+
+	reptall-bench: timings of the render phases over a sweep of workloads,
+	written as JSON so releases can be compared.
+
+	reptall-bench [options] [--output FILE]
+
+	Every case renders a full layer (no SmartFX tiling) of a synthetic
+	source: an opaque disc, a quarter of the layer across, with soft edges
+	on an otherwise transparent layer. The copies are laid out on a grid
+	that fills the frame, scaled so each overlaps its neighbours, so the
+	covered area stays about the same from 1 to 100k copies. Modes:
+
+		translate   grid only
+		rotate      every copy turned 37 degrees further than the last
+		scale       copies shrink to half size along the grid
+		opacity     copies fade to 10% along the grid (no early-out)
+		turn        every copy turned by the same angle (only in --sweep angles)
+
+	Each phase is timed over --repeat runs after a warm-up run; the JSON
+	has the minimum and median per phase and the output pixels per second
+	of the render phase and of the whole pipeline.
+
+	Options (lists are comma separated):
+		--depths 8,16,32                bits per channel
+		--sizes hd,4k,8k                layer size (also WxH)
+		--copies 1,10,100,1000,10000,100000
+		--modes translate,rotate,scale,opacity
+		--threads N                     render threads (default: all processors)
+		--repeat N                      timed runs per case (default 5)
+		--quick                         hd and 4k, up to 10k copies, 3 runs
+		--sweep threads                 also time 1, 2, 4 .. N threads
+		--sweep angles                  also time one full-size copy turned
+		                                0, 30, 45, 60 and 90 degrees
+		--sweep quality                 also time full, half and quarter
+		                                resolution, each at best and draft
+		                                quality
+		--sweep sort                    also time SortCopiesByDepth alone on
+		                                1k, 100k and 1M random depths, cold
+		                                and repairing the previous frame's
+		                                order after every depth moved by
+		                                about two neighbours
+*/
+
+#include "ReptAll_Core.h"
+#include "ReptAll_Instances.h"
+#include "ReptAll_Sampling.h"
+#include "ReptAll_ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One benchmark case
+struct BenchCase {
+	A_long		depth;
+	A_long		width;
+	A_long		height;
+	std::string	sizeName;
+	A_long		copies;
+	std::string	mode;
+	PF_FpLong	angle;          // Z rotation of every copy in "turn" mode (degrees)
+	A_long		threads;
+	A_long		downsample;     // layer pixels per buffer pixel (1 = full resolution)
+	bool		draft;          // ReptAllState::draft
+	std::string	sweep;          // "" for the main sweep, else "threads" / "angles" / "quality" /
+	                            // "sort"
+
+	// Buffer size at the downsample factor
+	A_long BufferWidth() const { return (width + downsample - 1) / downsample; }
+	A_long BufferHeight() const { return (height + downsample - 1) / downsample; }
+};
+
+// Phases timed per run
+enum {
+	BENCH_PHASE_PARAMS = 0,     // state of the case
+	BENCH_PHASE_TRANSFORMS,     // ComputeCopyTransforms
+	BENCH_PHASE_SORT,           // SortCopiesByDepth
+	BENCH_PHASE_BOUNDS,         // ComputeRenderBounds
+	BENCH_PHASE_RENDER,         // RenderCopies
+	BENCH_PHASE_TOTAL,
+	BENCH_PHASE_COUNT
+};
+
+static const char *kPhaseNames[BENCH_PHASE_COUNT] = {
+	"params", "transforms", "sort", "bounds", "render", "total"
+};
+
+// Premultiplied buffer in the core's pixel layout
+struct BenchWorld {
+	std::vector<char>	storage;
+	PF_EffectWorld		world;
+
+	void Allocate(A_long width, A_long height, A_long depth) {
+		A_long pixelSize = depth == 32 ? (A_long)sizeof(PF_PixelFloat) :
+						   depth == 16 ? (A_long)sizeof(PF_Pixel16) : (A_long)sizeof(PF_Pixel);
+		storage.assign((size_t)width * height * pixelSize, 0);
+		world.data = (PF_PixelPtr)storage.data();
+		world.rowbytes = width * pixelSize;
+		world.width = width;
+		world.height = height;
+	}
+};
+
+// Disc of diameter height / 2 in the middle of the layer, one pixel of
+// antialiased edge, colors varying across it
+static void
+MakeSource(
+	A_long		width,
+	A_long		height,
+	A_long		depth,
+	BenchWorld	*source)
+{
+	source->Allocate(width, height, depth);
+
+	const double cx = width / 2.0, cy = height / 2.0, radius = height / 4.0;
+
+	for (A_long y = 0; y < height; y++) {
+		char *row = (char*)source->world.data + (size_t)y * source->world.rowbytes;
+
+		for (A_long x = 0; x < width; x++) {
+			const double dx = x + 0.5 - cx, dy = y + 0.5 - cy;
+			const double a = std::min(1.0, std::max(0.0, radius - std::sqrt(dx * dx + dy * dy) + 0.5));
+			if (a <= 0.0) {
+				continue;
+			}
+
+			const double r = a * (0.5 + 0.5 * dx / radius);
+			const double g = a * (0.5 + 0.5 * dy / radius);
+			const double b = a * 0.75;
+
+			if (depth == 32) {
+				PF_PixelFloat *p = (PF_PixelFloat*)row + x;
+				p->alpha = (PF_FpShort)a;
+				p->red = (PF_FpShort)r;
+				p->green = (PF_FpShort)g;
+				p->blue = (PF_FpShort)b;
+			} else if (depth == 16) {
+				PF_Pixel16 *p = (PF_Pixel16*)row + x;
+				p->alpha = (A_u_short)(a * PF_MAX_CHAN16 + 0.5);
+				p->red = (A_u_short)(r * PF_MAX_CHAN16 + 0.5);
+				p->green = (A_u_short)(g * PF_MAX_CHAN16 + 0.5);
+				p->blue = (A_u_short)(b * PF_MAX_CHAN16 + 0.5);
+			} else {
+				PF_Pixel *p = (PF_Pixel*)row + x;
+				p->alpha = (A_u_char)(a * PF_MAX_CHAN8 + 0.5);
+				p->red = (A_u_char)(r * PF_MAX_CHAN8 + 0.5);
+				p->green = (A_u_char)(g * PF_MAX_CHAN8 + 0.5);
+				p->blue = (A_u_char)(b * PF_MAX_CHAN8 + 0.5);
+			}
+		}
+	}
+}
+
+// Grid and per-copy steps of a case
+static void
+MakeState(
+	const BenchCase&	c,
+	ReptAllState		*state)
+{
+	// Most nearly square cols x rows == copies
+	A_long rows = (A_long)std::sqrt((double)c.copies * c.height / c.width);
+	rows = std::max<A_long>(1, rows);
+	while (c.copies % rows) {
+		rows--;
+	}
+	const A_long cols = c.copies / rows;
+	const double cellW = (double)c.width / cols;
+	const double cellH = (double)c.height / rows;
+
+	state->Clear();
+	state->copies[0] = cols;
+	state->copies[1] = rows;
+	state->copies[2] = 1;
+	state->step_position[0] = cols > 1 ? cellW : 0.0;
+	state->step_position[1] = rows > 1 ? cellH : 0.0;
+	state->step_position[2] = 0.0;
+	state->position[0] = -0.5 * (cols - 1) * state->step_position[0];
+	state->position[1] = -0.5 * (rows - 1) * state->step_position[1];
+
+	// The disc spans height / 2 at 100%; make it 1.5 cells across
+	state->scale = std::min(100.0, 100.0 * 1.5 * std::max(cellW, cellH) / (c.height / 2.0));
+	state->step_scale = 100.0;
+
+	if (c.mode == "rotate") {
+		state->step_rotation[2] = 37.0;
+	} else if (c.mode == "scale" && c.copies > 1) {
+		state->step_scale = 100.0 * std::pow(0.5, 1.0 / (c.copies - 1));
+	} else if (c.mode == "opacity") {
+		state->opacity_end = 10.0;
+	} else if (c.mode == "turn") {
+		state->rotation[2] = c.angle;
+	}
+}
+
+static double
+Median(std::vector<double> v)
+{
+	std::sort(v.begin(), v.end());
+	const size_t n = v.size();
+	return n ? (n & 1 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2])) : 0.0;
+}
+
+static const char*
+GetKernelName(const SampleKernels *kernels)
+{
+	switch (kernels->level) {
+		case SAMPLE_KERNEL_SSE41:	return "sse4.1";
+		case SAMPLE_KERNEL_AVX2:	return "avx2";
+		case SAMPLE_KERNEL_NEON:	return "neon";
+		default:					return "scalar";
+	}
+}
+
+// Times every phase of c; samples[phase] gets one entry per timed run
+static PF_Err
+RunCase(
+	const BenchCase&		c,
+	const BenchWorld&		source,
+	BenchWorld				*output,
+	A_long					repeat,
+	std::vector<double>		samples[BENCH_PHASE_COUNT])
+{
+	typedef std::chrono::steady_clock Clock;
+	PF_Err err = PF_Err_NONE;
+
+	RenderThreadPool *pool = NULL;
+	ERR(CreateRenderThreadPool(c.threads, &pool));
+	if (err) {
+		return err;
+	}
+
+	RenderHost host;
+	GetRenderThreadPoolHost(pool, &host);
+
+	RenderGeometry geometry;
+	geometry.Clear(c.BufferWidth(), c.BufferHeight());
+	geometry.downsample[0] = geometry.downsample[1] = 1.0 / c.downsample;
+
+	CopyCamera camera;
+	camera.Clear();
+
+	const PF_LRect requestRect = {0, 0, c.BufferWidth(), c.BufferHeight()};
+
+	// Run 0 warms caches and the instance arena pool and is not recorded
+	for (A_long run = 0; run <= repeat && !err; run++) {
+		Clock::time_point t[BENCH_PHASE_COUNT];
+		ReptAllState state;
+		std::shared_ptr<CopyInstanceBuffer> instances;
+		PF_LRect maxRect, resultRect, sourceRect;
+
+		t[0] = Clock::now();
+		MakeState(c, &state);
+		state.draft = c.draft;
+		t[1] = Clock::now();
+		ERR(AcquireCopyInstances(c.copies, &instances));
+		ERR(ComputeCopyTransforms(&state, &camera, instances.get()));
+		t[2] = Clock::now();
+		ERR(SortCopiesByDepth(instances.get(), state.camera_aware, NULL));
+		t[3] = Clock::now();
+		ERR(ComputeRenderBounds(instances.get(), NULL, &geometry, &requestRect, &maxRect, &resultRect, &sourceRect));
+		t[4] = Clock::now();
+		ERR(RenderCopies(&host, &state, instances.get(), NULL, &geometry, c.depth,
+						 const_cast<PF_EffectWorld*>(&source.world), &output->world));
+		t[5] = Clock::now();
+
+		if (run > 0 && !err) {
+			for (int p = 0; p < BENCH_PHASE_TOTAL; p++) {
+				samples[p].push_back(std::chrono::duration<double, std::milli>(t[p + 1] - t[p]).count());
+			}
+			samples[BENCH_PHASE_TOTAL].push_back(std::chrono::duration<double, std::milli>(t[5] - t[0]).count());
+		}
+	}
+
+	DisposeRenderThreadPool(pool);
+	return err;
+}
+
+// Times SortCopiesByDepth alone on c.copies random depths: mode "cold"
+// sorts without a hint, "hint" hands it the order of the previous frame,
+// whose depths were each about two neighbours away
+static PF_Err
+RunSortCase(
+	const BenchCase&		c,
+	A_long					repeat,
+	std::vector<double>		samples[BENCH_PHASE_COUNT])
+{
+	typedef std::chrono::steady_clock Clock;
+	PF_Err err = PF_Err_NONE;
+
+	std::shared_ptr<CopyInstanceBuffer> instances;
+	ERR(AcquireCopyInstances(c.copies, &instances));
+	if (err) {
+		return err;
+	}
+	instances->count = c.copies;
+
+	// Reproducible depths in [0, 1000) from a 64-bit LCG
+	A_u_longlong state = 0x853C49E6748FEA9Bull;
+	auto next = [&state]() {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return (double)(state >> 40) * (1.0 / 16777216.0);
+	};
+	for (A_long i = 0; i < c.copies; i++) {
+		instances->depth[i] = (float)(1000.0 * next());
+	}
+
+	std::vector<A_u_long> previous;
+	if (c.mode == "hint") {
+		ERR(SortCopiesByDepth(instances.get(), TRUE, NULL));
+		previous.assign(instances->order, instances->order + c.copies);
+		const double spacing = 1000.0 / c.copies;
+		for (A_long i = 0; i < c.copies; i++) {
+			instances->depth[i] += (float)(spacing * (4.0 * next() - 2.0));
+		}
+	}
+
+	// Run 0 is a warm-up and is not recorded
+	for (A_long run = 0; run <= repeat && !err; run++) {
+		const Clock::time_point start = Clock::now();
+		ERR(SortCopiesByDepth(instances.get(), TRUE, previous.empty() ? NULL : previous.data()));
+		const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		if (run > 0 && !err) {
+			samples[BENCH_PHASE_SORT].push_back(ms);
+			samples[BENCH_PHASE_TOTAL].push_back(ms);
+		}
+	}
+
+	return err;
+}
+
+static void
+WriteSortCaseJSON(
+	FILE					*fp,
+	const BenchCase&		c,
+	std::vector<double>		samples[BENCH_PHASE_COUNT],
+	bool					first)
+{
+	const std::vector<double>& s = samples[BENCH_PHASE_SORT];
+	const double sortMs = Median(s);
+
+	fprintf(fp, "%s    {\"name\": \"sort/%d/%s\", \"copies\": %d, \"hint\": \"%s\", \"sweep\": \"sort\",\n",
+			first ? "" : ",\n", (int)c.copies, c.mode.c_str(), (int)c.copies,
+			c.mode == "hint" ? "previous" : "none");
+	fprintf(fp, "     \"phases_ms\": {\"sort\": {\"min\": %.4f, \"median\": %.4f}},\n",
+			s.empty() ? 0.0 : *std::min_element(s.begin(), s.end()), sortMs);
+	fprintf(fp, "     \"copies_per_s\": %.6g}", sortMs > 0.0 ? c.copies * 1000.0 / sortMs : 0.0);
+}
+
+static void
+WriteCaseJSON(
+	FILE					*fp,
+	const BenchCase&		c,
+	std::vector<double>		samples[BENCH_PHASE_COUNT],
+	bool					first)
+{
+	const double pixels = (double)c.BufferWidth() * c.BufferHeight();
+	const double renderMs = Median(samples[BENCH_PHASE_RENDER]);
+	const double totalMs = Median(samples[BENCH_PHASE_TOTAL]);
+
+	const std::string mode = c.mode == "turn" ? c.mode + std::to_string((int)c.angle) : c.mode;
+
+	fprintf(fp, "%s    {\"name\": \"%s%s%d/%s/%d/%s\", ", first ? "" : ",\n", c.sweep.c_str(), c.sweep.empty() ? "" : "/",
+			(int)c.depth, c.sizeName.c_str(), (int)c.copies, mode.c_str());
+	fprintf(fp, "\"depth\": %d, \"width\": %d, \"height\": %d, \"copies\": %d, \"mode\": \"%s\", \"angle\": %g, ",
+			(int)c.depth, (int)c.width, (int)c.height, (int)c.copies, c.mode.c_str(), c.angle);
+	fprintf(fp, "\"threads\": %d, \"downsample\": %d, \"draft\": %s, \"sweep\": \"%s\",\n",
+			(int)c.threads, (int)c.downsample, c.draft ? "true" : "false",
+			c.sweep.empty() ? "main" : c.sweep.c_str());
+	fprintf(fp, "     \"phases_ms\": {");
+	for (int p = 0; p < BENCH_PHASE_COUNT; p++) {
+		const std::vector<double>& s = samples[p];
+		fprintf(fp, "%s\"%s\": {\"min\": %.4f, \"median\": %.4f}", p ? ", " : "", kPhaseNames[p],
+				s.empty() ? 0.0 : *std::min_element(s.begin(), s.end()), Median(s));
+	}
+	fprintf(fp, "},\n     \"render_pixels_per_s\": %.6g, \"total_pixels_per_s\": %.6g}",
+			renderMs > 0.0 ? pixels * 1000.0 / renderMs : 0.0,
+			totalMs > 0.0 ? pixels * 1000.0 / totalMs : 0.0);
+}
+
+// Splits a comma separated list
+static std::vector<std::string>
+SplitList(const char *list)
+{
+	std::vector<std::string> items;
+	std::stringstream in(list);
+	std::string item;
+	while (std::getline(in, item, ',')) {
+		if (!item.empty()) {
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+static bool
+ParseSize(
+	const std::string&	name,
+	A_long				*width,
+	A_long				*height)
+{
+	if (name == "hd") {
+		*width = 1920; *height = 1080;
+	} else if (name == "4k") {
+		*width = 3840; *height = 2160;
+	} else if (name == "8k") {
+		*width = 7680; *height = 4320;
+	} else {
+		int w = 0, h = 0;
+		if (sscanf(name.c_str(), "%dx%d", &w, &h) != 2 || w < 16 || h < 16 || w > 32768 || h > 32768) {
+			return false;
+		}
+		*width = w;
+		*height = h;
+	}
+	return true;
+}
+
+static void
+Usage(void)
+{
+	fprintf(stderr,
+			"usage: reptall-bench [--depths 8,16,32] [--sizes hd,4k,8k] [--copies 1,10,...]\n"
+			"                     [--modes translate,rotate,scale,opacity] [--threads N]\n"
+			"                     [--repeat N] [--quick] [--sweep threads|angles|quality|sort]\n"
+			"                     [--output FILE]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	std::vector<std::string> depths = SplitList("8,16,32");
+	std::vector<std::string> sizes = SplitList("hd,4k,8k");
+	std::vector<std::string> copies = SplitList("1,10,100,1000,10000,100000");
+	std::vector<std::string> modes = SplitList("translate,rotate,scale,opacity");
+	A_long maxThreads = (A_long)std::max(1u, std::thread::hardware_concurrency());
+	A_long repeat = 5;
+	bool sweepThreads = false, sweepAngles = false, sweepQuality = false, sweepSort = false;
+	const char *outputPath = NULL;
+
+	for (int a = 1; a < argc; a++) {
+		std::string arg = argv[a];
+		bool hasValue = a + 1 < argc;
+
+		if (arg == "--depths" && hasValue) {
+			depths = SplitList(argv[++a]);
+		} else if (arg == "--sizes" && hasValue) {
+			sizes = SplitList(argv[++a]);
+		} else if (arg == "--copies" && hasValue) {
+			copies = SplitList(argv[++a]);
+		} else if (arg == "--modes" && hasValue) {
+			modes = SplitList(argv[++a]);
+		} else if (arg == "--threads" && hasValue) {
+			maxThreads = atoi(argv[++a]);
+		} else if (arg == "--repeat" && hasValue) {
+			repeat = atoi(argv[++a]);
+		} else if (arg == "--quick") {
+			sizes = SplitList("hd,4k");
+			copies = SplitList("1,10,100,1000,10000");
+			repeat = 3;
+		} else if (arg == "--sweep" && hasValue) {
+			std::string sweep = argv[++a];
+			sweepThreads = sweepThreads || sweep == "threads";
+			sweepAngles = sweepAngles || sweep == "angles";
+			sweepQuality = sweepQuality || sweep == "quality";
+			sweepSort = sweepSort || sweep == "sort";
+			if (sweep != "threads" && sweep != "angles" && sweep != "quality" &&
+				sweep != "sort") {
+				Usage();
+				return 2;
+			}
+		} else if (arg == "--output" && hasValue) {
+			outputPath = argv[++a];
+		} else {
+			Usage();
+			return 2;
+		}
+	}
+
+	if (maxThreads < 1 || repeat < 1) {
+		Usage();
+		return 2;
+	}
+
+	// Main sweep, then the extra sweeps on the rotated 4k (or largest) case
+	std::vector<BenchCase> cases;
+	for (const std::string& size : sizes) {
+		for (const std::string& depth : depths) {
+			for (const std::string& count : copies) {
+				for (const std::string& mode : modes) {
+					BenchCase c;
+					c.depth = atoi(depth.c_str());
+					c.sizeName = size;
+					c.copies = atoi(count.c_str());
+					c.mode = mode;
+					c.angle = 0.0;
+					c.threads = maxThreads;
+					c.downsample = 1;
+					c.draft = false;
+
+					if (!ParseSize(size, &c.width, &c.height) ||
+						(c.depth != 8 && c.depth != 16 && c.depth != 32) ||
+						c.copies < 1 || c.copies > MAX_COPIES ||
+						(mode != "translate" && mode != "rotate" && mode != "scale" && mode != "opacity")) {
+						fprintf(stderr, "reptall-bench: bad case %s/%s/%s/%s\n",
+								depth.c_str(), size.c_str(), count.c_str(), mode.c_str());
+						return 2;
+					}
+					cases.push_back(c);
+				}
+			}
+		}
+	}
+
+	if (cases.empty()) {
+		Usage();
+		return 2;
+	}
+
+	BenchCase base = cases.back();
+	for (const BenchCase& c : cases) {
+		if (c.sizeName == "4k" && c.mode == "rotate" && c.copies == 1000 && c.depth == 8) {
+			base = c;
+		}
+	}
+
+	if (sweepThreads) {
+		for (A_long threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+			BenchCase c = base;
+			c.threads = threads;
+			c.sweep = "threads";
+			cases.push_back(c);
+			if (threads == maxThreads) {
+				break;
+			}
+		}
+	}
+	if (sweepAngles) {
+		const PF_FpLong angles[] = {0.0, 30.0, 45.0, 60.0, 90.0};
+		for (PF_FpLong angle : angles) {
+			BenchCase c = base;
+			c.copies = 1;
+			c.mode = "turn";
+			c.angle = angle;
+			c.sweep = "angles";
+			cases.push_back(c);
+		}
+	}
+	if (sweepQuality) {
+		for (A_long downsample = 1; downsample <= 4; downsample *= 2) {
+			for (int draft = 0; draft < 2; draft++) {
+				BenchCase c = base;
+				c.downsample = downsample;
+				c.draft = draft != 0;
+				c.sweep = "quality";
+				cases.push_back(c);
+			}
+		}
+	}
+	if (sweepSort) {
+		const A_long counts[] = {1000, 100000, 1000000};
+		for (A_long count : counts) {
+			for (const char *hint : {"cold", "hint"}) {
+				BenchCase c = base;
+				c.copies = count;
+				c.mode = hint;
+				c.sweep = "sort";
+				cases.push_back(c);
+			}
+		}
+	}
+
+	FILE *fp = outputPath ? fopen(outputPath, "w") : stdout;
+	if (!fp) {
+		fprintf(stderr, "reptall-bench: cannot create %s\n", outputPath);
+		return 1;
+	}
+
+	fprintf(fp, "{\n  \"benchmark\": \"reptall-bench\",\n");
+	fprintf(fp, "  \"kernels\": \"%s\",\n", GetKernelName(GetSampleKernels()));
+	fprintf(fp, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(fp, "  \"repeat\": %d,\n", (int)repeat);
+	fprintf(fp, "  \"results\": [\n");
+
+	int status = 0;
+	BenchWorld source, output;
+	std::string sourceKey;
+
+	for (size_t i = 0; i < cases.size(); i++) {
+		const BenchCase& c = cases[i];
+		std::vector<double> samples[BENCH_PHASE_COUNT];
+
+		if (c.sweep == "sort") {
+			PF_Err err = RunSortCase(c, repeat, samples);
+			if (err) {
+				fprintf(stderr, "reptall-bench: sort case %d/%s failed with error %d\n",
+						(int)c.copies, c.mode.c_str(), (int)err);
+				status = 1;
+				break;
+			}
+			WriteSortCaseJSON(fp, c, samples, i == 0);
+			fflush(fp);
+			if (outputPath) {
+				fprintf(stderr, "%d/%d sort/%d/%s: %.3f ms\n", (int)(i + 1), (int)cases.size(),
+						(int)c.copies, c.mode.c_str(), Median(samples[BENCH_PHASE_SORT]));
+			}
+			continue;
+		}
+
+		// Sources are shared by consecutive cases of the same size and depth
+		std::string key = c.sizeName + "/" + std::to_string(c.depth) + "/" + std::to_string(c.downsample);
+		if (key != sourceKey) {
+			MakeSource(c.BufferWidth(), c.BufferHeight(), c.depth, &source);
+			output.Allocate(c.BufferWidth(), c.BufferHeight(), c.depth);
+			sourceKey = key;
+		}
+
+		PF_Err err = RunCase(c, source, &output, repeat, samples);
+		if (err) {
+			fprintf(stderr, "reptall-bench: case %d/%s/%d/%s failed with error %d\n",
+					(int)c.depth, c.sizeName.c_str(), (int)c.copies, c.mode.c_str(), (int)err);
+			status = 1;
+			break;
+		}
+
+		WriteCaseJSON(fp, c, samples, i == 0);
+		fflush(fp);
+
+		if (outputPath) {
+			fprintf(stderr, "%d/%d %d/%s/%d/%s: %.2f ms\n", (int)(i + 1), (int)cases.size(),
+					(int)c.depth, c.sizeName.c_str(), (int)c.copies, c.mode.c_str(),
+					Median(samples[BENCH_PHASE_TOTAL]));
+		}
+	}
+
+	fprintf(fp, "\n  ]\n}\n");
+	if (outputPath) {
+		fclose(fp);
+	}
+
+	return status;
+}
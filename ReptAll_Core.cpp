@@ -0,0 +1,2753 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Core.cpp
+
+	Render phases 2-4, free of host calls: transforms, depth order, render
+	bounds and the compositing of copies into an output buffer. The effect
+	(ReptAll.cpp) and the standalone renderer both drive these.
+*/
+
+#include "ReptAll_Core.h"
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include "ReptAll_Instances.h"
+#include "ReptAll_Sampling.h"
+#include "ReptAll_Source.h"
+
+#ifdef _MSC_VER
+// Suppress C4984: 'if constexpr' is a C++17 language extension
+#pragma warning(disable : 4984)
+// Suppress C4244: conversion from PF_FpLong (double) to PF_FpShort (float)
+// This is safe for floating-point color channel assignments
+#pragma warning(disable : 4244)
+#elif defined(__clang__)
+// Suppress Clang warnings (used by Mac/Linux builds)
+#pragma clang diagnostic push
+// Suppress -Wc++17-extensions: 'if constexpr' is a C++17 language extension
+#pragma clang diagnostic ignored "-Wc++17-extensions"
+// Suppress -Wfloat-conversion: conversion from double to float in color assignments
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+// Suppress -Wunused-variable: template parameters may not be used in all instantiations
+#pragma clang diagnostic ignored "-Wunused-variable"
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Inverse of the copy scale used to re-center sampling, clamped to a sane range
+static PF_FpLong
+ComputeSafeInvScale(PF_FpLong scale)
+{
+	PF_FpLong safeScale = scale;
+	if (!std::isfinite(safeScale) || safeScale < 0.001) safeScale = 0.001;
+	if (safeScale > 1000.0) safeScale = 1000.0;
+
+	PF_FpLong invScale = 100.0 / safeScale;
+	if (!std::isfinite(invScale) || invScale < 0.001) invScale = 0.001;
+	if (invScale > 1000.0) invScale = 1000.0;
+
+	return invScale;
+}
+
+// Complete layer -> source mapping of one copy as a single 2D homography:
+//   (X, Y, W) = (m[0] * x + m[1] * y + m[2],
+//                m[3] * x + m[4] * y + m[5],
+//                m[6] * x + m[7] * y + m[8])
+//   srcX = X / W, srcY = Y / W, valid where W > 0
+// Folds the inverse 3D rotation, the scale, the translation, the camera
+// projection and the re-centering into one matrix. Copies facing the view
+// head-on keep row 3 = (0, 0, 1) and render through the affine path.
+struct CopyHomography {
+	PF_FpLong m[9];
+
+	PF_Boolean IsAffine() const {
+		return m[6] == 0.0 && m[7] == 0.0 && m[8] == 1.0;
+	}
+};
+
+// Expands copy i's packed center-relative homography into the layer space
+// of geometry: about geometry.center, at its downsample factors
+static void
+ExpandCopyHomography(
+	const CopyInstanceBuffer&	instances,
+	A_long						i,
+	const RenderGeometry&		geometry,
+	CopyHomography				*homography)
+{
+	const float *h = instances.homography + 9 * i;
+	const PF_FpLong d[3] = {geometry.downsample[0], geometry.downsample[1], 1.0};
+	const PF_FpLong centerX = geometry.center[0];
+	const PF_FpLong centerY = geometry.center[1];
+	PF_FpLong *m = homography->m;
+
+	// T(c) * D * H * D^-1 * T(-c): H maps full-resolution offsets, D scales
+	// them to downsampled buffer pixels
+	for (int r = 0; r < 3; r++) {
+		const PF_FpLong h0 = h[3 * r + 0] * d[r] / d[0];
+		const PF_FpLong h1 = h[3 * r + 1] * d[r] / d[1];
+		const PF_FpLong h2 = h[3 * r + 2] * d[r];
+		m[3 * r + 0] = h0;
+		m[3 * r + 1] = h1;
+		m[3 * r + 2] = h2 - h0 * centerX - h1 * centerY;
+	}
+	for (int c = 0; c < 3; c++) {
+		m[c] += centerX * m[6 + c];
+		m[3 + c] += centerY * m[6 + c];
+	}
+}
+
+// Inverse of a 3x3 matrix; false if it is singular
+static PF_Boolean
+InvertMatrix3(
+	const PF_FpLong	m[9],
+	PF_FpLong		inv[9])
+{
+	PF_FpLong adj[9];
+	adj[0] = m[4] * m[8] - m[5] * m[7];
+	adj[1] = m[2] * m[7] - m[1] * m[8];
+	adj[2] = m[1] * m[5] - m[2] * m[4];
+	adj[3] = m[5] * m[6] - m[3] * m[8];
+	adj[4] = m[0] * m[8] - m[2] * m[6];
+	adj[5] = m[2] * m[3] - m[0] * m[5];
+	adj[6] = m[3] * m[7] - m[4] * m[6];
+	adj[7] = m[1] * m[6] - m[0] * m[7];
+	adj[8] = m[0] * m[4] - m[1] * m[3];
+
+	PF_FpLong det = m[0] * adj[0] + m[1] * adj[3] + m[2] * adj[6];
+	if (!std::isfinite(det) || det == 0.0) {
+		return FALSE;
+	}
+
+	for (int i = 0; i < 9; i++) {
+		inv[i] = adj[i] / det;
+	}
+	return TRUE;
+}
+
+// Integer rect enclosing the four mapped corners of [x0,x1] x [y0,y1],
+// grown by margin pixels on each side.
+// W is linear, so the rect maps to a bounded quad only when W > 0 at every
+// corner. If no corner has W > 0 the result is empty; a rect straddling
+// W = 0 reaches the horizon and gets an unbounded (clamped) result.
+static void
+MapRectBounds(
+	const PF_FpLong	m[9],
+	PF_FpLong		x0,
+	PF_FpLong		y0,
+	PF_FpLong		x1,
+	PF_FpLong		y1,
+	A_long			margin,
+	PF_LRect		*bounds)
+{
+	const PF_FpLong xs[4] = {x0, x1, x0, x1};
+	const PF_FpLong ys[4] = {y0, y0, y1, y1};
+	PF_FpLong minX = DBL_MAX, minY = DBL_MAX, maxX = -DBL_MAX, maxY = -DBL_MAX;
+	int inFront = 0;
+
+	for (int i = 0; i < 4; i++) {
+		PF_FpLong mx = m[0] * xs[i] + m[1] * ys[i] + m[2];
+		PF_FpLong my = m[3] * xs[i] + m[4] * ys[i] + m[5];
+		PF_FpLong mw = m[6] * xs[i] + m[7] * ys[i] + m[8];
+		if (mw > 0.0) {
+			inFront++;
+			mx /= mw;
+			my /= mw;
+		}
+		minX = MIN(minX, mx);
+		minY = MIN(minY, my);
+		maxX = MAX(maxX, mx);
+		maxY = MAX(maxY, my);
+	}
+
+	if (inFront == 0) {
+		bounds->left = bounds->top = bounds->right = bounds->bottom = 0;
+		return;
+	}
+
+	// Keep the rect representable before converting back to integers
+	const PF_FpLong limit = 1.0e7;
+	if (inFront < 4 || !std::isfinite(minX) || !std::isfinite(minY) || !std::isfinite(maxX) || !std::isfinite(maxY)) {
+		minX = minY = -limit;
+		maxX = maxY = limit;
+	}
+	minX = MIN(MAX(minX, -limit), limit);
+	minY = MIN(MAX(minY, -limit), limit);
+	maxX = MIN(MAX(maxX, -limit), limit);
+	maxY = MIN(MAX(maxY, -limit), limit);
+
+	bounds->left   = (A_long)floor(minX) - margin;
+	bounds->top    = (A_long)floor(minY) - margin;
+	bounds->right  = (A_long)ceil(maxX) + 1 + margin;
+	bounds->bottom = (A_long)ceil(maxY) + 1 + margin;
+}
+
+// Source area a copy can draw from: bilinear sample positions in
+// [left, right) x [top, bottom). The sampleable area of a padded w x h
+// source is [-1, w) x [-1, h); samples whose taps all miss the alpha bounds
+// are transparent, so it shrinks to the bounds grown by one pixel up and
+// left.
+struct SourceSampleArea {
+	PF_FpLong	left;
+	PF_FpLong	top;
+	PF_FpLong	right;
+	PF_FpLong	bottom;
+
+	PF_Boolean IsEmpty() const {
+		return !(left < right && top < bottom);
+	}
+};
+
+static SourceSampleArea
+GetSourceSampleArea(
+	A_long			srcWidth,
+	A_long			srcHeight,
+	const PF_LRect	*alphaBounds)
+{
+	SourceSampleArea area = {-1.0, -1.0, (PF_FpLong)srcWidth, (PF_FpLong)srcHeight};
+
+	if (alphaBounds) {
+		area.left = MAX(area.left, alphaBounds->left - 1.0);
+		area.top = MAX(area.top, alphaBounds->top - 1.0);
+		area.right = MIN(area.right, (PF_FpLong)alphaBounds->right);
+		area.bottom = MIN(area.bottom, (PF_FpLong)alphaBounds->bottom);
+	}
+	return area;
+}
+
+// Layer-space bounding box of everything one copy can draw: the forward
+// projection of its source sample area.
+// Empty when the copy lies entirely behind the camera.
+static void
+ComputeCopyLayerBounds(
+	const CopyHomography&	homography,
+	const SourceSampleArea&	area,
+	PF_LRect				*bounds)
+{
+	// Forward (source -> layer) mapping is the inverse of the copy homography;
+	// being the exact inverse, its W is positive in front of the camera
+	PF_FpLong fwd[9];
+
+	if (area.IsEmpty() || !InvertMatrix3(homography.m, fwd)) {
+		bounds->left = bounds->top = bounds->right = bounds->bottom = 0;
+		return;
+	}
+
+	MapRectBounds(fwd, area.left, area.top, area.right, area.bottom, 1, bounds);
+}
+
+// Shift a layer-space copy homography so it maps output-buffer pixels
+// straight to source-buffer pixels for the given RenderGeometry.
+static void
+OffsetCopyHomography(
+	const RenderGeometry&	geometry,
+	CopyHomography			*homography)
+{
+	PF_FpLong *m = homography->m;
+	PF_FpLong dx = (PF_FpLong)geometry.dst_origin[0];
+	PF_FpLong dy = (PF_FpLong)geometry.dst_origin[1];
+
+	// H' = T(-src_origin) * H * T(dst_origin)
+	m[2] += m[0] * dx + m[1] * dy;
+	m[5] += m[3] * dx + m[4] * dy;
+	m[8] += m[6] * dx + m[7] * dy;
+	for (int c = 0; c < 3; c++) {
+		m[c] -= geometry.src_origin[0] * m[6 + c];
+		m[3 + c] -= geometry.src_origin[1] * m[6 + c];
+	}
+}
+
+// Narrow [*xBegin, *xEnd) to the pixels whose sample coordinate u = a * x + c
+// satisfies 0 <= u < limit (one source axis of the bilinear bounds test).
+// One pixel of slack is kept on each side; the sampler's own test stays exact.
+static void
+ClipSpanAxis(
+	PF_FpLong	a,
+	PF_FpLong	c,
+	PF_FpLong	limit,
+	A_long		*xBegin,
+	A_long		*xEnd)
+{
+	if (a == 0.0) {
+		if (c < 0.0 || c >= limit) {
+			*xEnd = *xBegin;
+		}
+		return;
+	}
+
+	PF_FpLong x0 = (0.0 - c) / a;
+	PF_FpLong x1 = (limit - c) / a;
+	if (x0 > x1) {
+		std::swap(x0, x1);
+	}
+
+	PF_FpLong lo = floor(x0) - 1.0;
+	PF_FpLong hi = ceil(x1) + 2.0;
+
+	if (lo > (PF_FpLong)*xBegin) {
+		*xBegin = (lo >= (PF_FpLong)*xEnd) ? *xEnd : (A_long)lo;
+	}
+	if (hi < (PF_FpLong)*xEnd) {
+		*xEnd = (hi <= (PF_FpLong)*xBegin) ? *xBegin : (A_long)hi;
+	}
+}
+
+// Narrow [*xBegin, *xEnd) to the pixels where a * x + c >= 0, with one pixel
+// of slack on each side. Along a scanline X, Y and W of a homography are all
+// linear in x, so W > 0 and 0 <= X / W < limit become three such half-lines.
+static void
+ClipSpanHalfLine(
+	PF_FpLong	a,
+	PF_FpLong	c,
+	A_long		*xBegin,
+	A_long		*xEnd)
+{
+	if (a == 0.0) {
+		if (c < 0.0) {
+			*xEnd = *xBegin;
+		}
+		return;
+	}
+
+	PF_FpLong root = -c / a;
+	if (!std::isfinite(root)) {
+		return;
+	}
+
+	if (a > 0.0) {
+		PF_FpLong lo = floor(root) - 1.0;
+		if (lo > (PF_FpLong)*xBegin) {
+			*xBegin = (lo >= (PF_FpLong)*xEnd) ? *xEnd : (A_long)lo;
+		}
+	} else {
+		PF_FpLong hi = ceil(root) + 2.0;
+		if (hi < (PF_FpLong)*xEnd) {
+			*xEnd = (hi <= (PF_FpLong)*xBegin) ? *xBegin : (A_long)hi;
+		}
+	}
+}
+
+// Scanline span of one copy: the output pixels of row y (buffer space) that
+// sample inside its source sample area.
+static void
+ComputeCopySpan(
+	const CopyHomography&	homography,
+	A_long					y,
+	const SourceSampleArea&	area,
+	A_long					*xBegin,
+	A_long					*xEnd)
+{
+	const PF_FpLong *m = homography.m;
+
+	if (homography.IsAffine()) {
+		ClipSpanAxis(m[0], m[1] * y + m[2] - area.left, area.right - area.left, xBegin, xEnd);
+		ClipSpanAxis(m[3], m[4] * y + m[5] - area.top, area.bottom - area.top, xBegin, xEnd);
+		return;
+	}
+
+	const PF_FpLong rowX = m[1] * y + m[2];
+	const PF_FpLong rowY = m[4] * y + m[5];
+	const PF_FpLong rowW = m[7] * y + m[8];
+
+	ClipSpanHalfLine(m[6], rowW, xBegin, xEnd);
+	ClipSpanHalfLine(m[0] - area.left * m[6], rowX - area.left * rowW, xBegin, xEnd);
+	ClipSpanHalfLine(area.right * m[6] - m[0], area.right * rowW - rowX, xBegin, xEnd);
+	ClipSpanHalfLine(m[3] - area.top * m[6], rowY - area.top * rowW, xBegin, xEnd);
+	ClipSpanHalfLine(area.bottom * m[6] - m[3], area.bottom * rowW - rowY, xBegin, xEnd);
+}
+
+// Exact round(x * a / 255) for x, a in [0, 255]
+static inline A_u_long
+MulDiv255(
+	A_u_long x,
+	A_u_long a)
+{
+	A_u_long t = x * a + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+// Exact round(x * a / 32768) for x, a in [0, 32768]
+static inline A_u_long
+MulDiv32768(
+	A_u_long x,
+	A_u_long a)
+{
+	return (x * a + 16384) >> 15;
+}
+
+template<int MaxChannelInt>
+static inline A_u_long
+MulDivMaxChan(
+	A_u_long x,
+	A_u_long a)
+{
+	if constexpr (MaxChannelInt == PF_MAX_CHAN16) {
+		return MulDiv32768(x, a);
+	} else {
+		return MulDiv255(x, a);
+	}
+}
+
+// Opacity (0-100) as a fixed-point factor in [0, MaxChannelInt]
+template<int MaxChannelInt>
+static inline A_u_long
+OpacityToFixed(PF_FpLong opacity)
+{
+	return (A_u_long)(opacity * MaxChannelInt / 100.0 + 0.5);
+}
+
+// Alpha-over compositing of count samples for 8/16-bit (premultiplied alpha)
+// dst = src * op + dst * (1 - srcAlpha * op) in integer fixed point, with
+// op the copy opacity from OpacityToFixed. Every product is rounded
+// exactly, and the loop has no branches so it auto-vectorizes: a
+// transparent sample leaves dst as is and an opaque one replaces it.
+template<typename PixelType, int MaxChannelInt>
+static void
+CompositeSpanPremultInt(
+	PixelType		*dst,
+	const PixelType	*src,
+	A_long			count,
+	A_u_long		op)
+{
+	typedef decltype(dst->alpha) ChannelType;
+	const A_u_long maxChan = MaxChannelInt;
+
+	for (A_long i = 0; i < count; i++) {
+		A_u_long sa = MulDivMaxChan<MaxChannelInt>(src[i].alpha, op);
+		A_u_long sr = MulDivMaxChan<MaxChannelInt>(src[i].red, op);
+		A_u_long sg = MulDivMaxChan<MaxChannelInt>(src[i].green, op);
+		A_u_long sb = MulDivMaxChan<MaxChannelInt>(src[i].blue, op);
+		A_u_long inv = maxChan - std::min(sa, maxChan);
+
+		dst[i].alpha = (ChannelType)std::min(sa + MulDivMaxChan<MaxChannelInt>(dst[i].alpha, inv), maxChan);
+		dst[i].red   = (ChannelType)std::min(sr + MulDivMaxChan<MaxChannelInt>(dst[i].red, inv), maxChan);
+		dst[i].green = (ChannelType)std::min(sg + MulDivMaxChan<MaxChannelInt>(dst[i].green, inv), maxChan);
+		dst[i].blue  = (ChannelType)std::min(sb + MulDivMaxChan<MaxChannelInt>(dst[i].blue, inv), maxChan);
+	}
+}
+
+// Alpha-over compositing for 32-bit Float (premultiplied alpha)
+static void
+CompositePremultFloat(
+	PF_PixelFloat *dstP,
+	const PF_PixelFloat *srcP)
+{
+	if (srcP->alpha <= 0.0) return;
+	if (srcP->alpha >= 1.0) {
+		*dstP = *srcP;
+		return;
+	}
+
+	// Alpha-over: dst = src + dst * (1 - srcAlpha)
+	PF_FpLong srcA = srcP->alpha;
+	// Clamp srcA to prevent negative values
+	if (srcA < 0.0) srcA = 0.0;
+	if (srcA > 1.0) srcA = 1.0;
+	PF_FpLong oneMinusSrcA = 1.0 - srcA;
+
+	// Validate finite values
+	if (!std::isfinite(oneMinusSrcA)) oneMinusSrcA = 0.0;
+
+	dstP->alpha = srcP->alpha + dstP->alpha * oneMinusSrcA;
+	dstP->red   = srcP->red + dstP->red * oneMinusSrcA;
+	dstP->green = srcP->green + dstP->green * oneMinusSrcA;
+	dstP->blue  = srcP->blue + dstP->blue * oneMinusSrcA;
+
+	// Clamp to prevent negative values
+	if (dstP->alpha < 0.0) dstP->alpha = 0.0;
+	if (dstP->red < 0.0) dstP->red = 0.0;
+	if (dstP->green < 0.0) dstP->green = 0.0;
+	if (dstP->blue < 0.0) dstP->blue = 0.0;
+}
+
+// Float alpha at which a pixel counts as fully covered in front-to-back
+// compositing. Bilinear weights do not always sum to exactly 1 in single
+// precision, so opaque copies can land an ulp short of 1.0; coverage left
+// below this threshold is dropped.
+#define FLOAT_SATURATED_ALPHA	(1.0f - 1.0f / 65536.0f)
+
+// True if no copy behind this pixel can show through it any more
+template<typename PixelType, int MaxChannelInt>
+static inline PF_Boolean
+IsPixelSaturated(const PixelType& p)
+{
+	if constexpr (MaxChannelInt == 1) {
+		return p.alpha >= FLOAT_SATURATED_ALPHA;
+	} else {
+		return p.alpha >= MaxChannelInt;
+	}
+}
+
+// "Under" compositing of count samples for 8/16-bit (premultiplied alpha)
+// dst = dst + src * op * (1 - dstAlpha), used when copies are drawn front
+// to back. Opacity and remaining coverage are folded into one per-pixel
+// factor. Returns the number of pixels that became saturated.
+template<typename PixelType, int MaxChannelInt>
+static A_long
+CompositeSpanUnderInt(
+	PixelType		*dst,
+	const PixelType	*src,
+	A_long			count,
+	A_u_long		op)
+{
+	typedef decltype(dst->alpha) ChannelType;
+	const A_u_long maxChan = MaxChannelInt;
+	A_long saturated = 0;
+
+	for (A_long i = 0; i < count; i++) {
+		A_u_long da = dst[i].alpha;
+		A_u_long f = MulDivMaxChan<MaxChannelInt>(op, maxChan - std::min(da, maxChan));
+		A_u_long a = std::min(da + MulDivMaxChan<MaxChannelInt>(src[i].alpha, f), maxChan);
+
+		dst[i].alpha = (ChannelType)a;
+		dst[i].red   = (ChannelType)std::min(dst[i].red + MulDivMaxChan<MaxChannelInt>(src[i].red, f), maxChan);
+		dst[i].green = (ChannelType)std::min(dst[i].green + MulDivMaxChan<MaxChannelInt>(src[i].green, f), maxChan);
+		dst[i].blue  = (ChannelType)std::min(dst[i].blue + MulDivMaxChan<MaxChannelInt>(src[i].blue, f), maxChan);
+
+		saturated += (da < maxChan && a == maxChan) ? 1 : 0;
+	}
+
+	return saturated;
+}
+
+// "Under" compositing of count samples for 32-bit Float (premultiplied alpha)
+// Returns the number of pixels that became saturated.
+static A_long
+CompositeSpanUnderFloat(
+	PF_PixelFloat		*dst,
+	const PF_PixelFloat	*src,
+	A_long				count,
+	PF_FpShort			op)
+{
+	A_long saturated = 0;
+
+	for (A_long i = 0; i < count; i++) {
+		if (src[i].alpha <= 0.0f) {
+			continue;
+		}
+
+		PF_FpShort da = dst[i].alpha;
+		PF_FpShort f = op * (1.0f - std::min(std::max(da, 0.0f), 1.0f));
+
+		dst[i].alpha = da + src[i].alpha * f;
+		dst[i].red   = dst[i].red + src[i].red * f;
+		dst[i].green = dst[i].green + src[i].green * f;
+		dst[i].blue  = dst[i].blue + src[i].blue * f;
+
+		saturated += (da < FLOAT_SATURATED_ALPHA && dst[i].alpha >= FLOAT_SATURATED_ALPHA) ? 1 : 0;
+	}
+
+	return saturated;
+}
+
+// Pixels one worker has run through the sampling kernels
+struct RenderPixelCounts {
+	A_u_longlong	sampled;
+	A_u_longlong	composited;     // sampled inside the copy's source
+
+	RenderPixelCounts() : sampled(0), composited(0) {}
+};
+
+// Resolve output pixels [x0, x0 + count) of row y into tap offsets and
+// fractions of a copy's source level.
+// Homogeneous sample positions are linear in x, so they are stepped
+// incrementally (DDA) by (m[0], m[3], m[6]) per pixel from the start of the
+// batch. Positions and bounds tests stay in double precision; the batch is
+// then sampled by the dispatched single-precision kernel. Against the
+// previous double-precision sampler this is at most one code value of
+// rounding difference in 8/16 bpc and below 1e-6 in 32 bpc.
+// srcP is a padded pyramid level: positions in [-1, w) x [-1, h) sample
+// it directly, and every other lane reads its all-zero quad, so the
+// kernels treat all lanes alike.
+// FrontToBack lanes whose pixel is already saturated read the zero quad.
+// Nearest (draft quality) resolves the texel each position rounds to;
+// positions that round outside the source are transparent.
+// Returns the number of lanes inside the source.
+template<typename PixelType, int MaxChannelInt, bool FrontToBack, bool Nearest>
+static inline A_long
+ResolveSampleBatchTmpl(
+	const PF_EffectWorld	*srcP,
+	const PixelType			*dstRow,
+	A_long					x0,
+	A_long					count,
+	const CopyHomography&	homography,
+	A_long					y,
+	SampleBatch				*batch)
+{
+	const PF_FpLong *m = homography.m;
+	const PF_FpLong du = m[0];
+	const PF_FpLong dv = m[3];
+	const PF_FpLong dw = m[6];
+	const bool projective = !homography.IsAffine();
+
+	const A_long rowbytes = srcP->rowbytes;
+	const PF_FpLong maxX = srcP->width;
+	const PF_FpLong maxY = srcP->height;
+	const std::ptrdiff_t nullOffset = GetSourceNullQuadOffset(*srcP, (A_long)sizeof(PixelType));
+	A_long inside = 0;
+
+	// X, Y and W step linearly along the row; perspective copies pay one
+	// divide per pixel to get the perspective-correct position
+	PF_FpLong srcX = du * x0 + (m[1] * y + m[2]);
+	PF_FpLong srcY = dv * x0 + (m[4] * y + m[5]);
+	PF_FpLong srcW = dw * x0 + (m[7] * y + m[8]);
+	for (A_long i = 0; i < count; i++) {
+		PF_Boolean covered = FALSE;
+		if constexpr (FrontToBack) {
+			covered = IsPixelSaturated<PixelType, MaxChannelInt>(dstRow[x0 + i]);
+		}
+
+		PF_FpLong sampleX = srcX;
+		PF_FpLong sampleY = srcY;
+		if (projective) {
+			if (srcW > 0.0) {
+				PF_FpLong invW = 1.0 / srcW;
+				sampleX *= invW;
+				sampleY *= invW;
+			} else {
+				// Behind the camera
+				covered = TRUE;
+			}
+		}
+
+		if constexpr (Nearest) {
+			if (covered || !(sampleX >= -0.5 && sampleY >= -0.5 && sampleX < maxX - 0.5 && sampleY < maxY - 0.5)) {
+				batch->offset[i] = nullOffset;
+			} else {
+				A_long ix = (A_long)(sampleX + 0.5);
+				A_long iy = (A_long)(sampleY + 0.5);
+				batch->offset[i] = (std::ptrdiff_t)iy * rowbytes + (std::ptrdiff_t)ix * (std::ptrdiff_t)sizeof(PixelType);
+				inside++;
+			}
+		} else if (covered || !(sampleX >= -1.0 && sampleY >= -1.0 && sampleX < maxX && sampleY < maxY)) {
+			batch->offset[i] = nullOffset;
+			batch->fx[i] = 0.0f;
+			batch->fy[i] = 0.0f;
+		} else {
+			// Shifted by one so truncation floors the apron column/row
+			A_long ix = (A_long)(sampleX + 1.0) - 1;
+			A_long iy = (A_long)(sampleY + 1.0) - 1;
+			batch->offset[i] = (std::ptrdiff_t)iy * rowbytes + (std::ptrdiff_t)ix * (std::ptrdiff_t)sizeof(PixelType);
+			batch->fx[i] = (float)(sampleX - ix);
+			batch->fy[i] = (float)(sampleY - iy);
+			inside++;
+		}
+		srcX += du;
+		srcY += dv;
+		srcW += dw;
+	}
+
+	return inside;
+}
+
+// Sample a resolved batch: bilinear through the kernel, or for Nearest a
+// direct read (every offset is the top-left tap of a quad, i.e. a texel)
+template<typename PixelType, bool Nearest>
+static inline void
+SampleResolvedBatchTmpl(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	void				(*sampleBatch)(const char*, A_long, const SampleBatch*, A_long, PixelType*),
+	PixelType			*samples)
+{
+	if constexpr (Nearest) {
+		for (A_long i = 0; i < count; i++) {
+			samples[i] = *(const PixelType*)(srcData + batch->offset[i]);
+		}
+	} else {
+		sampleBatch(srcData, rowbytes, batch, count, samples);
+	}
+}
+
+// Composite count samples of a copy at opacity (0-100) into dst
+// FrontToBack selects the "under" operator and returns the number of
+// pixels it saturated (0 otherwise). samples may be modified.
+template<typename PixelType, int MaxChannelInt, bool FrontToBack>
+static inline A_long
+CompositeSamplesTmpl(
+	PixelType		*dst,
+	PixelType		*samples,
+	A_long			count,
+	PF_FpLong		opacity,
+	A_u_long		opFixed)
+{
+	if constexpr (FrontToBack) {
+		if constexpr (MaxChannelInt == 1) {
+			return CompositeSpanUnderFloat(dst, samples, count, (PF_FpShort)(opacity / 100.0));
+		} else {
+			return CompositeSpanUnderInt<PixelType, MaxChannelInt>(dst, samples, count, opFixed);
+		}
+	} else if constexpr (MaxChannelInt == 1) {
+		for (A_long i = 0; i < count; i++) {
+			PixelType& srcPix = samples[i];
+			if (srcPix.alpha > 0.0) {
+				// Premultiplied: opacity scales color and alpha alike
+				if (opacity < 100.0) {
+					PF_FpLong op = opacity / 100.0;
+					srcPix.alpha *= op;
+					srcPix.red *= op;
+					srcPix.green *= op;
+					srcPix.blue *= op;
+				}
+				CompositePremultFloat(&dst[i], &srcPix);
+			}
+		}
+	} else {
+		CompositeSpanPremultInt<PixelType, MaxChannelInt>(dst, samples, count, opFixed);
+	}
+	return 0;
+}
+
+// Composite count texels read straight from a source row; only the float
+// "over" operator modifies its samples, so it alone goes through scratch
+template<typename PixelType, int MaxChannelInt, bool FrontToBack>
+static inline A_long
+CompositeTexelsTmpl(
+	PixelType		*dst,
+	const PixelType	*texels,
+	A_long			count,
+	PF_FpLong		opacity,
+	A_u_long		opFixed,
+	PixelType		*scratch)
+{
+	if constexpr (MaxChannelInt == 1 && !FrontToBack) {
+		std::copy(texels, texels + count, scratch);
+		return CompositeSamplesTmpl<PixelType, MaxChannelInt, FrontToBack>(dst, scratch, count, opacity, opFixed);
+	} else {
+		return CompositeSamplesTmpl<PixelType, MaxChannelInt, FrontToBack>(dst, const_cast<PixelType*>(texels), count, opacity, opFixed);
+	}
+}
+
+// Trim pixels that are already saturated from both ends of [*xBegin, *xEnd)
+template<typename PixelType, int MaxChannelInt>
+static inline void
+TrimSaturatedSpan(
+	const PixelType	*dstRow,
+	A_long			*xBegin,
+	A_long			*xEnd)
+{
+	while (*xBegin < *xEnd && IsPixelSaturated<PixelType, MaxChannelInt>(dstRow[*xBegin])) {
+		(*xBegin)++;
+	}
+	while (*xEnd > *xBegin && IsPixelSaturated<PixelType, MaxChannelInt>(dstRow[*xEnd - 1])) {
+		(*xEnd)--;
+	}
+}
+
+// Render one scanline span [xBegin, xEnd) of a copy into dstRow, one
+// SAMPLE_BATCH_MAX pixel batch at a time (see ResolveSampleBatchTmpl).
+// FrontToBack selects the "under" operator: pixels that are already
+// saturated are trimmed from the span ends or left unsampled, and the
+// return value is the number of pixels this copy saturated (0 otherwise).
+// counts gets the pixels sampled and those inside the source.
+template<typename PixelType, int MaxChannelInt, bool FrontToBack, bool Nearest>
+static A_long
+RenderSpanTmpl(
+	PF_EffectWorld		*srcP,
+	PixelType			*dstRow,
+	A_long				xBegin,
+	A_long				xEnd,
+	const CopyHomography&	homography,
+	A_long				y,
+	PF_FpLong			opacity,
+	void				(*sampleBatch)(const char*, A_long, const SampleBatch*, A_long, PixelType*),
+	RenderPixelCounts	*counts)
+{
+	const char *srcData = (const char*)srcP->data;
+	const A_long rowbytes = srcP->rowbytes;
+
+	SampleBatch batch;
+	PixelType samples[SAMPLE_BATCH_MAX];
+	const A_u_long opFixed = OpacityToFixed<MaxChannelInt>(opacity);
+	A_long saturated = 0;
+	A_long inside = 0;
+
+	if constexpr (FrontToBack) {
+		TrimSaturatedSpan<PixelType, MaxChannelInt>(dstRow, &xBegin, &xEnd);
+	}
+
+	for (A_long x0 = xBegin; x0 < xEnd; x0 += SAMPLE_BATCH_MAX) {
+		A_long count = std::min<A_long>(SAMPLE_BATCH_MAX, xEnd - x0);
+
+		inside += ResolveSampleBatchTmpl<PixelType, MaxChannelInt, FrontToBack, Nearest>(
+			srcP, dstRow, x0, count, homography, y, &batch);
+		SampleResolvedBatchTmpl<PixelType, Nearest>(srcData, rowbytes, &batch, count, sampleBatch, samples);
+		counts->sampled += count;
+
+		saturated += CompositeSamplesTmpl<PixelType, MaxChannelInt, FrontToBack>(
+			dstRow + x0, samples, count, opacity, opFixed);
+	}
+
+	counts->composited += inside;
+	return saturated;
+}
+
+// Render one scanline span of a motion-blurred copy: every pixel averages
+// the copy's samples over the shutter (samples maps, one per instant),
+// premultiplied, then composites the average once. Compositing is linear
+// in the premultiplied source, so this is the time average of the copy
+// composited over dstRow. counts gets every shutter sample as sampled and
+// every pixel inside the source at any instant once as composited.
+template<typename PixelType, int MaxChannelInt, bool FrontToBack, bool Nearest>
+static A_long
+RenderMotionSpanTmpl(
+	PF_EffectWorld			*srcP,
+	PixelType				*dstRow,
+	A_long					xBegin,
+	A_long					xEnd,
+	const CopyHomography	*homographies,
+	A_long					sampleCount,
+	A_long					y,
+	PF_FpLong				opacity,
+	void					(*sampleBatch)(const char*, A_long, const SampleBatch*, A_long, PixelType*),
+	RenderPixelCounts		*counts)
+{
+	typedef decltype(dstRow->alpha) ChannelType;
+
+	const char *srcData = (const char*)srcP->data;
+	const A_long rowbytes = srcP->rowbytes;
+	const std::ptrdiff_t nullOffset = GetSourceNullQuadOffset(*srcP, (A_long)sizeof(PixelType));
+
+	SampleBatch batch;
+	PixelType samples[SAMPLE_BATCH_MAX];
+	float sum[4][SAMPLE_BATCH_MAX];
+	bool hit[SAMPLE_BATCH_MAX];
+	const A_u_long opFixed = OpacityToFixed<MaxChannelInt>(opacity);
+	const float invCount = 1.0f / sampleCount;
+	A_long saturated = 0;
+	A_long inside = 0;
+
+	if constexpr (FrontToBack) {
+		TrimSaturatedSpan<PixelType, MaxChannelInt>(dstRow, &xBegin, &xEnd);
+	}
+
+	for (A_long x0 = xBegin; x0 < xEnd; x0 += SAMPLE_BATCH_MAX) {
+		A_long count = std::min<A_long>(SAMPLE_BATCH_MAX, xEnd - x0);
+
+		// Integer channels sum exactly in float (at most 64 * 65535)
+		for (int c = 0; c < 4; c++) {
+			std::fill(sum[c], sum[c] + count, 0.0f);
+		}
+		std::fill(hit, hit + count, false);
+
+		for (A_long k = 0; k < sampleCount; k++) {
+			ResolveSampleBatchTmpl<PixelType, MaxChannelInt, FrontToBack, Nearest>(
+				srcP, dstRow, x0, count, homographies[k], y, &batch);
+			SampleResolvedBatchTmpl<PixelType, Nearest>(srcData, rowbytes, &batch, count, sampleBatch, samples);
+
+			for (A_long i = 0; i < count; i++) {
+				hit[i] = hit[i] || batch.offset[i] != nullOffset;
+				sum[0][i] += samples[i].alpha;
+				sum[1][i] += samples[i].red;
+				sum[2][i] += samples[i].green;
+				sum[3][i] += samples[i].blue;
+			}
+		}
+		counts->sampled += (A_u_longlong)count * sampleCount;
+		inside += (A_long)std::count(hit, hit + count, true);
+
+		for (A_long i = 0; i < count; i++) {
+			if constexpr (MaxChannelInt == 1) {
+				samples[i].alpha = sum[0][i] * invCount;
+				samples[i].red   = sum[1][i] * invCount;
+				samples[i].green = sum[2][i] * invCount;
+				samples[i].blue  = sum[3][i] * invCount;
+			} else {
+				const A_u_long half = (A_u_long)sampleCount / 2;
+				samples[i].alpha = (ChannelType)(((A_u_long)sum[0][i] + half) / (A_u_long)sampleCount);
+				samples[i].red   = (ChannelType)(((A_u_long)sum[1][i] + half) / (A_u_long)sampleCount);
+				samples[i].green = (ChannelType)(((A_u_long)sum[2][i] + half) / (A_u_long)sampleCount);
+				samples[i].blue  = (ChannelType)(((A_u_long)sum[3][i] + half) / (A_u_long)sampleCount);
+			}
+		}
+
+		saturated += CompositeSamplesTmpl<PixelType, MaxChannelInt, FrontToBack>(
+			dstRow + x0, samples, count, opacity, opFixed);
+	}
+
+	counts->composited += inside;
+	return saturated;
+}
+
+// ============================================================================
+// Random effectors
+// ============================================================================
+
+// Channels an effector offsets, in the order of CopyJitter::channel
+enum {
+	JITTER_POSITION_X = 0,
+	JITTER_POSITION_Y,
+	JITTER_POSITION_Z,
+	JITTER_ROTATION_X,
+	JITTER_ROTATION_Y,
+	JITTER_ROTATION_Z,
+	JITTER_SCALE_X,
+	JITTER_SCALE_Y,
+	JITTER_OPACITY,
+	JITTER_CHANNELS
+};
+
+// Random word (block, word) of each channel. Word 3 of block 0 decides
+// whether the effector picks the copy; block 2 word 2 (scale z) is unused.
+static const int kJitterWord[JITTER_CHANNELS][2] = {
+	{0, 0}, {0, 1}, {0, 2},
+	{1, 0}, {1, 1}, {1, 2},
+	{2, 0}, {2, 1},
+	{1, 3}
+};
+#define JITTER_PICK_BLOCK	0
+#define JITTER_PICK_WORD	3
+#define JITTER_BLOCKS		3
+
+static_assert(FIELD_BATCH_MAX >= RANDOM_BATCH_MAX, "jitter batches are weighed by one field kernel call");
+
+// Summed offsets of all effectors, one value per copy and channel
+struct CopyJitter {
+	std::vector<float>	channel[JITTER_CHANNELS];
+};
+
+// Effector amounts scaled by its strength and the master strength
+// Returns FALSE when the effector cannot change any copy.
+static PF_Boolean
+GetEffectorAmounts(
+	const ReptAllState	*state,
+	A_long				e,
+	float				amount[JITTER_CHANNELS])
+{
+	const CopyEffector& effector = state->effector[e];
+	const PF_FpLong weight = state->random_strength / 100.0 * effector.strength / 100.0;
+
+	if (!effector.enabled || !std::isfinite(weight) || weight == 0.0 || !(effector.probability > 0.0)) {
+		return FALSE;
+	}
+
+	const PF_FpLong amounts[JITTER_CHANNELS] = {
+		effector.position[0], effector.position[1], effector.position[2],
+		effector.rotation[0], effector.rotation[1], effector.rotation[2],
+		effector.scale[0], effector.scale[1],
+		effector.opacity
+	};
+
+	PF_Boolean any = FALSE;
+	for (int c = 0; c < JITTER_CHANNELS; c++) {
+		amount[c] = std::isfinite(amounts[c]) ? (float)(amounts[c] * weight) : 0.0f;
+		any = any || amount[c] != 0.0f;
+	}
+	return any;
+}
+
+// Fills jitter with the summed effector offsets of copies [0, count)
+// Copies are processed RANDOM_BATCH_MAX at a time: the field kernel weighs
+// the batch from its stepped positions, then each effector draws three
+// blocks of random words per copy from the batch kernel. A copy's offsets
+// depend only on the state and its index. Leaves jitter empty when no
+// effector is active.
+static PF_Err
+ComputeCopyJitter(
+	const ReptAllState	*state,
+	A_long				count,
+	CopyJitter			*jitter)
+{
+	float amount[REPTALL_EFFECTOR_COUNT][JITTER_CHANNELS];
+	PF_Boolean active[REPTALL_EFFECTOR_COUNT];
+	PF_Boolean anyActive = FALSE;
+
+	for (A_long e = 0; e < REPTALL_EFFECTOR_COUNT; e++) {
+		active[e] = GetEffectorAmounts(state, e, amount[e]);
+		anyActive = anyActive || active[e];
+	}
+	if (!anyActive) {
+		return PF_Err_NONE;
+	}
+
+	try {
+		for (int c = 0; c < JITTER_CHANNELS; c++) {
+			jitter->channel[c].assign(count, 0.0f);
+		}
+	} catch (const std::bad_alloc&) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	const RandomBatchFunc generate = GetRandomBatchKernel();
+	const FieldBatchFunc evaluateFields = GetFieldBatchKernel();
+	const RandomDistribution distribution =
+		(state->random_distribution == RANDOM_DISTRIBUTION_UNIFORM) ? RANDOM_DISTRIBUTION_UNIFORM
+																	: RANDOM_DISTRIBUTION_CENTERED;
+
+	FieldProgram fields;
+	PrepareFieldProgram(state->spatial_field, state->index_field, state->field_combine, count, &fields);
+
+	// Grid position of the batch's first copy, advanced as in phase 2
+	A_long grid[3] = {0, 0, 0};
+
+	A_u_long words[JITTER_BLOCKS][RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX];
+	float position[3][RANDOM_BATCH_MAX];
+	float weight[RANDOM_BATCH_MAX];
+	float picked[RANDOM_BATCH_MAX];
+
+	for (A_long first = 0; first < count; first += RANDOM_BATCH_MAX) {
+		const A_long n = MIN(RANDOM_BATCH_MAX, count - first);
+
+		if (fields.active) {
+			for (A_long i = 0; i < n; i++) {
+				for (int a = 0; a < 3; a++) {
+					position[a][i] = (float)(state->position[a] + state->step_position[a] * grid[a]);
+				}
+				if (++grid[0] == state->copies[0]) {
+					grid[0] = 0;
+					if (++grid[1] == state->copies[1]) {
+						grid[1] = 0;
+						grid[2]++;
+					}
+				}
+			}
+			evaluateFields(fields, position[0], position[1], position[2], first, n, weight);
+		} else {
+			for (A_long i = 0; i < n; i++) {
+				weight[i] = 1.0f;
+			}
+		}
+
+		for (A_long e = 0; e < REPTALL_EFFECTOR_COUNT; e++) {
+			if (!active[e]) {
+				continue;
+			}
+
+			const CopyEffector& effector = state->effector[e];
+			const float probability = (float)(effector.probability / 100.0);
+			const RandomKey key = {(A_u_long)state->random_seed + (A_u_long)effector.seed_offset, (A_u_long)e};
+
+			PF_Boolean blockUsed[JITTER_BLOCKS] = {FALSE, FALSE, FALSE};
+			blockUsed[JITTER_PICK_BLOCK] = TRUE;
+			for (int c = 0; c < JITTER_CHANNELS; c++) {
+				blockUsed[kJitterWord[c][0]] |= (amount[e][c] != 0.0f);
+			}
+			for (int b = 0; b < JITTER_BLOCKS; b++) {
+				if (blockUsed[b]) {
+					generate(key, (A_u_long)first, n, (A_u_long)b, words[b]);
+				}
+			}
+
+			const A_u_long *pick = words[JITTER_PICK_BLOCK][JITTER_PICK_WORD];
+			for (A_long i = 0; i < n; i++) {
+				picked[i] = (RandomUnit(pick[i]) < probability) ? weight[i] : 0.0f;
+			}
+
+			for (int c = 0; c < JITTER_CHANNELS; c++) {
+				if (amount[e][c] == 0.0f) {
+					continue;
+				}
+				const A_u_long *w = words[kJitterWord[c][0]][kJitterWord[c][1]];
+				float *dst = jitter->channel[c].data() + first;
+				for (A_long i = 0; i < n; i++) {
+					dst[i] += picked[i] * amount[e][c] * RandomSigned(w[i], distribution);
+				}
+			}
+		}
+	}
+
+	return PF_Err_NONE;
+}
+
+// ============================================================================
+// PHASE 2: Compute transform for each copy (handles stepping)
+// ============================================================================
+PF_Err
+ComputeCopyTransforms(
+	const ReptAllState	*state,
+	const CopyCamera	*camera,
+	CopyInstanceBuffer	*instances)
+{
+	PF_Err err = PF_Err_NONE;
+
+	if (!state || !camera || !instances) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	// Validate maximum copy count
+	for (int i = 0; i < 3; i++) {
+		if (state->copies[i] < 1 || state->copies[i] > MAX_COPIES) {
+			return PF_Err_BAD_CALLBACK_PARAM;
+		}
+	}
+
+	// Get total number of copies with overflow check
+	A_long totalX = state->copies[0];
+	A_long totalY = state->copies[1];
+	A_long totalZ = state->copies[2];
+
+	// Check for multiplication overflow
+	if (totalX > 0 && totalY > LONG_MAX / totalX) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+	A_long totalXY = totalX * totalY;
+
+	if (totalXY > 0 && totalZ > LONG_MAX / totalXY) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	const A_long numTransforms = totalXY * totalZ;
+
+	// Additional maximum copy count validation
+	if (numTransforms > MAX_COPIES || numTransforms > instances->capacity) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+	instances->count = numTransforms;
+
+	// ===== Camera position and orientation =====
+	// World space is layer pixel space with z pointing into the screen, as
+	// if the layer were comp-sized and sat at the comp origin. The camera
+	// looks along its local +z and projects about the layer center with its
+	// zoom as focal length, so the default camera shows a copy at z = 0 1:1.
+	const PF_Boolean perspective = camera->has_camera && camera->focal_length > 0.0;
+	const PF_FpLong focal_length = camera->focal_length;
+
+	PF_FpLong camera_pos[3] = {0.0, 0.0, 0.0};   // relative to the layer center
+	PF_FpLong camera_axis[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+
+	if (perspective) {
+		const A_Matrix4& camera_matrix = camera->matrix;
+
+		camera_pos[0] = camera_matrix.mat[3][0] - camera->layer_center[0];
+		camera_pos[1] = camera_matrix.mat[3][1] - camera->layer_center[1];
+		camera_pos[2] = camera_matrix.mat[3][2];
+
+		// Rows of the layer-to-world matrix are the camera's local axes
+		for (int r = 0; r < 3; r++) {
+			PF_FpLong len = sqrt(camera_matrix.mat[r][0] * camera_matrix.mat[r][0] +
+								 camera_matrix.mat[r][1] * camera_matrix.mat[r][1] +
+								 camera_matrix.mat[r][2] * camera_matrix.mat[r][2]);
+			if (len > 0.0001) {
+				for (int c = 0; c < 3; c++) {
+					camera_axis[r][c] = camera_matrix.mat[r][c] / len;
+				}
+			}
+		}
+	}
+
+	// Scale ratio is the same for every copy
+	PF_FpLong stepScaleRatio = state->step_scale / 100.0;
+	PF_FpLong baseScale = state->scale;
+
+	// Validate inputs
+	if (!std::isfinite(stepScaleRatio) || stepScaleRatio < 0.001) stepScaleRatio = 0.001;
+	if (stepScaleRatio > 10.0) stepScaleRatio = 10.0;
+	if (!std::isfinite(baseScale) || baseScale < 0.001) baseScale = 0.001;
+	if (baseScale > 1000.0) baseScale = 1000.0;
+
+	// Random effector offsets of all copies, in one batched pass
+	CopyJitter jitter;
+	ERR(ComputeCopyJitter(state, numTransforms, &jitter));
+	if (err) {
+		return err;
+	}
+	const PF_Boolean jittered = !jitter.channel[0].empty();
+
+	// Visibility bits are OR-ed in below; arenas are reused between renders
+	for (A_long w = 0; w < (numTransforms + 31) / 32; w++) {
+		instances->visible[w] = 0;
+	}
+
+	// ===== Compute transform for each copy =====
+	// Copies are stored in grid order, which is also the initial draw order
+	for (A_long z = 0; z < state->copies[2]; z++) {
+		for (A_long y = 0; y < state->copies[1]; y++) {
+			for (A_long x = 0; x < state->copies[0]; x++) {
+				A_long copyIndex = z * state->copies[0] * state->copies[1] +
+								   y * state->copies[0] + x;
+
+				// Calculate cumulative position
+				PF_FpLong pos[3];
+				pos[0] = state->position[0] + state->step_position[0] * x;
+				pos[1] = state->position[1] + state->step_position[1] * y;
+				pos[2] = state->position[2] + state->step_position[2] * z;
+
+				// Calculate cumulative rotation
+				PF_FpLong rot[3];
+				for (int i = 0; i < 3; i++) {
+					rot[i] = (state->rotation[i] + state->step_rotation[i] * copyIndex) * M_PI / 180.0;
+				}
+
+				// Calculate cumulative scale (compound) - use exponential formula instead of O(n^2) loop
+				// scale = base_scale * (step_scale / 100.0) ^ copyIndex
+				PF_FpLong scale = baseScale;
+				if (copyIndex > 0) {
+					// Use pow for exponential calculation: base * ratio^copyIndex
+					scale = baseScale * std::pow(stepScaleRatio, copyIndex);
+
+					// Clamp result to reasonable range
+					if (!std::isfinite(scale) || scale < 0.001) scale = 0.001;
+					if (scale > 10000.0) scale = 10000.0;
+				}
+
+				// Calculate opacity (linear interpolation)
+				PF_FpLong opacity = state->opacity_start;
+				if (numTransforms > 1) {
+					opacity = state->opacity_start +
+						(state->opacity_end - state->opacity_start) * copyIndex / (numTransforms - 1);
+				}
+
+				// Effectors offset the stepped transform; scale offsets are
+				// percent of the copy's size along its own x and y
+				PF_FpLong axisScale[2] = {1.0, 1.0};
+				if (jittered) {
+					for (int i = 0; i < 3; i++) {
+						pos[i] += jitter.channel[JITTER_POSITION_X + i][copyIndex];
+						rot[i] += jitter.channel[JITTER_ROTATION_X + i][copyIndex] * M_PI / 180.0;
+					}
+					for (int i = 0; i < 2; i++) {
+						axisScale[i] = MAX(0.001, 1.0 + jitter.channel[JITTER_SCALE_X + i][copyIndex] / 100.0);
+					}
+					opacity += jitter.channel[JITTER_OPACITY][copyIndex];
+				}
+
+				// Model: R = Rz * Ry * Rx (X applied first). A source pixel
+				// at (a, b) from the center lands at o + a * u + b * v, where
+				// u, v are the scaled plane axes and o = -R * pos (positions
+				// move copies opposite to the step, as in the 2D renderer).
+				PF_FpLong cx = cos(rot[0]), sx = sin(rot[0]);
+				PF_FpLong cy = cos(rot[1]), sy = sin(rot[1]);
+				PF_FpLong cz = cos(rot[2]), sz = sin(rot[2]);
+				PF_FpLong R[3][3] = {
+					{cz * cy, cz * sy * sx - sz * cx, cz * sy * cx + sz * sx},
+					{sz * cy, sz * sy * sx + cz * cx, sz * sy * cx - cz * sx},
+					{-sy,     cy * sx,                cy * cx}
+				};
+
+				PF_FpLong planeScale = 1.0 / ComputeSafeInvScale(scale);
+				PF_FpLong u[3], v[3], o[3];
+				for (int r = 0; r < 3; r++) {
+					u[r] = planeScale * axisScale[0] * R[r][0];
+					v[r] = planeScale * axisScale[1] * R[r][1];
+					o[r] = -(R[r][0] * pos[0] + R[r][1] * pos[1] + R[r][2] * pos[2]);
+				}
+
+				// Forward map (a, b, 1) -> homogeneous layer position about
+				// the center, then its inverse for sampling
+				PF_FpLong fwd[9];
+				PF_FpLong cameraDepth = o[2];
+				if (perspective) {
+					PF_FpLong e1[3], e2[3], eo[3];
+					for (int r = 0; r < 3; r++) {
+						e1[r] = camera_axis[r][0] * u[0] + camera_axis[r][1] * u[1] + camera_axis[r][2] * u[2];
+						e2[r] = camera_axis[r][0] * v[0] + camera_axis[r][1] * v[1] + camera_axis[r][2] * v[2];
+						eo[r] = camera_axis[r][0] * (o[0] - camera_pos[0]) +
+								camera_axis[r][1] * (o[1] - camera_pos[1]) +
+								camera_axis[r][2] * (o[2] - camera_pos[2]);
+					}
+
+					fwd[0] = focal_length * e1[0];
+					fwd[1] = focal_length * e2[0];
+					fwd[2] = focal_length * eo[0];
+					fwd[3] = focal_length * e1[1];
+					fwd[4] = focal_length * e2[1];
+					fwd[5] = focal_length * eo[1];
+					fwd[6] = e1[2];
+					fwd[7] = e2[2];
+					fwd[8] = eo[2];
+					cameraDepth = eo[2];
+
+					// Copies facing the camera are affine; keep them on the fast path
+					if (eo[2] > 0.0) {
+						for (int i = 0; i < 9; i++) {
+							fwd[i] /= eo[2];
+						}
+						if (fabs(fwd[6]) < 1.0e-12 && fabs(fwd[7]) < 1.0e-12) {
+							fwd[6] = fwd[7] = 0.0;
+							fwd[8] = 1.0;
+						}
+					}
+				} else {
+					fwd[0] = u[0];
+					fwd[1] = v[0];
+					fwd[2] = o[0];
+					fwd[3] = u[1];
+					fwd[4] = v[1];
+					fwd[5] = o[1];
+					fwd[6] = 0.0;
+					fwd[7] = 0.0;
+					fwd[8] = 1.0;
+				}
+
+				PF_FpLong inv[9];
+				PF_Boolean invertible = InvertMatrix3(fwd, inv);
+				if (invertible && fwd[6] == 0.0 && fwd[7] == 0.0 && fwd[8] == 1.0) {
+					inv[6] = inv[7] = 0.0;
+					inv[8] = 1.0;
+				}
+
+				// Edge-on planes have no inverse and draw nothing
+				instances->SetVisible(copyIndex, (opacity > 0.0 && scale > 0.001 && invertible));
+
+				// Validate and clamp opacity
+				if (!std::isfinite(opacity)) opacity = 100.0;
+				if (opacity < 0.0) opacity = 0.0;
+				if (opacity > 100.0) opacity = 100.0;
+
+				// Sorted ascending: negated distance puts the farthest copy first
+				instances->position[0][copyIndex] = (float)pos[0];
+				instances->position[1][copyIndex] = (float)pos[1];
+				instances->position[2][copyIndex] = (float)pos[2];
+				instances->depth[copyIndex] = (float)-cameraDepth;
+				instances->opacity[copyIndex] = (float)opacity;
+				instances->order[copyIndex] = (A_u_long)copyIndex;
+
+				// The forward map scales areas at the center by
+				// det(fwd) / W^3, W = fwd[8] (its homogeneous weight there)
+				PF_FpLong centerArea = 0.0;
+				if (invertible && fwd[8] > 0.0) {
+					PF_FpLong det = fwd[0] * (fwd[4] * fwd[8] - fwd[5] * fwd[7]) -
+									fwd[1] * (fwd[3] * fwd[8] - fwd[5] * fwd[6]) +
+									fwd[2] * (fwd[3] * fwd[7] - fwd[4] * fwd[6]);
+					centerArea = fabs(det) / (fwd[8] * fwd[8] * fwd[8]);
+				}
+				instances->footprint[copyIndex] = std::isfinite(centerArea) ? (float)sqrt(centerArea) : 0.0f;
+
+				float *homography = instances->homography + 9 * copyIndex;
+				for (int i = 0; i < 9; i++) {
+					homography[i] = invertible ? (float)inv[i] : 0.0f;
+				}
+			}
+		}
+	}
+
+	return err;
+}
+
+// Copies at or below this count are insertion sorted instead of radix sorted
+#define DEPTH_SORT_RADIX_MIN		64
+
+// Radix digit width; three passes cover a 32-bit key
+#define DEPTH_SORT_RADIX_BITS		11
+#define DEPTH_SORT_RADIX_BUCKETS	(1 << DEPTH_SORT_RADIX_BITS)
+
+// Element moves allowed per copy when repairing a previous order before
+// falling back to the radix sort
+#define DEPTH_SORT_REPAIR_MOVES		8
+
+// 8-byte sort record: depth as an order-preserving integer, then copy index
+struct DepthSortKey {
+	A_u_long	key;
+	A_u_long	index;
+};
+
+static inline bool
+DepthKeyLess(const DepthSortKey& a, const DepthSortKey& b)
+{
+	return a.key < b.key || (a.key == b.key && a.index < b.index);
+}
+
+// Maps a float to an unsigned key with the same ordering (-0 == +0)
+static inline A_u_long
+DepthToSortKey(float depth)
+{
+	if (depth == 0.0f) {
+		depth = 0.0f;
+	}
+
+	A_u_long bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Insertion sort that gives up after maxMoves element moves
+// Returns false if it gave up; keys is then a permutation of its input.
+static bool
+InsertionSortDepthKeys(
+	DepthSortKey	*keys,
+	A_long			count,
+	A_u_longlong	maxMoves)
+{
+	A_u_longlong moves = 0;
+
+	for (A_long i = 1; i < count; i++) {
+		DepthSortKey item = keys[i];
+		A_long j = i;
+
+		while (j > 0 && DepthKeyLess(item, keys[j - 1])) {
+			keys[j] = keys[j - 1];
+			j--;
+			if (++moves > maxMoves) {
+				keys[j] = item;
+				return false;
+			}
+		}
+		keys[j] = item;
+	}
+
+	return true;
+}
+
+// Stable LSD radix sort of keys by key (three 11-bit passes)
+// Records enter in copy index order, so equal depths stay in index order.
+// Passes whose digit is the same for every key are skipped.
+static void
+RadixSortDepthKeys(
+	DepthSortKey	*keys,
+	DepthSortKey	*scratch,
+	A_long			count)
+{
+	const int passes = (32 + DEPTH_SORT_RADIX_BITS - 1) / DEPTH_SORT_RADIX_BITS;
+	const A_u_long mask = DEPTH_SORT_RADIX_BUCKETS - 1;
+
+	std::vector<A_long> histogram(passes * DEPTH_SORT_RADIX_BUCKETS, 0);
+	for (A_long i = 0; i < count; i++) {
+		A_u_long key = keys[i].key;
+		for (int p = 0; p < passes; p++) {
+			histogram[p * DEPTH_SORT_RADIX_BUCKETS + ((key >> (p * DEPTH_SORT_RADIX_BITS)) & mask)]++;
+		}
+	}
+
+	DepthSortKey *src = keys;
+	DepthSortKey *dst = scratch;
+
+	for (int p = 0; p < passes; p++) {
+		A_long *bucket = &histogram[p * DEPTH_SORT_RADIX_BUCKETS];
+		const int shift = p * DEPTH_SORT_RADIX_BITS;
+
+		if (bucket[(src[0].key >> shift) & mask] == count) {
+			continue;
+		}
+
+		// Exclusive prefix sum: bucket start offsets
+		A_long offset = 0;
+		for (A_long b = 0; b < DEPTH_SORT_RADIX_BUCKETS; b++) {
+			A_long n = bucket[b];
+			bucket[b] = offset;
+			offset += n;
+		}
+
+		for (A_long i = 0; i < count; i++) {
+			dst[bucket[(src[i].key >> shift) & mask]++] = src[i];
+		}
+		std::swap(src, dst);
+	}
+
+	if (src != keys) {
+		memcpy(keys, src, count * sizeof(DepthSortKey));
+	}
+}
+
+// ============================================================================
+// PHASE 3: Sort copies by camera depth for proper Z-order
+// ============================================================================
+PF_Err
+SortCopiesByDepth(
+	CopyInstanceBuffer	*instances,
+	PF_Boolean			cameraAware,
+	const A_u_long		*orderHint)
+{
+	if (!instances) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	// Without camera awareness copies draw in grid order
+	const A_long count = instances->count;
+	if (!cameraAware || count <= 1) {
+		return PF_Err_NONE;
+	}
+
+	// Sort by camera depth (ascending - furthest first), ties by copy index
+	std::vector<DepthSortKey> keys;
+	try {
+		keys.resize(count);
+	} catch (const std::bad_alloc&) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	const float *depth = instances->depth;
+	bool sorted = false;
+
+	if (orderHint) {
+		// Camera moves between frames barely change the order: repair the
+		// previous one, which is close to linear when it is nearly sorted
+		for (A_long i = 0; i < count; i++) {
+			keys[i].index = orderHint[i];
+			keys[i].key = DepthToSortKey(depth[orderHint[i]]);
+		}
+		sorted = InsertionSortDepthKeys(keys.data(), count,
+										(A_u_longlong)count * DEPTH_SORT_REPAIR_MOVES);
+	}
+
+	if (!sorted) {
+		for (A_long i = 0; i < count; i++) {
+			keys[i].index = (A_u_long)i;
+			keys[i].key = DepthToSortKey(depth[i]);
+		}
+
+		if (count <= DEPTH_SORT_RADIX_MIN) {
+			InsertionSortDepthKeys(keys.data(), count, ~(A_u_longlong)0);
+		} else {
+			std::vector<DepthSortKey> scratch;
+			try {
+				scratch.resize(count);
+			} catch (const std::bad_alloc&) {
+				return PF_Err_OUT_OF_MEMORY;
+			}
+			RadixSortDepthKeys(keys.data(), scratch.data(), count);
+		}
+	}
+
+	for (A_long i = 0; i < count; i++) {
+		instances->order[i] = keys[i].index;
+	}
+
+	return PF_Err_NONE;
+}
+
+// Source footprint of one output pixel at output position (x, y): the
+// largest column norm of the Jacobian of the layer -> source map there
+static PF_FpLong
+ComputeFootprint(
+	const CopyHomography&	homography,
+	PF_FpLong				x,
+	PF_FpLong				y)
+{
+	const PF_FpLong *m = homography.m;
+	PF_FpLong w = m[6] * x + m[7] * y + m[8];
+	PF_FpLong u = (m[0] * x + m[1] * y + m[2]) / w;
+	PF_FpLong v = (m[3] * x + m[4] * y + m[5]) / w;
+
+	PF_FpLong dudx = (m[0] - u * m[6]) / w;
+	PF_FpLong dvdx = (m[3] - v * m[6]) / w;
+	PF_FpLong dudy = (m[1] - u * m[7]) / w;
+	PF_FpLong dvdy = (m[4] - v * m[7]) / w;
+
+	return std::max(std::sqrt(dudx * dudx + dvdx * dvdx),
+					std::sqrt(dudy * dudy + dvdy * dvdy));
+}
+
+// Mip level a copy should sample from (0 = full resolution)
+// The level is chosen from the source footprint of one output pixel, so a
+// copy shown at 1/rho of its size reads the level where that footprint is
+// 1-2 texels (a 4K source at 5% reads the 256 px level).
+// Perspective copies use the smallest footprint over the layer corners in
+// front of the camera, so their nearest part is never blurred. homography
+// must map layer space to layer-space source pixels.
+static A_long
+ComputeCopyMipLevel(
+	const CopyHomography&	homography,
+	A_long					layerWidth,
+	A_long					layerHeight)
+{
+	PF_FpLong rho = 0.0;
+
+	if (homography.IsAffine()) {
+		rho = ComputeFootprint(homography, 0.0, 0.0);
+	} else {
+		PF_FpLong fwd[9];
+		if (!InvertMatrix3(homography.m, fwd)) {
+			return 0;
+		}
+
+		const PF_FpLong us[4] = {0.0, layerWidth - 1.0, 0.0, layerWidth - 1.0};
+		const PF_FpLong vs[4] = {0.0, 0.0, layerHeight - 1.0, layerHeight - 1.0};
+		rho = DBL_MAX;
+
+		for (int i = 0; i < 4; i++) {
+			PF_FpLong w = fwd[6] * us[i] + fwd[7] * vs[i] + fwd[8];
+			if (!(w > 0.0)) {
+				continue;
+			}
+			PF_FpLong x = (fwd[0] * us[i] + fwd[1] * vs[i] + fwd[2]) / w;
+			PF_FpLong y = (fwd[3] * us[i] + fwd[4] * vs[i] + fwd[5]) / w;
+			rho = std::min(rho, ComputeFootprint(homography, x, y));
+		}
+	}
+
+	if (!(rho >= 2.0) || !std::isfinite(rho)) {
+		return 0;
+	}
+	return std::min((A_long)std::floor(std::log2(rho)), (A_long)SOURCE_MIP_MAX_LEVEL);
+}
+
+// Re-express an output -> source homography in the texel space of a mip level
+// Texel i of level l is centered on level-0 coordinate (i + 0.5) * 2^l - 0.5.
+static void
+ScaleCopyHomographyToMipLevel(
+	A_long			level,
+	CopyHomography	*homography)
+{
+	if (level <= 0) {
+		return;
+	}
+
+	PF_FpLong *m = homography->m;
+	PF_FpLong inv = 1.0 / (PF_FpLong)(1L << level);
+	PF_FpLong shift = 0.5 * inv - 0.5;
+
+	// u' = u * inv + shift, applied to the homogeneous rows
+	for (int c = 0; c < 3; c++) {
+		m[c] = m[c] * inv + shift * m[6 + c];
+		m[3 + c] = m[3 + c] * inv + shift * m[6 + c];
+	}
+}
+
+// Output rows per work item of the threaded renderer
+#define RENDER_BAND_ROWS 16
+
+// A visible copy resolved for rendering
+struct CopyRenderInfo {
+	PF_EffectWorld	*source;      // mip level this copy samples
+	const SourceCoverage	*coverage;    // alpha runs of that level
+	SourceSampleArea	area;     // source area with alpha
+	CopyHomography	homography;   // output-buffer -> source-level map
+	PF_FpLong	opacity;          // clamped to [0, 100]
+	PF_LRect	rect;             // covered output pixels (non-empty)
+	const CopyHomography	*motion;  // motionSamples output -> source-level maps
+	                              // over the shutter, or NULL when still
+	A_long		motionSamples;
+	PF_Boolean	splat;            // drawn by RenderSplatRowTmpl instead of sampled
+	PF_FpLong	splatCenter[2];   // output position of the source's alpha centroid
+	PF_FpLong	splatHalf;        // half the side of the splat square (>= 0.5)
+	PF_FpLong	splatInk[4];      // premultiplied alpha, red, green, blue it
+	                              // deposits, in whole opaque pixels
+	A_long		translation;      // CopyTranslation
+	A_long		shift[2];         // source texel = output pixel + shift
+	float		shiftFraction[2]; // subpixel part of the shift, in [0, 1)
+};
+
+// Copies whose map is a pure shift of their source level (no rotation,
+// scale or projection left once the mip level is picked) skip the bilinear
+// kernels: integer shifts composite source rows straight onto output rows,
+// subpixel ones filter two source rows with separable 2-tap weights
+enum CopyTranslation {
+	COPY_TRANSLATION_NONE = 0,
+	COPY_TRANSLATION_INTEGER,
+	COPY_TRANSLATION_SUBPIXEL
+};
+
+// A copy counts as shifted when no pixel of its rect lands more than this
+// many source pixels away from the pure shift (and shifts within it of an
+// integer are integer)
+#define COPY_TRANSLATION_MAX_DRIFT	(1.0 / 1024.0)
+
+// Set copy->translation and its shift from the homography over copy->rect
+// Nearest rounds the shift to whole texels, as nearest sampling would.
+static void
+ClassifyCopyTranslation(
+	PF_Boolean		nearest,
+	CopyRenderInfo	*copy)
+{
+	const PF_FpLong *m = copy->homography.m;
+	copy->translation = COPY_TRANSLATION_NONE;
+
+	if (!copy->homography.IsAffine()) {
+		return;
+	}
+	const PF_FpLong width = copy->rect.right - copy->rect.left;
+	const PF_FpLong height = copy->rect.bottom - copy->rect.top;
+	if (!(fabs(m[0] - 1.0) * width + fabs(m[1]) * height < COPY_TRANSLATION_MAX_DRIFT &&
+		  fabs(m[3]) * width + fabs(m[4] - 1.0) * height < COPY_TRANSLATION_MAX_DRIFT)) {
+		return;
+	}
+
+	// Shift at the center of the rect
+	const PF_FpLong cx = 0.5 * (copy->rect.left + copy->rect.right);
+	const PF_FpLong cy = 0.5 * (copy->rect.top + copy->rect.bottom);
+	const PF_FpLong t[2] = {
+		m[0] * cx + m[1] * cy + m[2] - cx,
+		m[3] * cx + m[4] * cy + m[5] - cy
+	};
+
+	for (int k = 0; k < 2; k++) {
+		if (!(fabs(t[k]) < 1.0e9)) {
+			return;
+		}
+		PF_FpLong whole = floor(nearest ? t[k] + 0.5 : t[k]);
+		PF_FpLong fraction = nearest ? 0.0 : t[k] - whole;
+		if (fraction < COPY_TRANSLATION_MAX_DRIFT) {
+			fraction = 0.0;
+		} else if (fraction > 1.0 - COPY_TRANSLATION_MAX_DRIFT) {
+			whole += 1.0;
+			fraction = 0.0;
+		}
+		copy->shift[k] = (A_long)whole;
+		copy->shiftFraction[k] = (float)fraction;
+	}
+
+	copy->translation = (copy->shiftFraction[0] == 0.0f && copy->shiftFraction[1] == 0.0f) ?
+						COPY_TRANSLATION_INTEGER : COPY_TRANSLATION_SUBPIXEL;
+}
+
+// Copies whose source spans at most this many output pixels are splatted:
+// their whole premultiplied color is spread over a square, as large as the
+// copy's alpha and at least one pixel, around where the source's alpha
+// centroid lands, instead of sampling it per pixel. Draft renders splat
+// larger copies.
+#define COPY_SPLAT_MAX_EXTENT		2.0
+#define COPY_SPLAT_MAX_EXTENT_DRAFT	4.0
+
+// Color sum and alpha centroid of one mip level, shared by its splats
+struct SourceSplatSprite {
+	PF_Boolean	built;
+	PF_FpLong	sum[4];           // premultiplied alpha, red, green, blue;
+	                              // 1.0 is one opaque texel
+	PF_FpLong	centroid[2];      // alpha-weighted texel position
+
+	SourceSplatSprite() : built(FALSE) {}
+};
+
+template<typename PixelType, int MaxChannelInt>
+static void
+BuildSourceSplatSpriteTmpl(
+	const PF_EffectWorld&	level,
+	const SourceCoverage&	coverage,
+	SourceSplatSprite		*sprite)
+{
+	PF_FpLong sum[4] = {0.0, 0.0, 0.0, 0.0};
+	PF_FpLong cx = 0.0, cy = 0.0;
+
+	for (A_long y = coverage.bounds.top; y < coverage.bounds.bottom; y++) {
+		const PixelType *row = (const PixelType*)((const char*)level.data + (std::ptrdiff_t)y * level.rowbytes);
+		PF_FpLong rowAlpha = 0.0;
+
+		for (A_long r = coverage.rowStart[y]; r < coverage.rowStart[y + 1]; r++) {
+			for (A_long x = coverage.runs[r].begin; x < coverage.runs[r].end; x++) {
+				const PixelType& p = row[x];
+				rowAlpha += p.alpha;
+				cx += (PF_FpLong)p.alpha * x;
+				sum[1] += p.red;
+				sum[2] += p.green;
+				sum[3] += p.blue;
+			}
+		}
+		sum[0] += rowAlpha;
+		cy += rowAlpha * y;
+	}
+
+	for (int c = 0; c < 4; c++) {
+		sprite->sum[c] = sum[c] / MaxChannelInt;
+	}
+	sprite->centroid[0] = sum[0] > 0.0 ? cx / sum[0] : 0.0;
+	sprite->centroid[1] = sum[0] > 0.0 ? cy / sum[0] : 0.0;
+	sprite->built = TRUE;
+}
+
+static void
+BuildSourceSplatSprite(
+	const PF_EffectWorld&	level,
+	const SourceCoverage&	coverage,
+	PF_Boolean				floatB,
+	PF_Boolean				deepB,
+	SourceSplatSprite		*sprite)
+{
+	if (floatB) {
+		BuildSourceSplatSpriteTmpl<PF_PixelFloat, 1>(level, coverage, sprite);
+	} else if (deepB) {
+		BuildSourceSplatSpriteTmpl<PF_Pixel16, PF_MAX_CHAN16>(level, coverage, sprite);
+	} else {
+		BuildSourceSplatSpriteTmpl<PF_Pixel, PF_MAX_CHAN8>(level, coverage, sprite);
+	}
+}
+
+// Splat copy onto the pixels of row y its square covers
+// Each pixel [x - 0.5, x + 0.5) gets the ink in proportion to its overlap
+// with the square; a one-pixel square is a bilinear splat of the center.
+// The square holds at most one opaque pixel of ink per pixel. Compositing
+// is the same as for sampled pixels, so splats and sampled copies mix in
+// any order.
+template<typename PixelType, int MaxChannelInt, bool FrontToBack>
+static A_long
+RenderSplatRowTmpl(
+	const CopyRenderInfo&	copy,
+	PixelType				*dstRow,
+	A_long					y,
+	RenderPixelCounts		*counts)
+{
+	typedef decltype(dstRow->alpha) ChannelType;
+
+	const PF_FpLong h = copy.splatHalf;
+	const PF_FpLong left = copy.splatCenter[0] - h;
+	const PF_FpLong right = copy.splatCenter[0] + h;
+	const PF_FpLong top = copy.splatCenter[1] - h;
+	const PF_FpLong bottom = copy.splatCenter[1] + h;
+	const PF_FpLong wy = std::min(y + 0.5, bottom) - std::max(y - 0.5, top);
+	if (!(wy > 0.0)) {
+		return 0;
+	}
+
+	const PF_FpLong norm = wy / (4.0 * h * h);
+	A_long saturated = 0;
+
+	for (A_long x = copy.rect.left; x < copy.rect.right; x++) {
+		const PF_FpLong wx = std::min(x + 0.5, right) - std::max(x - 0.5, left);
+		if (!(wx > 0.0)) {
+			continue;
+		}
+
+		PF_FpLong k = wx * norm;
+		if (k * copy.splatInk[0] > 1.0) {
+			k = 1.0 / copy.splatInk[0];
+		}
+
+		PixelType src;
+		if constexpr (MaxChannelInt == 1) {
+			src.alpha = (PF_FpShort)(k * copy.splatInk[0]);
+			src.red   = (PF_FpShort)(k * copy.splatInk[1]);
+			src.green = (PF_FpShort)(k * copy.splatInk[2]);
+			src.blue  = (PF_FpShort)(k * copy.splatInk[3]);
+		} else {
+			const PF_FpLong scale = k * MaxChannelInt;
+			src.alpha = (ChannelType)std::min(copy.splatInk[0] * scale + 0.5, (PF_FpLong)MaxChannelInt);
+			src.red   = (ChannelType)std::min(copy.splatInk[1] * scale + 0.5, (PF_FpLong)MaxChannelInt);
+			src.green = (ChannelType)std::min(copy.splatInk[2] * scale + 0.5, (PF_FpLong)MaxChannelInt);
+			src.blue  = (ChannelType)std::min(copy.splatInk[3] * scale + 0.5, (PF_FpLong)MaxChannelInt);
+		}
+
+		if constexpr (FrontToBack) {
+			if (IsPixelSaturated<PixelType, MaxChannelInt>(dstRow[x])) {
+				continue;
+			}
+			if constexpr (MaxChannelInt == 1) {
+				saturated += CompositeSpanUnderFloat(&dstRow[x], &src, 1, 1.0f);
+			} else {
+				saturated += CompositeSpanUnderInt<PixelType, MaxChannelInt>(&dstRow[x], &src, 1, MaxChannelInt);
+			}
+		} else if constexpr (MaxChannelInt == 1) {
+			CompositePremultFloat(&dstRow[x], &src);
+		} else {
+			CompositeSpanPremultInt<PixelType, MaxChannelInt>(&dstRow[x], &src, 1, MaxChannelInt);
+		}
+		counts->sampled++;
+		counts->composited++;
+	}
+
+	return saturated;
+}
+
+// Bilinear samples of count pixels between two source rows, all at the same
+// fraction (fx, fy) of a texel: a vertical 2-tap pass over count + 1
+// columns, then a horizontal 2-tap pass. Both are plain loops over the
+// channels, which the compiler vectorizes.
+template<typename PixelType, int MaxChannelInt>
+static inline void
+FilterShiftedBatchTmpl(
+	const PixelType	*row0,
+	const PixelType	*row1,
+	A_long			count,
+	float			fx,
+	float			fy,
+	PixelType		*samples)
+{
+	typedef decltype(samples->alpha) ChannelType;
+
+	const ChannelType *a = (const ChannelType*)row0;
+	const ChannelType *b = (const ChannelType*)row1;
+	ChannelType *out = (ChannelType*)samples;
+	float column[(SAMPLE_BATCH_MAX + 1) * 4];
+	const float gx = 1.0f - fx;
+	const float gy = 1.0f - fy;
+
+	for (A_long k = 0; k < (count + 1) * 4; k++) {
+		column[k] = (float)a[k] * gy + (float)b[k] * fy;
+	}
+	for (A_long k = 0; k < count * 4; k++) {
+		const float c = column[k] * gx + column[k + 4] * fx;
+		if constexpr (MaxChannelInt == 1) {
+			out[k] = c;
+		} else {
+			out[k] = (ChannelType)(c + 0.5f);
+		}
+	}
+}
+
+// Render the span [xBegin, xEnd) of row y of a shifted copy (see
+// ClassifyCopyTranslation); output pixel x reads texel x + shift. The
+// caller keeps the span over the source's alpha runs, so every texel (and
+// for Subpixel its right and lower neighbours) is in the padded level.
+// Returns and counts as RenderSpanTmpl.
+template<typename PixelType, int MaxChannelInt, bool FrontToBack, bool Subpixel>
+static A_long
+RenderShiftedSpanTmpl(
+	const CopyRenderInfo&	copy,
+	PixelType				*dstRow,
+	A_long					xBegin,
+	A_long					xEnd,
+	A_long					y,
+	RenderPixelCounts		*counts)
+{
+	const PF_EffectWorld& src = *copy.source;
+	const char *rowData = (const char*)src.data + (std::ptrdiff_t)(y + copy.shift[1]) * src.rowbytes;
+	const PixelType *row0 = (const PixelType*)rowData + copy.shift[0];
+	const PixelType *row1 = (const PixelType*)(rowData + src.rowbytes) + copy.shift[0];
+
+	PixelType samples[SAMPLE_BATCH_MAX];
+	const A_u_long opFixed = OpacityToFixed<MaxChannelInt>(copy.opacity);
+	A_long saturated = 0;
+
+	if constexpr (FrontToBack) {
+		TrimSaturatedSpan<PixelType, MaxChannelInt>(dstRow, &xBegin, &xEnd);
+	}
+
+	for (A_long x0 = xBegin; x0 < xEnd; x0 += SAMPLE_BATCH_MAX) {
+		A_long count = std::min<A_long>(SAMPLE_BATCH_MAX, xEnd - x0);
+
+		if constexpr (Subpixel) {
+			FilterShiftedBatchTmpl<PixelType, MaxChannelInt>(row0 + x0, row1 + x0, count,
+				copy.shiftFraction[0], copy.shiftFraction[1], samples);
+			saturated += CompositeSamplesTmpl<PixelType, MaxChannelInt, FrontToBack>(
+				dstRow + x0, samples, count, copy.opacity, opFixed);
+		} else {
+			saturated += CompositeTexelsTmpl<PixelType, MaxChannelInt, FrontToBack>(
+				dstRow + x0, row0 + x0, count, copy.opacity, opFixed, samples);
+		}
+	}
+
+	if (xBegin < xEnd) {
+		counts->sampled += xEnd - xBegin;
+		counts->composited += xEnd - xBegin;
+	}
+	return saturated;
+}
+
+// Source gap (pixels) below which neighbouring alpha runs are sampled as one
+#define SPAN_RUN_MERGE_GAP	4
+
+// Render row y of a copy, skipping the transparent parts of its source
+// When the copy keeps source rows horizontal (affine, m[3] == 0), the row
+// samples between two source rows; only the output spans over their alpha
+// runs are sampled, by RenderShiftedSpanTmpl for shifted copies. Other
+// copies sample the whole span.
+template<typename PixelType, int MaxChannelInt, bool FrontToBack, bool Nearest>
+static A_long
+RenderCopyRowTmpl(
+	const CopyRenderInfo&	copy,
+	PixelType				*dstRow,
+	A_long					y,
+	void					(*sampleBatch)(const char*, A_long, const SampleBatch*, A_long, PixelType*),
+	RenderPixelCounts		*counts)
+{
+	if (copy.splat) {
+		return RenderSplatRowTmpl<PixelType, MaxChannelInt, FrontToBack>(copy, dstRow, y, counts);
+	}
+	if (copy.motion) {
+		// Union of the spans of every sample
+		A_long xBegin = copy.rect.right;
+		A_long xEnd = copy.rect.left;
+		for (A_long k = 0; k < copy.motionSamples; k++) {
+			A_long begin = copy.rect.left;
+			A_long end = copy.rect.right;
+			ComputeCopySpan(copy.motion[k], y, copy.area, &begin, &end);
+			if (begin < end) {
+				xBegin = std::min(xBegin, begin);
+				xEnd = std::max(xEnd, end);
+			}
+		}
+		if (xBegin >= xEnd) {
+			return 0;
+		}
+		return RenderMotionSpanTmpl<PixelType, MaxChannelInt, FrontToBack, Nearest>(
+			copy.source, dstRow, xBegin, xEnd, copy.motion, copy.motionSamples, y, copy.opacity, sampleBatch, counts);
+	}
+
+	A_long xBegin = copy.rect.left;
+	A_long xEnd = copy.rect.right;
+	ComputeCopySpan(copy.homography, y, copy.area, &xBegin, &xEnd);
+
+	const PF_FpLong *m = copy.homography.m;
+	const PF_Boolean shifted = copy.translation != COPY_TRANSLATION_NONE;
+	if (xBegin >= xEnd || (!shifted && (!copy.homography.IsAffine() || m[3] != 0.0))) {
+		return RenderSpanTmpl<PixelType, MaxChannelInt, FrontToBack, Nearest>(copy.source, dstRow, xBegin, xEnd, copy.homography, y, copy.opacity, sampleBatch, counts);
+	}
+
+	// Union of the alpha runs of the two rows the bilinear taps read (one
+	// for integer shifts); the span is already clipped to [-1, h), and the
+	// apron rows have no runs
+	const SourceCoverage& coverage = *copy.coverage;
+	const A_long iy = shifted ? y + copy.shift[1] : (A_long)floor(m[4] * y + m[5]);
+	const A_long rowA = std::max<A_long>(iy, 0);
+	const A_long rowB = std::min<A_long>(iy + (copy.translation == COPY_TRANSLATION_INTEGER ? 1 : 2), coverage.height);
+	if (rowA >= rowB) {
+		return 0;
+	}
+
+	const SourceRun *a = coverage.runs.data() + coverage.rowStart[rowA];
+	const SourceRun *aEnd = coverage.runs.data() + coverage.rowStart[rowA + 1];
+	const SourceRun *b = aEnd;
+	const SourceRun *bEnd = coverage.runs.data() + coverage.rowStart[rowB];
+
+	SourceRun runs[2 * SOURCE_COVERAGE_MAX_ROW_RUNS];
+	A_long runCount = 0;
+	while (a < aEnd || b < bEnd) {
+		const SourceRun *next = (b >= bEnd || (a < aEnd && a->begin <= b->begin)) ? a++ : b++;
+
+		// Samples in [begin - 1, end) have a tap inside the run
+		if (runCount > 0 && next->begin - 1 <= runs[runCount - 1].end + SPAN_RUN_MERGE_GAP) {
+			runs[runCount - 1].end = std::max(runs[runCount - 1].end, next->end);
+		} else {
+			runs[runCount].begin = next->begin - 1;
+			runs[runCount].end = next->end;
+			runCount++;
+		}
+	}
+
+	// Walk the runs in output order; sub-spans keep one pixel of slack, so
+	// each starts where the previous one ended at the earliest
+	const PF_FpLong rowU = m[1] * y + m[2];
+	const A_long first = (m[0] >= 0.0) ? 0 : runCount - 1;
+	const A_long step = (m[0] >= 0.0) ? 1 : -1;
+	A_long saturated = 0;
+	A_long done = xBegin;
+
+	for (A_long r = first; r >= 0 && r < runCount; r += step) {
+		A_long runBegin = done;
+		A_long runEnd = xEnd;
+
+		if (shifted) {
+			// Output pixels whose texel is in the run, exactly
+			runBegin = std::max(runBegin, runs[r].begin - copy.shift[0]);
+			runEnd = std::min(runEnd, runs[r].end - copy.shift[0]);
+			if (runBegin >= runEnd) {
+				continue;
+			}
+			if (copy.translation == COPY_TRANSLATION_INTEGER) {
+				saturated += RenderShiftedSpanTmpl<PixelType, MaxChannelInt, FrontToBack, false>(copy, dstRow, runBegin, runEnd, y, counts);
+			} else {
+				saturated += RenderShiftedSpanTmpl<PixelType, MaxChannelInt, FrontToBack, true>(copy, dstRow, runBegin, runEnd, y, counts);
+			}
+			done = runEnd;
+			continue;
+		}
+
+		ClipSpanAxis(m[0], rowU - runs[r].begin, (PF_FpLong)(runs[r].end - runs[r].begin), &runBegin, &runEnd);
+		if (runBegin >= runEnd) {
+			continue;
+		}
+
+		saturated += RenderSpanTmpl<PixelType, MaxChannelInt, FrontToBack, Nearest>(copy.source, dstRow, runBegin, runEnd, copy.homography, y, copy.opacity, sampleBatch, counts);
+		done = runEnd;
+	}
+
+	return saturated;
+}
+
+// Output rows [top, bottom) of one copy
+struct CopyRowRange {
+	A_long	top;
+	A_long	bottom;
+};
+
+// Shared state of one RenderCopies call
+// Workers pull RENDER_BAND_ROWS-row bands of the output from nextBand and
+// composite every copy, in sorted order, into the band. Bands never overlap
+// and each pixel still sees the copies in the same order, so the result is
+// identical to a serial render whatever the thread count or scheduling.
+struct RenderBandContext {
+	const RenderHost		*host;
+	PF_LayerDef				*output;
+	const SampleKernels		*kernels;
+	const CopyRenderInfo	*copies;
+	const CopyRowRange		*copyRows;    // rows of copies[i]; every band scans
+	                                      // these instead of the larger copies
+	A_long					copyCount;
+	PF_Boolean				floatB;
+	PF_Boolean				deepB;
+	PF_Boolean				frontToBack;  // "under" nearest-first, see RenderBandTmpl
+	PF_Boolean				nearest;      // draft: nearest-neighbor sampling
+	A_long					bandCount;
+	std::atomic<A_long>		nextBand;
+	std::atomic<PF_Err>		err;          // first error; stops all workers
+
+	// Totals of the finished bands, for RenderStats
+	std::atomic<A_long>			rowsDone;
+	std::atomic<A_u_longlong>	pixelsSampled;
+	std::atomic<A_u_longlong>	pixelsComposited;
+
+	RenderBandContext() : nextBand(0), err(PF_Err_NONE), rowsDone(0), pixelsSampled(0), pixelsComposited(0) {}
+};
+
+// Composite every copy into output rows [yBegin, yEnd)
+template<typename PixelType, int MaxChannelInt, bool Nearest>
+static void
+RenderBandTmpl(
+	const RenderBandContext	*ctx,
+	A_long					yBegin,
+	A_long					yEnd,
+	void					(*sampleBatch)(const char*, A_long, const SampleBatch*, A_long, PixelType*),
+	RenderPixelCounts		*counts)
+{
+	PF_LayerDef *output = ctx->output;
+
+	if (!ctx->frontToBack) {
+		for (A_long i = 0; i < ctx->copyCount; i++) {
+			A_long top = std::max(ctx->copyRows[i].top, yBegin);
+			A_long bottom = std::min(ctx->copyRows[i].bottom, yEnd);
+
+			for (A_long y = top; y < bottom; y++) {
+				PixelType *dstRow = (PixelType*)((char*)output->data + y * output->rowbytes);
+				RenderCopyRowTmpl<PixelType, MaxChannelInt, false, Nearest>(ctx->copies[i], dstRow, y, sampleBatch, counts);
+			}
+		}
+		return;
+	}
+
+	// Front to back: nearest copy first. Rows stop taking copies once all of
+	// their pixels are saturated, and the band stops once all rows have.
+	A_long open[RENDER_BAND_ROWS];
+	A_long openRows = yEnd - yBegin;
+	for (A_long r = 0; r < openRows; r++) {
+		open[r] = output->width;
+	}
+
+	for (A_long i = ctx->copyCount - 1; i >= 0 && openRows > 0; i--) {
+		const CopyRenderInfo& copy = ctx->copies[i];
+		A_long top = std::max(ctx->copyRows[i].top, yBegin);
+		A_long bottom = std::min(ctx->copyRows[i].bottom, yEnd);
+
+		for (A_long y = top; y < bottom; y++) {
+			A_long& rowOpen = open[y - yBegin];
+			if (rowOpen <= 0) {
+				continue;
+			}
+
+			PixelType *dstRow = (PixelType*)((char*)output->data + y * output->rowbytes);
+			rowOpen -= RenderCopyRowTmpl<PixelType, MaxChannelInt, true, Nearest>(copy, dstRow, y, sampleBatch, counts);
+			if (rowOpen <= 0) {
+				openRows--;
+			}
+		}
+	}
+}
+
+static void
+RenderBand(
+	RenderBandContext	*ctx,
+	A_long				yBegin,
+	A_long				yEnd)
+{
+	const SampleKernels *kernels = ctx->kernels;
+	RenderPixelCounts counts;
+
+	if (ctx->nearest) {
+		if (ctx->floatB) {
+			RenderBandTmpl<PF_PixelFloat, 1, true>(ctx, yBegin, yEnd, kernels->sampleFloat, &counts);
+		} else if (ctx->deepB) {
+			RenderBandTmpl<PF_Pixel16, PF_MAX_CHAN16, true>(ctx, yBegin, yEnd, kernels->sample16, &counts);
+		} else {
+			RenderBandTmpl<PF_Pixel, PF_MAX_CHAN8, true>(ctx, yBegin, yEnd, kernels->sample8, &counts);
+		}
+	} else if (ctx->floatB) {
+		RenderBandTmpl<PF_PixelFloat, 1, false>(ctx, yBegin, yEnd, kernels->sampleFloat, &counts);
+	} else if (ctx->deepB) {
+		RenderBandTmpl<PF_Pixel16, PF_MAX_CHAN16, false>(ctx, yBegin, yEnd, kernels->sample16, &counts);
+	} else {
+		RenderBandTmpl<PF_Pixel, PF_MAX_CHAN8, false>(ctx, yBegin, yEnd, kernels->sample8, &counts);
+	}
+
+	ctx->rowsDone.fetch_add(yEnd - yBegin, std::memory_order_relaxed);
+	ctx->pixelsSampled.fetch_add(counts.sampled, std::memory_order_relaxed);
+	ctx->pixelsComposited.fetch_add(counts.composited, std::memory_order_relaxed);
+}
+
+// iterate_generic callback: render bands until none remain, an error
+// occurs or the user cancels
+static PF_Err
+RenderBandsThread(
+	void	*refconPV,
+	A_long	thread_indexL,
+	A_long	i,
+	A_long	iterationsL)
+{
+	PF_Err err = PF_Err_NONE;
+	RenderBandContext *ctx = reinterpret_cast<RenderBandContext*>(refconPV);
+	const A_long height = ctx->output->height;
+
+	while (!err && ctx->err.load() == PF_Err_NONE) {
+		A_long band = ctx->nextBand.fetch_add(1);
+		if (band >= ctx->bandCount) {
+			break;
+		}
+
+		A_long yBegin = band * RENDER_BAND_ROWS;
+		A_long yEnd = std::min(yBegin + RENDER_BAND_ROWS, height);
+		RenderBand(ctx, yBegin, yEnd);
+
+		if (ctx->host->abort) {
+			ERR(ctx->host->abort(ctx->host->refcon));
+		}
+	}
+
+	if (err) {
+		PF_Err expected = PF_Err_NONE;
+		ctx->err.compare_exchange_strong(expected, err);
+	}
+
+	return err;
+}
+
+// Fresh, uncached scan of the alpha coverage of srcP
+static PF_Err
+ScanSourceCoverage(
+	const PF_EffectWorld	*srcP,
+	PF_Boolean				floatB,
+	PF_Boolean				deepB,
+	SourceCoverageRef		*coverage)
+{
+	PF_Err err = PF_Err_NONE;
+	std::shared_ptr<SourceCoverage> scanned;
+
+	try {
+		scanned = std::make_shared<SourceCoverage>();
+	} catch (const std::bad_alloc&) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	ERR(BuildSourceCoverage(srcP, floatB, deepB, scanned.get()));
+
+	if (!err) {
+		*coverage = scanned;
+	}
+
+	return err;
+}
+
+// Moving copies get one shutter sample per this many output pixels their
+// fastest corner travels (draft renders space them wider), up to
+// MOTION_BLUR_MAX_SAMPLES
+#define MOTION_BLUR_SAMPLE_SPACING			1.0
+#define MOTION_BLUR_SAMPLE_SPACING_DRAFT	4.0
+#define MOTION_BLUR_MAX_SAMPLES				64
+
+// Output-buffer -> source-buffer maps of copy i at instants spread evenly
+// over the shutter, appended to homographies. Returns how many, or 1 (and
+// appends nothing) when the copy moves less than spacing or is not in
+// front of the camera at both ends. The forward maps at shutter open and
+// close are interpolated linearly, so the corners of area, the source
+// rect that can draw, travel in straight lines between their end points.
+// Appending may throw std::bad_alloc; callers turn it into
+// PF_Err_OUT_OF_MEMORY.
+static A_long
+ComputeCopyMotionSamples(
+	const CopyMotion&				motion,
+	A_long							i,
+	const RenderGeometry&			geometry,
+	const SourceSampleArea&			area,
+	PF_FpLong						spacing,
+	std::vector<CopyHomography>		*homographies)
+{
+	if (!motion.open->IsVisible(i) || !motion.close->IsVisible(i)) {
+		return 1;
+	}
+
+	const CopyInstanceBuffer *ends[2] = {motion.open, motion.close};
+	PF_FpLong fwd[2][9];
+	bool affine = true;
+
+	for (int e = 0; e < 2; e++) {
+		CopyHomography h;
+		ExpandCopyHomography(*ends[e], i, geometry, &h);
+		OffsetCopyHomography(geometry, &h);
+		affine = affine && h.IsAffine();
+
+		// Scaled to W = 1 at the source origin, so both ends interpolate alike
+		if (!InvertMatrix3(h.m, fwd[e]) || !(fwd[e][8] > 0.0)) {
+			return 1;
+		}
+		const PF_FpLong w = fwd[e][8];
+		for (int c = 0; c < 9; c++) {
+			fwd[e][c] /= w;
+		}
+	}
+
+	// Travel of the fastest corner
+	const PF_FpLong us[4] = {area.left, area.right, area.left, area.right};
+	const PF_FpLong vs[4] = {area.top, area.top, area.bottom, area.bottom};
+	PF_FpLong travel = 0.0;
+
+	for (int c = 0; c < 4; c++) {
+		PF_FpLong p[2][2];
+		for (int e = 0; e < 2; e++) {
+			const PF_FpLong *f = fwd[e];
+			const PF_FpLong w = f[6] * us[c] + f[7] * vs[c] + f[8];
+			if (!(w > 0.0)) {
+				return 1;
+			}
+			p[e][0] = (f[0] * us[c] + f[1] * vs[c] + f[2]) / w;
+			p[e][1] = (f[3] * us[c] + f[4] * vs[c] + f[5]) / w;
+		}
+		travel = std::max(travel, hypot(p[1][0] - p[0][0], p[1][1] - p[0][1]));
+	}
+
+	if (!std::isfinite(travel) || travel <= spacing) {
+		return 1;
+	}
+
+	const A_long count = (A_long)std::min<PF_FpLong>(ceil(travel / spacing), MOTION_BLUR_MAX_SAMPLES);
+	const size_t first = homographies->size();
+
+	for (A_long k = 0; k < count; k++) {
+		const PF_FpLong t = (k + 0.5) / count;
+		PF_FpLong f[9];
+		for (int c = 0; c < 9; c++) {
+			f[c] = fwd[0][c] + (fwd[1][c] - fwd[0][c]) * t;
+		}
+
+		CopyHomography h;
+		if (!InvertMatrix3(f, h.m)) {
+			homographies->resize(first);
+			return 1;
+		}
+		if (affine) {
+			h.m[6] = h.m[7] = 0.0;
+			h.m[8] = 1.0;
+		}
+		homographies->push_back(h);
+	}
+
+	return count;
+}
+
+// ============================================================================
+// Render bounds: union of projected copy bounds, clipped to the layer
+// ============================================================================
+PF_Err
+ComputeRenderBounds(
+	const CopyInstanceBuffer	*instances,
+	const CopyMotion			*motion,
+	const RenderGeometry		*geometry,
+	const PF_LRect				*requestRect,
+	PF_LRect					*maxRect,
+	PF_LRect					*resultRect,
+	PF_LRect					*sourceRect)
+{
+	if (!instances || !geometry || !requestRect || !maxRect || !resultRect || !sourceRect) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	const A_long layerWidth = geometry->layer_size[0];
+	const A_long layerHeight = geometry->layer_size[1];
+	const PF_LRect layerRect = {0, 0, layerWidth, layerHeight};
+
+	maxRect->left = maxRect->top = maxRect->right = maxRect->bottom = 0;
+	*resultRect = *maxRect;
+	*sourceRect = *maxRect;
+
+	if (motion && (!motion->open || !motion->close ||
+				   motion->open->count != instances->count || motion->close->count != instances->count)) {
+		motion = NULL;
+	}
+
+	std::vector<CopyHomography> homographies;
+	std::vector<PF_LRect> copyBounds;
+	std::vector<bool> copyMoves;
+	std::vector<CopyHomography> motionSamples;
+
+	try {
+		homographies.resize(instances->count);
+		copyBounds.resize(instances->count);
+		copyMoves.resize(instances->count);
+	} catch (const std::bad_alloc&) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	const SourceSampleArea layerArea = GetSourceSampleArea(layerWidth, layerHeight, NULL);
+
+	for (A_long i = 0; i < instances->count; i++) {
+		PF_LRect& bounds = copyBounds[i];
+
+		bounds.left = bounds.top = bounds.right = bounds.bottom = 0;
+		if (!instances->IsVisible(i)) {
+			continue;
+		}
+
+		ExpandCopyHomography(*instances, i, *geometry, &homographies[i]);
+		ComputeCopyLayerBounds(homographies[i], layerArea, &bounds);
+
+		// A moving copy covers the bounds of every shutter sample
+		if (motion) {
+			A_long sampleCount = 1;
+			motionSamples.clear();
+			try {
+				sampleCount = ComputeCopyMotionSamples(*motion, i, *geometry, layerArea, MOTION_BLUR_SAMPLE_SPACING, &motionSamples);
+			} catch (const std::bad_alloc&) {
+				return PF_Err_OUT_OF_MEMORY;
+			}
+			if (sampleCount > 1) {
+				copyMoves[i] = true;
+				for (const CopyHomography& h : motionSamples) {
+					PF_LRect sampleBounds;
+					ComputeCopyLayerBounds(h, layerArea, &sampleBounds);
+					UnionRect(sampleBounds, &bounds);
+				}
+			}
+		}
+
+		IntersectRect(layerRect, &bounds);
+		UnionRect(bounds, maxRect);
+	}
+
+	*resultRect = *maxRect;
+	IntersectRect(*requestRect, resultRect);
+
+	// Source area actually sampled for the requested part of each copy
+	A_long maxLevel = 0;
+	for (A_long i = 0; i < instances->count; i++) {
+		PF_LRect visible = copyBounds[i];
+		IntersectRect(*resultRect, &visible);
+		if (IsRectEmpty(visible)) {
+			continue;
+		}
+
+		maxLevel = std::max(maxLevel, ComputeCopyMipLevel(homographies[i], layerWidth, layerHeight));
+
+		// Moving copies may sample any part of the layer over the shutter
+		if (copyMoves[i]) {
+			UnionRect(layerRect, sourceRect);
+			continue;
+		}
+
+		PF_LRect sampled;
+		MapRectBounds(homographies[i].m,
+					  (PF_FpLong)visible.left,
+					  (PF_FpLong)visible.top,
+					  (PF_FpLong)visible.right,
+					  (PF_FpLong)visible.bottom,
+					  2,
+					  &sampled);
+		IntersectRect(layerRect, &sampled);
+		UnionRect(sampled, sourceRect);
+	}
+
+	// Mip texels gather 2^level source pixels. Pad by one texel and snap
+	// to the texel grid of the deepest level, so every tile the host requests
+	// builds the same texels and copies do not seam across tiles.
+	if (maxLevel > 0 && !IsRectEmpty(*sourceRect)) {
+		A_long cell = 1L << maxLevel;
+		sourceRect->left = ((sourceRect->left - cell) / cell) * cell;
+		sourceRect->top = ((sourceRect->top - cell) / cell) * cell;
+		sourceRect->right = ((sourceRect->right + 2 * cell - 1) / cell) * cell;
+		sourceRect->bottom = ((sourceRect->bottom + 2 * cell - 1) / cell) * cell;
+		IntersectRect(layerRect, sourceRect);
+	}
+
+	return PF_Err_NONE;
+}
+
+// ============================================================================
+// PHASE 4: Render each copy with bilinear sampling
+// ============================================================================
+PF_Err
+RenderCopies(
+	const RenderHost	*host,
+	const ReptAllState	*state,
+	const CopyInstanceBuffer	*instances,
+	const CopyMotion	*motion,
+	const RenderGeometry	*geometry,
+	A_long				depth,
+	PF_EffectWorld		*srcP,
+	PF_EffectWorld		*output)
+{
+	PF_Err err = PF_Err_NONE;
+	static const RenderHost noHost = {NULL, NULL, NULL, NULL, NULL};
+
+	if (!state || !geometry || !srcP || !output || (depth != 8 && depth != 16 && depth != 32)) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+	if (!host) {
+		host = &noHost;
+	}
+
+	RenderStats *stats = host->stats;
+	BeginRenderPhase(stats, RENDER_PHASE_RENDER);
+
+	const PF_Boolean floatB = (depth == 32);
+	const PF_Boolean deepB = (depth == 16);
+	const A_long pixelSize = floatB ? (A_long)sizeof(PF_PixelFloat) :
+							 deepB ? (A_long)sizeof(PF_Pixel16) : (A_long)sizeof(PF_Pixel);
+
+	PF_LRect outputRect = {0, 0, output->width, output->height};
+
+	// Bilinear kernels for this CPU (SSE4.1/AVX2/NEON or scalar)
+	const SampleKernels *kernels = GetSampleKernels();
+
+	// Clear output (transparent black is all-zero in every depth)
+	for (A_long y = 0; y < output->height; y++) {
+		memset((char*)output->data + (std::ptrdiff_t)y * output->rowbytes, 0, (size_t)output->width * pixelSize);
+	}
+
+	// Resolve every visible copy once, in draw order: homography, clamped
+	// opacity and the output rows it can cover
+	const A_long instanceCount = instances ? instances->count : 0;
+	std::vector<CopyRenderInfo> copies;
+	std::vector<A_long> copyLevels;
+	std::vector<size_t> copyMotionFirst;          // into motionSamples
+	std::vector<CopyHomography> motionSamples;
+	A_long maxLevel = 0;
+
+	// Every visible copy is appended below without growing these
+	try {
+		copies.reserve(instanceCount);
+		copyLevels.reserve(instanceCount);
+		copyMotionFirst.reserve(instanceCount);
+	} catch (const std::bad_alloc&) {
+		err = PF_Err_OUT_OF_MEMORY;
+	}
+
+	if (motion && (!motion->open || !motion->close ||
+				   motion->open->count != instanceCount || motion->close->count != instanceCount)) {
+		motion = NULL;
+	}
+	const PF_FpLong motionSpacing = state->draft ? MOTION_BLUR_SAMPLE_SPACING_DRAFT : MOTION_BLUR_SAMPLE_SPACING;
+
+	// Alpha coverage of the source, reused while the layer is unchanged
+	SourceCoverageRef coverage;
+	if (host->acquire_coverage) {
+		ERR(host->acquire_coverage(host->refcon, srcP, depth, &coverage));
+	}
+	if (!err && !coverage) {
+		ERR(ScanSourceCoverage(srcP, floatB, deepB, &coverage));
+	}
+
+	// Copies whose source, projected, stays this small are splatted
+	// (footprints are per source pixel, the same in every buffer scale)
+	PF_FpLong splatMaxFootprint = 0.0;
+	SourceSampleArea sourceArea = {0.0, 0.0, 0.0, 0.0};
+	if (!err) {
+		sourceArea = GetSourceSampleArea(srcP->width, srcP->height, &coverage->bounds);
+
+		const PF_LRect& bounds = coverage->bounds;
+		const A_long extent = std::max(bounds.right - bounds.left, bounds.bottom - bounds.top);
+		if (extent > 0) {
+			splatMaxFootprint = (state->draft ? COPY_SPLAT_MAX_EXTENT_DRAFT : COPY_SPLAT_MAX_EXTENT) / extent;
+		}
+	}
+
+	for (A_long n = 0; n < instanceCount && !err; n++) {
+		A_long i = (A_long)instances->order[n];
+
+		if (!instances->IsVisible(i)) {
+			continue;
+		}
+
+		CopyRenderInfo info;
+
+		// Rotation, scale, projection, center and buffer offsets folded into
+		// one output-buffer -> source-buffer homography. The mip level is
+		// picked in layer space so PreRender sees the same one.
+		ExpandCopyHomography(*instances, i, *geometry, &info.homography);
+		A_long level = ComputeCopyMipLevel(info.homography, geometry->layer_size[0], geometry->layer_size[1]);
+		OffsetCopyHomography(*geometry, &info.homography);
+
+		maxLevel = std::max(maxLevel, level);
+		copyLevels.push_back(level);
+
+		// Apply opacity with clamping
+		info.opacity = instances->opacity[i];
+		if (!std::isfinite(info.opacity)) info.opacity = 100.0;
+		if (info.opacity < 0.0) info.opacity = 0.0;
+		if (info.opacity > 100.0) info.opacity = 100.0;
+
+		// Moving copies are sampled over the shutter and never splatted
+		info.translation = COPY_TRANSLATION_NONE;
+		info.motion = NULL;
+		info.motionSamples = 1;
+		copyMotionFirst.push_back(motionSamples.size());
+		if (motion && !sourceArea.IsEmpty()) {
+			try {
+				info.motionSamples = ComputeCopyMotionSamples(*motion, i, *geometry, sourceArea, motionSpacing, &motionSamples);
+			} catch (const std::bad_alloc&) {
+				err = PF_Err_OUT_OF_MEMORY;
+			}
+		}
+
+		info.splat = info.motionSamples == 1 &&
+					 instances->footprint[i] > 0.0f && instances->footprint[i] <= splatMaxFootprint;
+
+		copies.push_back(info);
+	}
+
+	// Minified copies sample a premultiplied mip level instead of striding
+	// across the full-resolution source
+	SourceMipPyramid pyramid;
+	ERR(BuildSourceMipPyramid(srcP, floatB, deepB, maxLevel, coverage, &pyramid));
+
+	// Clip to the rows and per-row spans each copy can cover, so the cost
+	// scales with covered area rather than the whole output
+	SourceSplatSprite sprites[SOURCE_MIP_MAX_LEVEL + 1];
+	A_long visibleCount = 0;
+	A_long splatCount = 0;
+	A_long blurCount = 0;
+	A_long shiftCount = 0;
+	for (A_long i = 0; i < (A_long)copies.size() && !err; i++) {
+		CopyRenderInfo info = copies[i];
+		A_long level = std::min(copyLevels[i], pyramid.levelCount - 1);
+
+		info.source = &pyramid.level[level];
+		info.coverage = pyramid.coverage[level].get();
+		info.area = GetSourceSampleArea(info.source->width, info.source->height, &info.coverage->bounds);
+		ScaleCopyHomographyToMipLevel(level, &info.homography);
+
+		if (info.motionSamples > 1) {
+			CopyHomography *samples = &motionSamples[copyMotionFirst[i]];
+			info.motion = samples;
+			info.rect.left = info.rect.top = info.rect.right = info.rect.bottom = 0;
+			for (A_long k = 0; k < info.motionSamples; k++) {
+				PF_LRect sampleRect;
+				ScaleCopyHomographyToMipLevel(level, &samples[k]);
+				ComputeCopyLayerBounds(samples[k], info.area, &sampleRect);
+				UnionRect(sampleRect, &info.rect);
+			}
+			IntersectRect(outputRect, &info.rect);
+
+			if (!IsRectEmpty(info.rect)) {
+				copies[visibleCount++] = info;
+				blurCount++;
+			}
+			continue;
+		}
+
+		if (info.splat) {
+			// The level's color sum, scaled by the area one of its texels
+			// covers at the centroid (det(fwd) / W^3 for the forward map)
+			SourceSplatSprite& sprite = sprites[level];
+			if (!sprite.built) {
+				BuildSourceSplatSprite(*info.source, *info.coverage, floatB, deepB, &sprite);
+			}
+
+			PF_FpLong fwd[9];
+			if (sprite.sum[0] <= 0.0 || !InvertMatrix3(info.homography.m, fwd)) {
+				continue;
+			}
+			const PF_FpLong w = fwd[6] * sprite.centroid[0] + fwd[7] * sprite.centroid[1] + fwd[8];
+			if (!(w > 0.0)) {
+				continue;
+			}
+			const PF_FpLong det = fwd[0] * (fwd[4] * fwd[8] - fwd[5] * fwd[7]) -
+								  fwd[1] * (fwd[3] * fwd[8] - fwd[5] * fwd[6]) +
+								  fwd[2] * (fwd[3] * fwd[7] - fwd[4] * fwd[6]);
+			const PF_FpLong texelArea = fabs(det) / (w * w * w) * info.opacity / 100.0;
+
+			info.splatCenter[0] = (fwd[0] * sprite.centroid[0] + fwd[1] * sprite.centroid[1] + fwd[2]) / w;
+			info.splatCenter[1] = (fwd[3] * sprite.centroid[0] + fwd[4] * sprite.centroid[1] + fwd[5]) / w;
+			for (int c = 0; c < 4; c++) {
+				info.splatInk[c] = sprite.sum[c] * texelArea;
+			}
+			if (!std::isfinite(info.splatCenter[0]) || !std::isfinite(info.splatCenter[1]) ||
+				!std::isfinite(texelArea) || fabs(info.splatCenter[0]) > 1.0e9 || fabs(info.splatCenter[1]) > 1.0e9) {
+				continue;
+			}
+
+			// Square of the copy's alpha area (its coverage if opaque)
+			info.splatHalf = 0.5 * std::max(1.0, sqrt(info.splatInk[0]));
+			info.rect.left = (A_long)floor(info.splatCenter[0] - info.splatHalf + 0.5);
+			info.rect.top = (A_long)floor(info.splatCenter[1] - info.splatHalf + 0.5);
+			info.rect.right = (A_long)floor(info.splatCenter[0] + info.splatHalf + 0.5) + 1;
+			info.rect.bottom = (A_long)floor(info.splatCenter[1] + info.splatHalf + 0.5) + 1;
+			IntersectRect(outputRect, &info.rect);
+
+			if (!IsRectEmpty(info.rect)) {
+				copies[visibleCount++] = info;
+				splatCount++;
+			}
+			continue;
+		}
+
+		ComputeCopyLayerBounds(info.homography, info.area, &info.rect);
+		IntersectRect(outputRect, &info.rect);
+
+		if (IsRectEmpty(info.rect)) {
+			continue;
+		}
+
+		// Shifted copies read source rows directly
+		ClassifyCopyTranslation(state->draft, &info);
+		if (info.translation != COPY_TRANSLATION_NONE) {
+			shiftCount++;
+		}
+		copies[visibleCount++] = info;
+	}
+
+	std::vector<CopyRowRange> copyRows;
+	try {
+		copies.resize(visibleCount);
+		copyRows.resize(copies.size());
+	} catch (const std::bad_alloc&) {
+		err = PF_Err_OUT_OF_MEMORY;
+	}
+
+	if (stats) {
+		if (instances) {
+			stats->copiesComputed = instanceCount;
+		}
+		stats->copiesRendered = visibleCount;
+		stats->copiesSplatted = splatCount;
+		stats->copiesBlurred = blurCount;
+		stats->copiesShifted = shiftCount;
+		stats->copiesCulled = stats->copiesComputed - visibleCount;
+		stats->pixelsSampled = 0;
+		stats->pixelsComposited = 0;
+		stats->rowsAborted = 0;
+	}
+
+	if (!err && !copies.empty()) {
+		for (size_t i = 0; i < copies.size(); i++) {
+			copyRows[i].top = copies[i].rect.top;
+			copyRows[i].bottom = copies[i].rect.bottom;
+		}
+
+		RenderBandContext ctx;
+		ctx.host = host;
+		ctx.output = output;
+		ctx.kernels = kernels;
+		ctx.copies = copies.data();
+		ctx.copyRows = copyRows.data();
+		ctx.copyCount = (A_long)copies.size();
+		ctx.floatB = floatB;
+		ctx.deepB = deepB;
+		ctx.frontToBack = state->front_to_back && state->composite_mode == 0;
+		ctx.nearest = state->draft;
+		ctx.bandCount = (output->height + RENDER_BAND_ROWS - 1) / RENDER_BAND_ROWS;
+
+		if (ctx.bandCount > 1 && host->iterate) {
+			// One worker per render thread; workers pull bands until none remain
+			ERR(host->iterate(host->refcon, &ctx, RenderBandsThread));
+		} else {
+			ERR(RenderBandsThread(&ctx, 0, 0, 1));
+		}
+
+		if (stats) {
+			stats->pixelsSampled = ctx.pixelsSampled.load();
+			stats->pixelsComposited = ctx.pixelsComposited.load();
+			stats->rowsAborted = output->height - ctx.rowsDone.load();
+		}
+	}
+
+	EndRenderPhase(stats, RENDER_PHASE_RENDER);
+
+	return err;
+}
+
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
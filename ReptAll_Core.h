@@ -0,0 +1,428 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Core.h
+
+	Host-independent render core: the copy data structures and phases 2-4
+	(transforms, depth sort, rendering). Everything the core needs from the
+	host goes through RenderHost, so it runs inside After Effects
+	(ReptAll.cpp) and in the standalone reptall-render tool alike.
+*/
+
+#ifndef REPTALL_CORE_H
+#define REPTALL_CORE_H
+
+#include "ReptAll_Types.h"
+#include "ReptAll_Fields.h"
+#include "ReptAll_Random.h"
+#include "ReptAll_Source.h"
+#include "ReptAll_Stats.h"
+
+// Maximum copy count per render (all axes combined)
+#define MAX_COPIES (1024 * 1024)
+
+/* Parameter defaults */
+
+// 3D Repeater Parameter Defaults
+#define REPTALL_COUNT_MIN       1
+#define REPTALL_COUNT_MAX       100000
+#define REPTALL_COUNT_SLIDER_MAX 100
+#define REPTALL_COUNT_DFLT      3
+
+#define REPTALL_TRANSLATE_MIN   -500.0
+#define REPTALL_TRANSLATE_MAX   500.0
+#define REPTALL_TRANSLATE_DFLT  0.0
+
+#define REPTALL_ROTATE_MIN      -360.0
+#define REPTALL_ROTATE_MAX      360.0
+#define REPTALL_ROTATE_DFLT     0.0
+
+#define REPTALL_SCALE_MIN       10.0
+#define REPTALL_SCALE_MAX       200.0
+#define REPTALL_SCALE_DFLT      100.0
+
+// Off by default, so existing projects keep back-to-front compositing
+#define REPTALL_FRONT_TO_BACK_DFLT FALSE
+
+// Random group (PARAMETER_SPEC.md phases 5 and 7)
+#define REPTALL_EFFECTOR_COUNT  3
+#define REPTALL_SEED_OFFSET_STEP 100   // default seed offset of effector n is n * step
+
+#define REPTALL_SEED_MIN        0
+#define REPTALL_SEED_MAX        100000
+#define REPTALL_SEED_SLIDER_MAX 1000
+#define REPTALL_SEED_DFLT       0
+
+#define REPTALL_PERCENT_MIN     0.0      // strengths, probabilities and amounts
+#define REPTALL_PERCENT_MAX     100.0
+
+#define REPTALL_FIELD_CENTER_MIN        -10000.0
+#define REPTALL_FIELD_CENTER_MAX        10000.0
+#define REPTALL_FIELD_CENTER_SLIDER_MAX 2000.0
+
+#define REPTALL_FIELD_SIZE_MIN          0.0
+#define REPTALL_FIELD_SIZE_MAX          20000.0
+#define REPTALL_FIELD_SIZE_SLIDER_MAX   4000.0
+#define REPTALL_FIELD_SIZE_DFLT         2000.0
+
+// ============================================================================
+// Data Structures - Scalable architecture for full parameter support
+// ============================================================================
+
+// Per-copy instance data, stored as a structure of arrays
+// Phase 2 fills one entry per copy, phase 3 writes the draw order and phase 4
+// reads only what it composites, so sorting and rendering 100k+ copies
+// streams ~64 bytes per copy. All arrays are carved from one pooled arena
+// (see ReptAll_Instances.h).
+struct CopyInstanceBuffer {
+	A_long		count;            // copies stored
+	A_long		capacity;         // copies the arrays can hold
+	float		*position[3];     // x, y, z position
+	float		*depth;           // distance from camera for sorting
+	float		*opacity;         // opacity (0-100)
+	float		*footprint;       // projected scale at the copy's center: layer
+	                              // pixels per source pixel, across (0 if unknown)
+	float		*homography;      // 9 per copy: inverse 3x3 layer -> source
+	                              // map H about the layer center c, row major:
+	                              //   (X, Y, W) = H * (p - c, 1), src - c = (X, Y) / W
+	                              // W <= 0 where p sees the copy's plane behind
+	                              // the camera; affine copies have row 3 = (0 0 1)
+	A_u_long	*visible;         // visibility bitset, bit i = copy i
+	A_u_long	*order;           // draw order, back to front (copy indices)
+	void		*arena;           // allocation owning this buffer
+
+	PF_Boolean IsVisible(A_long i) const {
+		return (visible[i >> 5] >> (i & 31)) & 1;
+	}
+
+	void SetVisible(A_long i, PF_Boolean isVisible) {
+		if (isVisible) {
+			visible[i >> 5] |= (A_u_long)1 << (i & 31);
+		} else {
+			visible[i >> 5] &= ~((A_u_long)1 << (i & 31));
+		}
+	}
+};
+
+// One random effector: every copy it picks (probability) is offset by a
+// random fraction in [-1, 1] of each amount, scaled by strength, the
+// master strength and the copy's field weight. Random values are keyed by (master seed + seed_offset,
+// effector, copy index, channel), see ReptAll_Random.h.
+struct CopyEffector {
+	A_Boolean	enabled;
+	PF_FpLong	strength;         // percent
+	A_long		seed_offset;      // added to the master seed
+	PF_FpLong	probability;      // percent of copies affected
+	PF_FpLong	position[3];      // pixels
+	PF_FpLong	rotation[3];      // degrees
+	PF_FpLong	scale[3];         // percent; z has no effect on flat copies
+	PF_FpLong	opacity;          // percent
+
+	void Clear(A_long index) {
+		enabled = FALSE;
+		strength = 100.0;
+		seed_offset = index * REPTALL_SEED_OFFSET_STEP;
+		probability = 100.0;
+		for (int i = 0; i < 3; i++) {
+			position[i] = 0.0;
+			rotation[i] = 0.0;
+			scale[i] = 0.0;
+		}
+		opacity = 0.0;
+	}
+};
+
+// Complete parameter state
+// Holds all user-adjustable parameters from the effect UI
+struct ReptAllState {
+	// 3D grid dimensions
+	A_long copies[3];             // copies in X, Y, Z directions
+
+	// Offset/distribution
+	PF_FpLong offset;             // global offset value
+
+	// Anchor point
+	PF_FpLong anchor[3];          // anchor x, y, z
+
+	// Base transform (initial state before stepping)
+	PF_FpLong position[3];        // base position x, y, z
+	PF_FpLong scale;              // base uniform scale (percent)
+	PF_FpLong rotation[3];        // base rotation x, y, z
+
+	// Step values (increment per copy)
+	PF_FpLong step_position[3];   // step x, y, z per copy
+	PF_FpLong step_rotation[3];   // step rotation x, y, z per copy
+	PF_FpLong step_scale;         // step uniform scale (percent)
+
+	// Opacity
+	PF_FpLong opacity_start;      // starting opacity (first copy)
+	PF_FpLong opacity_end;        // ending opacity (last copy)
+
+	// Rendering options
+	A_Boolean camera_aware;       // enable depth-based sorting
+	A_long composite_mode;        // blending mode
+	A_Boolean front_to_back;      // normal blend: composite nearest copy first
+	                              // and skip pixels it already covers
+	A_Boolean draft;              // draft quality: nearest-neighbor sampling
+
+	// Random
+	A_long random_seed;           // master seed
+	PF_FpLong random_strength;    // master strength (percent)
+	A_long random_distribution;   // RandomDistribution
+	SpatialField spatial_field;   // where effectors act, by copy position
+	IndexField index_field;       // where effectors act, by copy index
+	A_long field_combine;         // FieldCombine of the two weights
+	CopyEffector effector[REPTALL_EFFECTOR_COUNT];
+
+	// Initialize to defaults
+	void Clear() {
+		for (int i = 0; i < 3; i++) {
+			copies[i] = (i == 0) ? REPTALL_COUNT_DFLT : 1;
+			anchor[i] = 0.0;
+			position[i] = 0.0;
+			rotation[i] = 0.0;
+			step_position[i] = (i == 0) ? REPTALL_TRANSLATE_DFLT : 0.0;
+			step_rotation[i] = 0.0;
+		}
+		scale = 100.0;
+		step_scale = 100.0;
+		offset = 0.0;
+		opacity_start = 100.0;
+		opacity_end = 100.0;
+		camera_aware = TRUE;
+		composite_mode = 0;  // Normal blend
+		front_to_back = REPTALL_FRONT_TO_BACK_DFLT;
+		draft = FALSE;
+		random_seed = 0;
+		random_strength = 100.0;
+		random_distribution = RANDOM_DISTRIBUTION_CENTERED;
+		spatial_field.Clear();
+		index_field.Clear();
+		field_combine = FIELD_COMBINE_MULTIPLY;
+		for (A_long e = 0; e < REPTALL_EFFECTOR_COUNT; e++) {
+			effector[e].Clear(e);
+		}
+	}
+};
+
+// Copy transforms at both ends of the shutter interval, for motion blur
+// open and close are phase 2 results for the same grid as the rendered
+// copies (their draw order is not used). Copies are blurred along the
+// interpolation between the two.
+struct CopyMotion {
+	const CopyInstanceBuffer	*open;
+	const CopyInstanceBuffer	*close;
+};
+
+// Active 3D camera as seen by the copy transforms
+// Everything phase 2 reads from the host, so a ReptAllState plus a
+// CopyCamera fully determine the resulting transforms.
+struct CopyCamera {
+	A_Boolean	has_camera;       // an active comp camera was found
+	A_Matrix4	matrix;           // camera layer-to-world transform
+	A_FpLong	focal_length;     // camera zoom (pixels)
+	A_FpLong	layer_center[2];  // layer center in world x/y (projection center)
+
+	// Initialize to "no camera"
+	void Clear() {
+		has_camera = FALSE;
+		for (int r = 0; r < 4; r++) {
+			for (int c = 0; c < 4; c++) {
+				matrix.mat[r][c] = 0.0;
+			}
+		}
+		focal_length = 0.0;
+		layer_center[0] = 0.0;
+		layer_center[1] = 0.0;
+	}
+};
+
+// Placement of the source and output buffers in layer coordinates
+// PF_Cmd_RENDER hands us full-layer buffers (all origins zero); SmartFX
+// hands us buffers covering only the requested/sampled sub-rectangles.
+struct RenderGeometry {
+	PF_FpLong	center[2];            // rotation/scale center (layer space)
+	A_long		layer_size[2];        // full layer width, height
+	A_long		src_origin[2];        // layer position of source pixel (0,0)
+	A_long		dst_origin[2];        // layer position of output pixel (0,0)
+	PF_FpLong	downsample[2];        // buffer pixels per full-resolution pixel
+
+	// Everything above is in buffer pixels. Copy transforms are in
+	// full-resolution pixels and are scaled by downsample when rendered.
+
+	// Initialize for a full-layer, full-resolution render of a
+	// srcWidth x srcHeight layer
+	void Clear(A_long srcWidth, A_long srcHeight) {
+		center[0] = srcWidth / 2.0;
+		center[1] = srcHeight / 2.0;
+		layer_size[0] = srcWidth;
+		layer_size[1] = srcHeight;
+		for (int i = 0; i < 2; i++) {
+			src_origin[i] = 0;
+			dst_origin[i] = 0;
+			downsample[i] = 1.0;
+		}
+	}
+};
+
+// Empty when it covers no pixel
+inline PF_Boolean
+IsRectEmpty(const PF_LRect& r)
+{
+	return (r.left >= r.right || r.top >= r.bottom);
+}
+
+// Grow dst to cover src (empty rects add nothing)
+inline void
+UnionRect(const PF_LRect& src, PF_LRect *dst)
+{
+	if (IsRectEmpty(src)) return;
+	if (IsRectEmpty(*dst)) {
+		*dst = src;
+		return;
+	}
+	dst->left   = MIN(dst->left, src.left);
+	dst->top    = MIN(dst->top, src.top);
+	dst->right  = MAX(dst->right, src.right);
+	dst->bottom = MAX(dst->bottom, src.bottom);
+}
+
+// Clip dst to src (all zero when they do not overlap)
+inline void
+IntersectRect(const PF_LRect& src, PF_LRect *dst)
+{
+	dst->left   = MAX(dst->left, src.left);
+	dst->top    = MAX(dst->top, src.top);
+	dst->right  = MIN(dst->right, src.right);
+	dst->bottom = MIN(dst->bottom, src.bottom);
+	if (IsRectEmpty(*dst)) {
+		dst->left = dst->top = dst->right = dst->bottom = 0;
+	}
+}
+
+// Services the render core takes from its host
+// Any member may be NULL: the core then renders on the calling thread,
+// never cancels, scans the source alpha on every render and keeps no stats.
+typedef PF_Err (*RenderWorkerFunc)(
+	void	*refcon,
+	A_long	thread_index,
+	A_long	i,
+	A_long	iterations);
+
+struct RenderHost {
+	void	*refcon;
+
+	// Run worker once on each of the host's render threads and return when
+	// all have finished (iterate_generic with PF_Iterations_ONCE_PER_PROCESSOR)
+	PF_Err	(*iterate)(void *refcon, void *workerRefcon, RenderWorkerFunc worker);
+
+	// PF_Interrupt_CANCEL once the user has cancelled the render
+	PF_Err	(*abort)(void *refcon);
+
+	// Alpha coverage of the source buffer, e.g. cached while the host reports
+	// the source unchanged; depth is 8, 16 or 32 bits per channel
+	PF_Err	(*acquire_coverage)(
+		void					*refcon,
+		const PF_EffectWorld	*srcP,
+		A_long					depth,
+		SourceCoverageRef		*coverage);
+
+	// Receives the phase 4 time and the copy and pixel counters; with no
+	// instances, copiesComputed is left as the host set it
+	RenderStats	*stats;
+};
+
+// ============================================================================
+// Render phases
+// ============================================================================
+// Thread safety (Multi-Frame Rendering): every phase is reentrant. Phases read
+// only their arguments, write only caller-owned memory, and share no sequence
+// data, so AE may run any number of frames concurrently. The globals, the
+// sorted-transform cache (ReptAll_TransformCache.h), the source coverage
+// cache (ReptAll_Source.h) and the instance arena pool
+// (ReptAll_Instances.h), are mutex-guarded; see GlobalSetup for the full
+// list.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Phase 2: Compute transform for each copy (handles stepping)
+	// Each copy is a plane in 3D (X/Y/Z rotation, scale, position) seen
+	// through the camera, reduced to one homography. Without a camera the
+	// view is orthographic and Z only affects the draw order.
+	// Sets instances->count and an identity draw order.
+	PF_Err ComputeCopyTransforms(
+		const ReptAllState	*state,
+		const CopyCamera	*camera,
+		CopyInstanceBuffer	*instances);
+
+	// Phase 3: Sort copies by camera depth for proper Z-order
+	// Permutes instances->order only; the per-copy arrays stay in place.
+	// Copies at equal depth keep their grid order, so coplanar copies never
+	// swap between frames. orderHint (may be NULL) is an earlier order of
+	// the same number of copies, repaired instead of sorting from scratch
+	// when it is nearly right. Without cameraAware the grid order is kept.
+	PF_Err SortCopiesByDepth(
+		CopyInstanceBuffer	*instances,
+		PF_Boolean			cameraAware,
+		const A_u_long		*orderHint);
+
+	// Layer-space rects of a render of a full layer (geometry origins zero)
+	// maxRect bounds every visible copy, resultRect is its part inside
+	// requestRect and sourceRect the part of the layer the copies sample to
+	// fill resultRect, snapped to the texel grid of the deepest mip level
+	// they use. All are clipped to the layer. motion (NULL for none) widens
+	// them to the copies' paths over the shutter.
+	PF_Err ComputeRenderBounds(
+		const CopyInstanceBuffer	*instances,
+		const CopyMotion			*motion,
+		const RenderGeometry		*geometry,
+		const PF_LRect				*requestRect,
+		PF_LRect					*maxRect,
+		PF_LRect					*resultRect,
+		PF_LRect					*sourceRect);
+
+	// Phase 4: Render each copy with bilinear sampling (nearest-neighbor
+	// when state->draft)
+	// Clears output, then composites the copies. Output row bands are spread
+	// over the host's render threads; the result does not depend on the
+	// thread count. depth is 8, 16 or 32 (float) bits per channel of both
+	// buffers. With motion, copies that move are averaged over samples
+	// spread across the shutter, as many as their fastest corner needs;
+	// still copies cost one sample.
+	PF_Err RenderCopies(
+		const RenderHost	*host,
+		const ReptAllState	*state,
+		const CopyInstanceBuffer	*instances,     // NULL renders no copies
+		const CopyMotion	*motion,                // NULL for no motion blur
+		const RenderGeometry	*geometry,
+		A_long			depth,
+		PF_EffectWorld	*srcP,
+		PF_EffectWorld	*output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REPTALL_CORE_H
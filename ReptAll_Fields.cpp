@@ -0,0 +1,333 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*	ReptAll_Fields.cpp
+
+	Field weight kernels.
+
+	Shape, curve and combine mode are the same for every copy of a batch,
+	so the kernels branch on them once per group of lanes and evaluate the
+	weights with min/max instead of per-copy branches. Every kernel
+	evaluates the same single-precision expressions in the same order as
+	the scalar reference, and the file is built with -ffp-contract=off
+	(/fp:precise on MSVC) so no multiply-add is fused: they agree bit for
+	bit. SSE2 is part of the x64 baseline and NEON of ARMv8-A; neither
+	needs a CPU check.
+*/
+
+#include "ReptAll_Fields.h"
+#include "ReptAll_Sampling.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	#define REPTALL_SIMD_X86 1
+	#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	#define REPTALL_SIMD_NEON 1
+	#include <arm_neon.h>
+#endif
+
+void
+PrepareFieldProgram(
+	const SpatialField&	spatial,
+	const IndexField&	index,
+	A_long				combine,
+	A_long				count,
+	FieldProgram		*program)
+{
+	program->shape = (spatial.shape == FIELD_SHAPE_BOX || spatial.shape == FIELD_SHAPE_SPHERE)
+					 ? spatial.shape : FIELD_SHAPE_NONE;
+	for (int i = 0; i < 3; i++) {
+		const PF_FpLong size = std::isfinite(spatial.size[i]) ? fabs(spatial.size[i]) : 0.0;
+		program->center[i] = std::isfinite(spatial.center[i]) ? (float)spatial.center[i] : 0.0f;
+		program->invHalfSize[i] = (float)(2.0 / std::max(size, FIELD_MIN_SIZE));
+	}
+	program->spatialCurve = spatial.curve;
+	program->invert = spatial.invert ? TRUE : FALSE;
+
+	program->indexType = (index.type == FIELD_INDEX_RANGE) ? FIELD_INDEX_RANGE : FIELD_INDEX_NONE;
+	program->indexStep = (count > 1) ? (float)(1.0 / (count - 1)) : 0.0f;
+	const PF_FpLong start = std::isfinite(index.start) ? index.start / 100.0 : 0.0;
+	const PF_FpLong end = std::isfinite(index.end) ? index.end / 100.0 : 1.0;
+	program->indexStart = (float)start;
+	// An empty range is a step at start
+	program->indexScale = (fabs(end - start) > 1.0e-6) ? (float)(1.0 / (end - start)) : 1.0e6f;
+	program->indexCurve = index.curve;
+
+	program->combine = (combine == FIELD_COMBINE_MIN || combine == FIELD_COMBINE_MAX)
+					   ? combine : FIELD_COMBINE_MULTIPLY;
+	program->active = program->shape != FIELD_SHAPE_NONE || program->indexType != FIELD_INDEX_NONE;
+}
+
+// ============================================================================
+// Scalar reference kernel
+// ============================================================================
+
+static inline float
+ApplyFieldCurve(
+	float	t,
+	A_long	curve)
+{
+	t = std::min(std::max(t, 0.0f), 1.0f);
+	if (curve == FIELD_CURVE_EASE_IN_OUT) {
+		t = (t * t) * (3.0f - 2.0f * t);
+	}
+	return t;
+}
+
+static void
+EvaluateFieldBatchScalar(
+	const FieldProgram&	program,
+	const float			*x,
+	const float			*y,
+	const float			*z,
+	A_long				first,
+	A_long				count,
+	float				*weight)
+{
+	for (A_long i = 0; i < count; i++) {
+		float spatial = 1.0f;
+		if (program.shape != FIELD_SHAPE_NONE) {
+			const float dx = fabsf(x[i] - program.center[0]) * program.invHalfSize[0];
+			const float dy = fabsf(y[i] - program.center[1]) * program.invHalfSize[1];
+			const float dz = fabsf(z[i] - program.center[2]) * program.invHalfSize[2];
+			const float d = (program.shape == FIELD_SHAPE_BOX)
+							? std::max(std::max(dx, dy), dz)
+							: sqrtf((dx * dx + dy * dy) + dz * dz);
+			spatial = ApplyFieldCurve(1.0f - d, program.spatialCurve);
+			if (program.invert) {
+				spatial = 1.0f - spatial;
+			}
+		}
+
+		float index = 1.0f;
+		if (program.indexType != FIELD_INDEX_NONE) {
+			const float f = (float)(first + i) * program.indexStep;
+			index = ApplyFieldCurve((f - program.indexStart) * program.indexScale, program.indexCurve);
+		}
+
+		if (program.shape == FIELD_SHAPE_NONE || program.indexType == FIELD_INDEX_NONE ||
+			program.combine == FIELD_COMBINE_MULTIPLY) {
+			weight[i] = spatial * index;
+		} else if (program.combine == FIELD_COMBINE_MIN) {
+			weight[i] = std::min(spatial, index);
+		} else {
+			weight[i] = std::max(spatial, index);
+		}
+	}
+}
+
+#ifdef REPTALL_SIMD_X86
+
+// ============================================================================
+// SSE2 kernel - 4 copies per iteration
+// ============================================================================
+
+static inline __m128
+ApplyFieldCurve_SSE2(
+	__m128	t,
+	A_long	curve)
+{
+	t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	if (curve == FIELD_CURVE_EASE_IN_OUT) {
+		t = _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), t)));
+	}
+	return t;
+}
+
+static void
+EvaluateFieldBatch_SSE2(
+	const FieldProgram&	program,
+	const float			*x,
+	const float			*y,
+	const float			*z,
+	A_long				first,
+	A_long				count,
+	float				*weight)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 center[3] = {_mm_set1_ps(program.center[0]), _mm_set1_ps(program.center[1]),
+							  _mm_set1_ps(program.center[2])};
+	const __m128 invHalf[3] = {_mm_set1_ps(program.invHalfSize[0]), _mm_set1_ps(program.invHalfSize[1]),
+							   _mm_set1_ps(program.invHalfSize[2])};
+	const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+	const PF_Boolean combined = program.shape != FIELD_SHAPE_NONE && program.indexType != FIELD_INDEX_NONE;
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 spatial = one;
+		if (program.shape != FIELD_SHAPE_NONE) {
+			const __m128 dx = _mm_mul_ps(_mm_and_ps(_mm_sub_ps(_mm_loadu_ps(x + i), center[0]), absMask), invHalf[0]);
+			const __m128 dy = _mm_mul_ps(_mm_and_ps(_mm_sub_ps(_mm_loadu_ps(y + i), center[1]), absMask), invHalf[1]);
+			const __m128 dz = _mm_mul_ps(_mm_and_ps(_mm_sub_ps(_mm_loadu_ps(z + i), center[2]), absMask), invHalf[2]);
+			const __m128 d = (program.shape == FIELD_SHAPE_BOX)
+							 ? _mm_max_ps(_mm_max_ps(dx, dy), dz)
+							 : _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+													  _mm_mul_ps(dz, dz)));
+			spatial = ApplyFieldCurve_SSE2(_mm_sub_ps(one, d), program.spatialCurve);
+			if (program.invert) {
+				spatial = _mm_sub_ps(one, spatial);
+			}
+		}
+
+		__m128 index = one;
+		if (program.indexType != FIELD_INDEX_NONE) {
+			const __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + i), lanes)),
+										_mm_set1_ps(program.indexStep));
+			index = ApplyFieldCurve_SSE2(_mm_mul_ps(_mm_sub_ps(f, _mm_set1_ps(program.indexStart)),
+													_mm_set1_ps(program.indexScale)),
+										 program.indexCurve);
+		}
+
+		__m128 w;
+		if (!combined || program.combine == FIELD_COMBINE_MULTIPLY) {
+			w = _mm_mul_ps(spatial, index);
+		} else if (program.combine == FIELD_COMBINE_MIN) {
+			w = _mm_min_ps(spatial, index);
+		} else {
+			w = _mm_max_ps(spatial, index);
+		}
+		_mm_storeu_ps(weight + i, w);
+	}
+
+	if (i < count) {
+		EvaluateFieldBatchScalar(program, x + i, y + i, z + i, first + i, count - i, weight + i);
+	}
+}
+
+#endif // REPTALL_SIMD_X86
+
+#ifdef REPTALL_SIMD_NEON
+
+// ============================================================================
+// NEON kernel - 4 copies per iteration
+// ============================================================================
+
+static inline float32x4_t
+ApplyFieldCurve_NEON(
+	float32x4_t	t,
+	A_long		curve)
+{
+	t = vminq_f32(vmaxq_f32(t, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+	if (curve == FIELD_CURVE_EASE_IN_OUT) {
+		// vmulq/vsubq rather than vmlsq so no fused operation is formed
+		t = vmulq_f32(vmulq_f32(t, t), vsubq_f32(vdupq_n_f32(3.0f), vmulq_f32(vdupq_n_f32(2.0f), t)));
+	}
+	return t;
+}
+
+static void
+EvaluateFieldBatch_NEON(
+	const FieldProgram&	program,
+	const float			*x,
+	const float			*y,
+	const float			*z,
+	A_long				first,
+	A_long				count,
+	float				*weight)
+{
+	static const int32_t kLanes[4] = {0, 1, 2, 3};
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const int32x4_t lanes = vld1q_s32(kLanes);
+	const PF_Boolean combined = program.shape != FIELD_SHAPE_NONE && program.indexType != FIELD_INDEX_NONE;
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t spatial = one;
+		if (program.shape != FIELD_SHAPE_NONE) {
+			const float32x4_t dx = vmulq_n_f32(vabsq_f32(vsubq_f32(vld1q_f32(x + i), vdupq_n_f32(program.center[0]))),
+											   program.invHalfSize[0]);
+			const float32x4_t dy = vmulq_n_f32(vabsq_f32(vsubq_f32(vld1q_f32(y + i), vdupq_n_f32(program.center[1]))),
+											   program.invHalfSize[1]);
+			const float32x4_t dz = vmulq_n_f32(vabsq_f32(vsubq_f32(vld1q_f32(z + i), vdupq_n_f32(program.center[2]))),
+											   program.invHalfSize[2]);
+			const float32x4_t d = (program.shape == FIELD_SHAPE_BOX)
+								  ? vmaxq_f32(vmaxq_f32(dx, dy), dz)
+								  : vsqrtq_f32(vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)),
+														 vmulq_f32(dz, dz)));
+			spatial = ApplyFieldCurve_NEON(vsubq_f32(one, d), program.spatialCurve);
+			if (program.invert) {
+				spatial = vsubq_f32(one, spatial);
+			}
+		}
+
+		float32x4_t index = one;
+		if (program.indexType != FIELD_INDEX_NONE) {
+			const float32x4_t f = vmulq_n_f32(vcvtq_f32_s32(vaddq_s32(vdupq_n_s32(first + i), lanes)),
+											  program.indexStep);
+			index = ApplyFieldCurve_NEON(vmulq_n_f32(vsubq_f32(f, vdupq_n_f32(program.indexStart)),
+													 program.indexScale),
+										 program.indexCurve);
+		}
+
+		float32x4_t w;
+		if (!combined || program.combine == FIELD_COMBINE_MULTIPLY) {
+			w = vmulq_f32(spatial, index);
+		} else if (program.combine == FIELD_COMBINE_MIN) {
+			w = vminq_f32(spatial, index);
+		} else {
+			w = vmaxq_f32(spatial, index);
+		}
+		vst1q_f32(weight + i, w);
+	}
+
+	if (i < count) {
+		EvaluateFieldBatchScalar(program, x + i, y + i, z + i, first + i, count - i, weight + i);
+	}
+}
+
+#endif // REPTALL_SIMD_NEON
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+static FieldBatchFunc
+SelectFieldBatchKernel(void)
+{
+	if (GetSampleKernels()->level == SAMPLE_KERNEL_SCALAR) {
+		return EvaluateFieldBatchScalar;
+	}
+
+#if defined(REPTALL_SIMD_X86)
+	return EvaluateFieldBatch_SSE2;
+#elif defined(REPTALL_SIMD_NEON)
+	return EvaluateFieldBatch_NEON;
+#else
+	return EvaluateFieldBatchScalar;
+#endif
+}
+
+FieldBatchFunc
+GetFieldBatchKernel(void)
+{
+	// Thread-safe one-time initialization (C++11 magic statics)
+	static const FieldBatchFunc kernel = SelectFieldBatchKernel();
+	return kernel;
+}
+
+FieldBatchFunc
+GetScalarFieldBatchKernel(void)
+{
+	return EvaluateFieldBatchScalar;
+}
@@ -0,0 +1,152 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*
+	ReptAll_Fields.h
+
+	Fields of the Random group: where the effectors act. The spatial field
+	weighs copies by their stepped position, the index field by their place
+	in the copy sequence, and the combined weight in [0, 1] scales every
+	effector's offsets. Weights are evaluated over structure-of-arrays
+	batches of copies with branch-free SIMD kernels (SSE2, NEON).
+*/
+
+#ifndef REPTALL_FIELDS_H
+#define REPTALL_FIELDS_H
+
+#include "ReptAll_Types.h"
+
+// Largest number of copies handed to a field kernel in one call
+#define FIELD_BATCH_MAX		64
+
+// Extents below this many pixels are treated as this size
+#define FIELD_MIN_SIZE		0.001
+
+enum FieldShape {
+	FIELD_SHAPE_NONE = 0,
+	FIELD_SHAPE_BOX,
+	FIELD_SHAPE_SPHERE
+};
+
+enum FieldIndexType {
+	FIELD_INDEX_NONE = 0,
+	FIELD_INDEX_RANGE
+};
+
+// Falloff from the field's edge (0) to its full weight (1)
+enum FieldCurve {
+	FIELD_CURVE_LINEAR = 0,
+	FIELD_CURVE_EASE_IN_OUT         // smoothstep
+};
+
+// How the spatial and index weights combine when both fields are on
+enum FieldCombine {
+	FIELD_COMBINE_MULTIPLY = 0,
+	FIELD_COMBINE_MIN,
+	FIELD_COMBINE_MAX
+};
+
+// Box or sphere (ellipsoid) around center: weight 1 at the center falling to
+// 0 at the surface of the size[0] x size[1] x size[2] shape
+struct SpatialField {
+	A_long		shape;            // FieldShape
+	PF_FpLong	center[3];        // position of the stepped copies
+	PF_FpLong	size[3];          // full extents
+	A_long		curve;            // FieldCurve
+	A_Boolean	invert;           // weight 1 outside, 0 at the center
+
+	void Clear() {
+		shape = FIELD_SHAPE_NONE;
+		for (int i = 0; i < 3; i++) {
+			center[i] = 0.0;
+			size[i] = 2000.0;
+		}
+		curve = FIELD_CURVE_EASE_IN_OUT;
+		invert = FALSE;
+	}
+};
+
+// Ramp over the copy sequence: weight 0 up to start, 1 from end on
+// (percent of the way from the first to the last copy; start > end ramps
+// down)
+struct IndexField {
+	A_long		type;             // FieldIndexType
+	PF_FpLong	start;            // percent
+	PF_FpLong	end;              // percent
+	A_long		curve;            // FieldCurve
+
+	void Clear() {
+		type = FIELD_INDEX_NONE;
+		start = 0.0;
+		end = 100.0;
+		curve = FIELD_CURVE_EASE_IN_OUT;
+	}
+};
+
+// Fields resolved for the kernels, in single precision
+// Both shapes reduce to a normalized distance d (box: largest axis, sphere:
+// Euclidean) of the copy scaled by invHalfSize; the spatial weight is the
+// curve of 1 - d. The index weight is the curve of
+// (index * indexStep - indexStart) * indexScale, both clamped to [0, 1].
+struct FieldProgram {
+	PF_Boolean	active;           // a field is on; weights are 1 otherwise
+	A_long		shape;
+	float		center[3];
+	float		invHalfSize[3];
+	A_long		spatialCurve;
+	PF_Boolean	invert;
+	A_long		indexType;
+	float		indexStep;        // index to fraction of the sequence
+	float		indexStart;
+	float		indexScale;
+	A_long		indexCurve;
+	A_long		combine;
+};
+
+// Resolve the fields for count copies
+void
+PrepareFieldProgram(
+	const SpatialField&	spatial,
+	const IndexField&	index,
+	A_long				combine,
+	A_long				count,
+	FieldProgram		*program);
+
+// Weights of the copies first .. first + count - 1 (count <= FIELD_BATCH_MAX)
+// at stepped positions (x[i], y[i], z[i])
+typedef void (*FieldBatchFunc)(
+	const FieldProgram&	program,
+	const float			*x,
+	const float			*y,
+	const float			*z,
+	A_long				first,
+	A_long				count,
+	float				*weight);
+
+// SIMD kernel unless the sampling kernels run scalar (REPTALL_FORCE_SCALAR)
+FieldBatchFunc
+GetFieldBatchKernel(void);
+
+// Scalar reference kernel, always available
+FieldBatchFunc
+GetScalarFieldBatchKernel(void);
+
+#endif // REPTALL_FIELDS_H
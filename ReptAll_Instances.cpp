@@ -0,0 +1,213 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*	ReptAll_Instances.cpp
+
+	Pooled arenas backing CopyInstanceBuffer.
+*/
+
+#include "ReptAll_Instances.h"
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+// Every array starts on its own cache line
+const size_t	kArenaAlign = 64;
+
+// Capacities are whole cache lines of floats, so arrays stay aligned
+const A_long	kCapacityGranule = (A_long)(kArenaAlign / sizeof(float));
+
+// float arrays: position x/y/z, depth, opacity, footprint, homography (9)
+const size_t	kFloatsPerCopy = 15;
+
+std::mutex							g_poolMutex;
+std::vector<CopyInstanceBuffer*>	g_pool;
+size_t								g_poolBytes = 0;
+
+size_t
+AlignUp(size_t bytes)
+{
+	return (bytes + kArenaAlign - 1) & ~(kArenaAlign - 1);
+}
+
+A_long
+RoundCapacity(A_long capacity)
+{
+	if (capacity < 1) {
+		capacity = 1;
+	}
+	return (capacity + kCapacityGranule - 1) / kCapacityGranule * kCapacityGranule;
+}
+
+// Places the header at the start of the arena and carves the arrays after it
+CopyInstanceBuffer*
+CarveArena(
+	void	*arena,
+	A_long	capacity)
+{
+	char *block = (char*)AlignUp((size_t)(std::uintptr_t)arena);
+	CopyInstanceBuffer *buffer = new (block) CopyInstanceBuffer;
+
+	const size_t n = (size_t)capacity;
+	char *next = block + AlignUp(sizeof(CopyInstanceBuffer));
+
+	for (int i = 0; i < 3; i++) {
+		buffer->position[i] = (float*)next;
+		next += n * sizeof(float);
+	}
+	buffer->depth = (float*)next;
+	next += n * sizeof(float);
+	buffer->opacity = (float*)next;
+	next += n * sizeof(float);
+	buffer->footprint = (float*)next;
+	next += n * sizeof(float);
+	buffer->homography = (float*)next;
+	next += 9 * n * sizeof(float);
+	buffer->order = (A_u_long*)next;
+	next += n * sizeof(A_u_long);
+	buffer->visible = (A_u_long*)next;
+
+	buffer->count = 0;
+	buffer->capacity = capacity;
+	buffer->arena = arena;
+
+	return buffer;
+}
+
+// shared_ptr deleter: keep the arena for the next render if the pool has room
+void
+ReleaseArena(CopyInstanceBuffer *buffer)
+{
+	if (!buffer) {
+		return;
+	}
+
+	const size_t bytes = GetCopyInstanceArenaBytes(buffer->capacity);
+	{
+		std::lock_guard<std::mutex> lock(g_poolMutex);
+		if (g_pool.size() < INSTANCE_ARENA_POOL_SIZE &&
+			g_poolBytes + bytes <= INSTANCE_ARENA_POOL_BYTES) {
+			try {
+				g_pool.push_back(buffer);
+				g_poolBytes += bytes;
+				return;
+			} catch (const std::bad_alloc&) {
+				// fall through and free it
+			}
+		}
+	}
+
+	std::free(buffer->arena);
+}
+
+// Smallest pooled arena that fits, ignoring ones far larger than needed so a
+// small render does not pin the arena a large one will want back
+CopyInstanceBuffer*
+TakePooledArena(A_long capacity)
+{
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+
+	size_t best = g_pool.size();
+	for (size_t i = 0; i < g_pool.size(); i++) {
+		A_long pooled = g_pool[i]->capacity;
+		if (pooled >= capacity && pooled / 4 <= capacity &&
+			(best == g_pool.size() || pooled < g_pool[best]->capacity)) {
+			best = i;
+		}
+	}
+
+	if (best == g_pool.size()) {
+		return NULL;
+	}
+
+	CopyInstanceBuffer *buffer = g_pool[best];
+	g_pool[best] = g_pool.back();
+	g_pool.pop_back();
+	g_poolBytes -= GetCopyInstanceArenaBytes(buffer->capacity);
+
+	return buffer;
+}
+
+} // namespace
+
+size_t
+GetCopyInstanceArenaBytes(A_long capacity)
+{
+	const size_t n = (size_t)RoundCapacity(capacity);
+	const size_t visibleWords = (n + 31) / 32;
+
+	return AlignUp(sizeof(CopyInstanceBuffer)) +
+		   kFloatsPerCopy * n * sizeof(float) +
+		   n * sizeof(A_u_long) +
+		   AlignUp(visibleWords * sizeof(A_u_long));
+}
+
+PF_Err
+AcquireCopyInstances(
+	A_long									capacity,
+	std::shared_ptr<CopyInstanceBuffer>		*instances)
+{
+	if (!instances || capacity < 0) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	capacity = RoundCapacity(capacity);
+
+	CopyInstanceBuffer *buffer = TakePooledArena(capacity);
+	if (buffer) {
+		buffer->count = 0;
+	} else {
+		// Extra alignment slack; the header records the raw pointer
+		void *arena = std::malloc(GetCopyInstanceArenaBytes(capacity) + kArenaAlign);
+		if (!arena) {
+			return PF_Err_OUT_OF_MEMORY;
+		}
+		buffer = CarveArena(arena, capacity);
+	}
+
+	try {
+		instances->reset(buffer, ReleaseArena);
+	} catch (const std::bad_alloc&) {
+		// reset() already ran the deleter on buffer
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	return PF_Err_NONE;
+}
+
+void
+ReleaseCopyInstancePool(void)
+{
+	std::vector<CopyInstanceBuffer*> pool;
+	{
+		std::lock_guard<std::mutex> lock(g_poolMutex);
+		pool.swap(g_pool);
+		g_poolBytes = 0;
+	}
+
+	for (CopyInstanceBuffer *buffer : pool) {
+		std::free(buffer->arena);
+	}
+}
@@ -0,0 +1,59 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*
+	ReptAll_Instances.h
+
+	Allocation of the per-render copy instance store (CopyInstanceBuffer).
+*/
+
+#ifndef REPTALL_INSTANCES_H
+#define REPTALL_INSTANCES_H
+
+#include "ReptAll_Core.h"
+#include <memory>
+
+// Arenas kept for reuse once no render or cache entry references them
+#define INSTANCE_ARENA_POOL_SIZE		8
+#define INSTANCE_ARENA_POOL_BYTES		(64 * 1024 * 1024)
+
+// Immutable, shareable result of phases 2-3
+typedef std::shared_ptr<const CopyInstanceBuffer> CopyInstanceList;
+
+// Returns an empty buffer (count 0) able to hold capacity copies
+// The header and every array live in one 64-byte aligned arena. When the
+// last reference is dropped the arena goes back to a small pool and is
+// handed to the next render that fits in it, so steady playback does not
+// allocate. Thread-safe.
+PF_Err
+AcquireCopyInstances(
+	A_long									capacity,
+	std::shared_ptr<CopyInstanceBuffer>		*instances);
+
+// Bytes of one arena holding capacity copies
+size_t
+GetCopyInstanceArenaBytes(A_long capacity);
+
+// Frees every pooled arena (arenas still referenced are freed on release)
+void
+ReleaseCopyInstancePool(void);
+
+#endif // REPTALL_INSTANCES_H
@@ -0,0 +1,303 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*	ReptAll_Random.cpp
+
+	Philox4x32-10 batch kernels.
+
+	Each SIMD lane runs the rounds of one counter, so a loop iteration
+	produces the four words of 4 (SSE4.1, NEON) or 8 (AVX2) consecutive
+	copy indices. Philox is integer arithmetic only: every kernel returns
+	exactly the words of the scalar GenerateRandomWords.
+*/
+
+#include "ReptAll_Random.h"
+#include "ReptAll_Sampling.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	#define REPTALL_SIMD_X86 1
+	#include <immintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	#define REPTALL_SIMD_NEON 1
+	#include <arm_neon.h>
+#endif
+
+// GCC/Clang only emit SSE4.1/AVX2 instructions inside functions that ask
+// for them; MSVC accepts the intrinsics anywhere
+#if defined(REPTALL_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+	#define REPTALL_TARGET_SSE41	__attribute__((target("sse4.1")))
+	#define REPTALL_TARGET_AVX2		__attribute__((target("avx2")))
+#else
+	#define REPTALL_TARGET_SSE41
+	#define REPTALL_TARGET_AVX2
+#endif
+
+// ============================================================================
+// Scalar reference kernel
+// ============================================================================
+
+static void
+GenerateRandomBatchScalar(
+	const RandomKey&	key,
+	A_u_long			first,
+	A_long				count,
+	A_u_long			block,
+	A_u_long			out[RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX])
+{
+	for (A_long i = 0; i < count; i++) {
+		A_u_long words[RANDOM_BLOCK_WORDS];
+		GenerateRandomWords(key, first + (A_u_long)i, block, words);
+		for (int w = 0; w < RANDOM_BLOCK_WORDS; w++) {
+			out[w][i] = words[w];
+		}
+	}
+}
+
+#ifdef REPTALL_SIMD_X86
+
+// ============================================================================
+// SSE4.1 / AVX2 kernels
+// ============================================================================
+
+// High and low halves of a * m per 32-bit lane; _mm_mul_epu32 only
+// multiplies the even lanes, so the odd ones are shifted down first
+REPTALL_TARGET_SSE41 static inline void
+MulHiLo_SSE41(
+	__m128i		a,
+	__m128i		m,
+	__m128i		*hi,
+	__m128i		*lo)
+{
+	const __m128i even = _mm_mul_epu32(a, m);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+	*lo = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+	*hi = _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0xCC);
+}
+
+REPTALL_TARGET_SSE41 static void
+GenerateRandomBatch_SSE41(
+	const RandomKey&	key,
+	A_u_long			first,
+	A_long				count,
+	A_u_long			block,
+	A_u_long			out[RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX])
+{
+	const __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+	const __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+	const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i c0 = _mm_add_epi32(_mm_set1_epi32((int)(first + (A_u_long)i)), lanes);
+		__m128i c1 = _mm_set1_epi32((int)block);
+		__m128i c2 = _mm_setzero_si128();
+		__m128i c3 = _mm_setzero_si128();
+		A_u_long k0 = key.seed, k1 = key.stream;
+
+		for (int r = 0; r < PHILOX_ROUNDS; r++) {
+			__m128i hi0, lo0, hi1, lo1;
+			MulHiLo_SSE41(c0, m0, &hi0, &lo0);
+			MulHiLo_SSE41(c2, m1, &hi1, &lo1);
+			c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int)k0));
+			c1 = lo1;
+			c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int)k1));
+			c3 = lo0;
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+
+		_mm_storeu_si128((__m128i*)&out[0][i], c0);
+		_mm_storeu_si128((__m128i*)&out[1][i], c1);
+		_mm_storeu_si128((__m128i*)&out[2][i], c2);
+		_mm_storeu_si128((__m128i*)&out[3][i], c3);
+	}
+
+	for (; i < count; i++) {
+		A_u_long words[RANDOM_BLOCK_WORDS];
+		GenerateRandomWords(key, first + (A_u_long)i, block, words);
+		for (int w = 0; w < RANDOM_BLOCK_WORDS; w++) {
+			out[w][i] = words[w];
+		}
+	}
+}
+
+REPTALL_TARGET_AVX2 static inline void
+MulHiLo_AVX2(
+	__m256i		a,
+	__m256i		m,
+	__m256i		*hi,
+	__m256i		*lo)
+{
+	const __m256i even = _mm256_mul_epu32(a, m);
+	const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+	*lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+	*hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+REPTALL_TARGET_AVX2 static void
+GenerateRandomBatch_AVX2(
+	const RandomKey&	key,
+	A_u_long			first,
+	A_long				count,
+	A_u_long			block,
+	A_u_long			out[RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX])
+{
+	const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+	const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	A_long i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int)(first + (A_u_long)i)), lanes);
+		__m256i c1 = _mm256_set1_epi32((int)block);
+		__m256i c2 = _mm256_setzero_si256();
+		__m256i c3 = _mm256_setzero_si256();
+		A_u_long k0 = key.seed, k1 = key.stream;
+
+		for (int r = 0; r < PHILOX_ROUNDS; r++) {
+			__m256i hi0, lo0, hi1, lo1;
+			MulHiLo_AVX2(c0, m0, &hi0, &lo0);
+			MulHiLo_AVX2(c2, m1, &hi1, &lo1);
+			c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+			c1 = lo1;
+			c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+			c3 = lo0;
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+
+		_mm256_storeu_si256((__m256i*)&out[0][i], c0);
+		_mm256_storeu_si256((__m256i*)&out[1][i], c1);
+		_mm256_storeu_si256((__m256i*)&out[2][i], c2);
+		_mm256_storeu_si256((__m256i*)&out[3][i], c3);
+	}
+
+	for (; i < count; i++) {
+		A_u_long words[RANDOM_BLOCK_WORDS];
+		GenerateRandomWords(key, first + (A_u_long)i, block, words);
+		for (int w = 0; w < RANDOM_BLOCK_WORDS; w++) {
+			out[w][i] = words[w];
+		}
+	}
+}
+
+#endif // REPTALL_SIMD_X86
+
+#ifdef REPTALL_SIMD_NEON
+
+// ============================================================================
+// NEON kernel
+// ============================================================================
+
+static inline void
+MulHiLo_NEON(
+	uint32x4_t	a,
+	uint32_t	m,
+	uint32x4_t	*hi,
+	uint32x4_t	*lo)
+{
+	const uint64x2_t pl = vmull_n_u32(vget_low_u32(a), m);
+	const uint64x2_t ph = vmull_n_u32(vget_high_u32(a), m);
+	*lo = vcombine_u32(vmovn_u64(pl), vmovn_u64(ph));
+	*hi = vcombine_u32(vshrn_n_u64(pl, 32), vshrn_n_u64(ph, 32));
+}
+
+static void
+GenerateRandomBatch_NEON(
+	const RandomKey&	key,
+	A_u_long			first,
+	A_long				count,
+	A_u_long			block,
+	A_u_long			out[RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX])
+{
+	static const uint32_t kLanes[4] = {0, 1, 2, 3};
+	const uint32x4_t lanes = vld1q_u32(kLanes);
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		uint32x4_t c0 = vaddq_u32(vdupq_n_u32(first + (A_u_long)i), lanes);
+		uint32x4_t c1 = vdupq_n_u32(block);
+		uint32x4_t c2 = vdupq_n_u32(0);
+		uint32x4_t c3 = vdupq_n_u32(0);
+		A_u_long k0 = key.seed, k1 = key.stream;
+
+		for (int r = 0; r < PHILOX_ROUNDS; r++) {
+			uint32x4_t hi0, lo0, hi1, lo1;
+			MulHiLo_NEON(c0, PHILOX_M0, &hi0, &lo0);
+			MulHiLo_NEON(c2, PHILOX_M1, &hi1, &lo1);
+			c0 = veorq_u32(veorq_u32(hi1, c1), vdupq_n_u32(k0));
+			c1 = lo1;
+			c2 = veorq_u32(veorq_u32(hi0, c3), vdupq_n_u32(k1));
+			c3 = lo0;
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+
+		vst1q_u32(&out[0][i], c0);
+		vst1q_u32(&out[1][i], c1);
+		vst1q_u32(&out[2][i], c2);
+		vst1q_u32(&out[3][i], c3);
+	}
+
+	for (; i < count; i++) {
+		A_u_long words[RANDOM_BLOCK_WORDS];
+		GenerateRandomWords(key, first + (A_u_long)i, block, words);
+		for (int w = 0; w < RANDOM_BLOCK_WORDS; w++) {
+			out[w][i] = words[w];
+		}
+	}
+}
+
+#endif // REPTALL_SIMD_NEON
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+static RandomBatchFunc
+SelectRandomBatchKernel(void)
+{
+	switch (GetSampleKernels()->level) {
+#if defined(REPTALL_SIMD_X86)
+		case SAMPLE_KERNEL_AVX2:	return GenerateRandomBatch_AVX2;
+		case SAMPLE_KERNEL_SSE41:	return GenerateRandomBatch_SSE41;
+#elif defined(REPTALL_SIMD_NEON)
+		case SAMPLE_KERNEL_NEON:	return GenerateRandomBatch_NEON;
+#endif
+		default:					break;
+	}
+
+	return GenerateRandomBatchScalar;
+}
+
+RandomBatchFunc
+GetRandomBatchKernel(void)
+{
+	// Thread-safe one-time initialization (C++11 magic statics)
+	static const RandomBatchFunc kernel = SelectRandomBatchKernel();
+	return kernel;
+}
+
+RandomBatchFunc
+GetScalarRandomBatchKernel(void)
+{
+	return GenerateRandomBatchScalar;
+}
@@ -0,0 +1,131 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*
+	ReptAll_Random.h
+
+	Counter-based random numbers for the Random group and the effectors:
+	Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as
+	1, 2, 3", SC 2011), with scalar, SSE4.1, AVX2 and NEON batch kernels.
+
+	There is no generator state. Every value is a pure function of its key
+	(seed, stream) and counter (copy index, block), so a copy gets the same
+	jitter whichever thread, tile, frame or render order computes it.
+*/
+
+#ifndef REPTALL_RANDOM_H
+#define REPTALL_RANDOM_H
+
+#include "ReptAll_Types.h"
+
+// Largest number of counters handed to a batch kernel in one call
+#define RANDOM_BATCH_MAX	64
+
+// Random words per counter; channel c of an index is word c % 4 of block c / 4
+#define RANDOM_BLOCK_WORDS	4
+
+// Philox4x32 round multipliers and Weyl key increments
+#define PHILOX_M0			0xD2511F53u
+#define PHILOX_M1			0xCD9E8D57u
+#define PHILOX_W0			0x9E3779B9u
+#define PHILOX_W1			0xBB67AE85u
+#define PHILOX_ROUNDS		10
+
+// How random offsets spread over [-1, 1]
+enum RandomDistribution {
+	RANDOM_DISTRIBUTION_UNIFORM = 0,    // flat
+	RANDOM_DISTRIBUTION_CENTERED        // triangular, most values near 0
+};
+
+// Key of one independent stream of random words
+struct RandomKey {
+	A_u_long	seed;             // master seed + seed offset
+	A_u_long	stream;           // effector (or other consumer) index
+};
+
+// The four words of counter (index, block, 0, 0) under key
+inline void
+GenerateRandomWords(
+	const RandomKey&	key,
+	A_u_long			index,
+	A_u_long			block,
+	A_u_long			out[RANDOM_BLOCK_WORDS])
+{
+	A_u_long c0 = index, c1 = block, c2 = 0, c3 = 0;
+	A_u_long k0 = key.seed, k1 = key.stream;
+
+	for (int r = 0; r < PHILOX_ROUNDS; r++) {
+		const A_u_longlong p0 = (A_u_longlong)PHILOX_M0 * c0;
+		const A_u_longlong p1 = (A_u_longlong)PHILOX_M1 * c2;
+		c0 = (A_u_long)(p1 >> 32) ^ c1 ^ k0;
+		c1 = (A_u_long)p1;
+		c2 = (A_u_long)(p0 >> 32) ^ c3 ^ k1;
+		c3 = (A_u_long)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+// Words of counters (first + i, block) for i < count (<= RANDOM_BATCH_MAX),
+// stored by word: out[w][i]. Identical to GenerateRandomWords on every
+// instruction set.
+typedef void (*RandomBatchFunc)(
+	const RandomKey&	key,
+	A_u_long			first,
+	A_long				count,
+	A_u_long			block,
+	A_u_long			out[RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX]);
+
+// Batch kernel for the instruction set the sampling kernels use (so
+// REPTALL_FORCE_SCALAR=1 selects the scalar reference here as well)
+RandomBatchFunc
+GetRandomBatchKernel(void);
+
+// Scalar reference kernel, always available
+RandomBatchFunc
+GetScalarRandomBatchKernel(void);
+
+// Uniform in [0, 1) from the top 24 bits of a word
+inline float
+RandomUnit(A_u_long word)
+{
+	return (float)(word >> 8) * (1.0f / 16777216.0f);
+}
+
+// In [-1, 1) with the given distribution; the centered one sums the two
+// 16-bit halves of the word
+inline float
+RandomSigned(
+	A_u_long			word,
+	RandomDistribution	distribution)
+{
+	if (distribution == RANDOM_DISTRIBUTION_CENTERED) {
+		return (float)((A_long)(word >> 16) + (A_long)(word & 0xFFFF) - 65535) * (1.0f / 65536.0f);
+	}
+	return (float)(word >> 8) * (1.0f / 8388608.0f) - 1.0f;
+}
+
+#endif // REPTALL_RANDOM_H
@@ -0,0 +1,834 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Render.cpp
+
+	reptall-render: headless driver of the render core for profiling,
+	regression renders and batch previews.
+
+	reptall-render [options] SOURCE PARAMS OUTPUT
+
+	SOURCE is a PAM (P7, RGB or RGB_ALPHA) or PPM (P6) image, 8 or 16 bits
+	per channel. OUTPUT names the rendered PAM frames; a printf pattern such
+	as out_%04d.pam gets the frame number.
+
+	PARAMS holds one "key = values" line per ReptAllState field ('#' starts
+	a comment). A field animates linearly over the frames when its start
+	values are followed by "->" and the values of the last frame:
+
+		copies = 12 1 1
+		step_position = 40 0 0
+		step_rotation = 0 0 0 -> 0 0 30
+		opacity_end = 20
+
+	front_to_back = 1 composites the Normal blend nearest copy first, as
+	the effect's Front to Back checkbox does (default 0, back to front).
+
+	The Random group uses random_seed, random_strength and
+	random_distribution (0 uniform, 1 centered); effector N (1-3) is
+	configured by effectorN_enable, _strength, _seed_offset, _probability,
+	_position, _rotation, _scale (3 values each) and _opacity:
+
+		effector1_enable = 1
+		effector1_position = 30 0 0
+		effector1_rotation = 0 20 0
+
+	Fields limit where the effectors act: spatial_field_type (0 none, 1 box,
+	2 sphere), _center, _size (3 values each), _curve (0 linear, 1 ease in
+	out) and _invert; index_field_type (0 none, 1 range), _start, _end
+	(percent) and _curve; field_combine (0 multiply, 1 min, 2 max).
+
+	The optional camera file (--camera) has the same syntax:
+
+		zoom = 1200                 # camera zoom in pixels
+		position = 960 540 -1200    # world position
+		orientation = 0 15 0        # degrees, applied about X, then Y, then Z
+		layer_center = 960 540      # defaults to the source center
+
+	or "matrix = ..." with the 16 values of the layer-to-world transform
+	(row vectors, translation in the last row) in place of position and
+	orientation. Without a camera the copies are seen orthographically.
+
+	Options:
+		--frames N      render N frames (default 1)
+		--depth D       8, 16 or 32 (float) bits per channel (default 8)
+		--threads N     render threads (default: all processors)
+		--draft         draft quality (nearest-neighbor sampling)
+		--shutter A     motion blur over a shutter of A degrees of a frame
+		--shutter-phase P  shutter open P degrees from the frame time
+		                (default -A / 2, centered on the frame)
+		--quiet         no per-frame timings
+*/
+
+#include "ReptAll_Core.h"
+#include "ReptAll_Instances.h"
+#include "ReptAll_ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// ============================================================================
+// Images
+// ============================================================================
+
+// Straight (unpremultiplied) RGBA image, channels in [0, 1]
+struct Image {
+	A_long				width;
+	A_long				height;
+	std::vector<float>	rgba;
+
+	Image() : width(0), height(0) {}
+};
+
+// Premultiplied buffer in the core's pixel layout
+struct RenderWorld {
+	std::vector<char>	storage;
+	PF_EffectWorld		world;
+
+	void Allocate(A_long width, A_long height, A_long depth) {
+		A_long pixelSize = depth == 32 ? (A_long)sizeof(PF_PixelFloat) :
+						   depth == 16 ? (A_long)sizeof(PF_Pixel16) : (A_long)sizeof(PF_Pixel);
+		storage.assign((size_t)width * height * pixelSize, 0);
+		world.data = (PF_PixelPtr)storage.data();
+		world.rowbytes = width * pixelSize;
+		world.width = width;
+		world.height = height;
+	}
+};
+
+// Next whitespace-separated header token, skipping '#' comments
+static bool
+ReadHeaderToken(
+	FILE		*fp,
+	std::string	*token)
+{
+	int c = fgetc(fp);
+
+	token->clear();
+	while (c != EOF) {
+		if (c == '#') {
+			while (c != EOF && c != '\n') {
+				c = fgetc(fp);
+			}
+		} else if (isspace(c)) {
+			c = fgetc(fp);
+		} else {
+			break;
+		}
+	}
+	while (c != EOF && !isspace(c)) {
+		token->push_back((char)c);
+		c = fgetc(fp);
+	}
+	return !token->empty();
+}
+
+static bool
+ReadImage(
+	const char	*path,
+	Image		*image)
+{
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		fprintf(stderr, "reptall-render: cannot open %s\n", path);
+		return false;
+	}
+
+	std::string magic, token;
+	long width = 0, height = 0, channels = 3, maxval = 0;
+	bool ok = ReadHeaderToken(fp, &magic);
+
+	if (ok && magic == "P6") {
+		ok = ReadHeaderToken(fp, &token) && (width = atol(token.c_str())) > 0 &&
+			 ReadHeaderToken(fp, &token) && (height = atol(token.c_str())) > 0 &&
+			 ReadHeaderToken(fp, &token) && (maxval = atol(token.c_str())) > 0;
+	} else if (ok && magic == "P7") {
+		channels = 0;
+		while ((ok = ReadHeaderToken(fp, &token)) && token != "ENDHDR") {
+			std::string value;
+			ok = ReadHeaderToken(fp, &value);
+			if (!ok) break;
+			if (token == "WIDTH") width = atol(value.c_str());
+			else if (token == "HEIGHT") height = atol(value.c_str());
+			else if (token == "DEPTH") channels = atol(value.c_str());
+			else if (token == "MAXVAL") maxval = atol(value.c_str());
+		}
+		ok = ok && width > 0 && height > 0 && (channels == 3 || channels == 4) && maxval > 0;
+	} else {
+		ok = false;
+	}
+
+	ok = ok && maxval <= 65535 && (long long)width * height <= (1LL << 28);
+
+	if (ok) {
+		const size_t bytesPerValue = maxval > 255 ? 2 : 1;
+		std::vector<unsigned char> raw((size_t)width * height * channels * bytesPerValue);
+
+		ok = fread(raw.data(), 1, raw.size(), fp) == raw.size();
+		if (ok) {
+			image->width = (A_long)width;
+			image->height = (A_long)height;
+			image->rgba.assign((size_t)width * height * 4, 1.0f);
+
+			for (size_t p = 0; p < (size_t)width * height; p++) {
+				for (long c = 0; c < channels; c++) {
+					size_t v = (p * channels + c) * bytesPerValue;
+					unsigned value = bytesPerValue == 2 ? (raw[v] << 8) | raw[v + 1] : raw[v];
+					image->rgba[p * 4 + c] = std::min(1.0f, (float)value / (float)maxval);
+				}
+			}
+		}
+	}
+
+	fclose(fp);
+	if (!ok) {
+		fprintf(stderr, "reptall-render: %s is not a supported PAM/PPM image\n", path);
+	}
+	return ok;
+}
+
+// 8-bit frames are written with MAXVAL 255, deeper ones with 65535
+static bool
+WriteImage(
+	const char		*path,
+	const Image&	image,
+	A_long			depth)
+{
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		fprintf(stderr, "reptall-render: cannot create %s\n", path);
+		return false;
+	}
+
+	const unsigned maxval = depth == 8 ? 255 : 65535;
+	const size_t bytesPerValue = depth == 8 ? 1 : 2;
+	std::vector<unsigned char> raw((size_t)image.width * image.height * 4 * bytesPerValue);
+
+	for (size_t v = 0; v < image.rgba.size(); v++) {
+		float f = std::min(1.0f, std::max(0.0f, image.rgba[v]));
+		unsigned value = (unsigned)(f * maxval + 0.5f);
+		if (bytesPerValue == 2) {
+			raw[2 * v] = (unsigned char)(value >> 8);
+			raw[2 * v + 1] = (unsigned char)value;
+		} else {
+			raw[v] = (unsigned char)value;
+		}
+	}
+
+	fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL %u\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+			(int)image.width, (int)image.height, maxval);
+	bool ok = fwrite(raw.data(), 1, raw.size(), fp) == raw.size();
+	ok = (fclose(fp) == 0) && ok;
+
+	if (!ok) {
+		fprintf(stderr, "reptall-render: cannot write %s\n", path);
+	}
+	return ok;
+}
+
+// Premultiplies image into world
+static void
+ImageToWorld(
+	const Image&	image,
+	A_long			depth,
+	RenderWorld		*world)
+{
+	world->Allocate(image.width, image.height, depth);
+
+	for (A_long y = 0; y < image.height; y++) {
+		char *row = (char*)world->world.data + (size_t)y * world->world.rowbytes;
+
+		for (A_long x = 0; x < image.width; x++) {
+			const float *s = &image.rgba[((size_t)y * image.width + x) * 4];
+			const float a = s[3];
+
+			if (depth == 32) {
+				PF_PixelFloat *d = (PF_PixelFloat*)row + x;
+				d->alpha = a;
+				d->red = s[0] * a;
+				d->green = s[1] * a;
+				d->blue = s[2] * a;
+			} else if (depth == 16) {
+				PF_Pixel16 *d = (PF_Pixel16*)row + x;
+				d->alpha = (A_u_short)(a * PF_MAX_CHAN16 + 0.5f);
+				d->red = (A_u_short)(s[0] * a * PF_MAX_CHAN16 + 0.5f);
+				d->green = (A_u_short)(s[1] * a * PF_MAX_CHAN16 + 0.5f);
+				d->blue = (A_u_short)(s[2] * a * PF_MAX_CHAN16 + 0.5f);
+			} else {
+				PF_Pixel *d = (PF_Pixel*)row + x;
+				d->alpha = (A_u_char)(a * PF_MAX_CHAN8 + 0.5f);
+				d->red = (A_u_char)(s[0] * a * PF_MAX_CHAN8 + 0.5f);
+				d->green = (A_u_char)(s[1] * a * PF_MAX_CHAN8 + 0.5f);
+				d->blue = (A_u_char)(s[2] * a * PF_MAX_CHAN8 + 0.5f);
+			}
+		}
+	}
+}
+
+// Unpremultiplies world into image
+static void
+WorldToImage(
+	const PF_EffectWorld&	world,
+	A_long					depth,
+	Image					*image)
+{
+	image->width = world.width;
+	image->height = world.height;
+	image->rgba.assign((size_t)world.width * world.height * 4, 0.0f);
+
+	for (A_long y = 0; y < world.height; y++) {
+		const char *row = (const char*)world.data + (size_t)y * world.rowbytes;
+
+		for (A_long x = 0; x < world.width; x++) {
+			float *d = &image->rgba[((size_t)y * world.width + x) * 4];
+			float p[4];
+
+			if (depth == 32) {
+				const PF_PixelFloat *s = (const PF_PixelFloat*)row + x;
+				p[0] = s->red; p[1] = s->green; p[2] = s->blue; p[3] = s->alpha;
+			} else if (depth == 16) {
+				const PF_Pixel16 *s = (const PF_Pixel16*)row + x;
+				const float k = 1.0f / PF_MAX_CHAN16;
+				p[0] = s->red * k; p[1] = s->green * k; p[2] = s->blue * k; p[3] = s->alpha * k;
+			} else {
+				const PF_Pixel *s = (const PF_Pixel*)row + x;
+				const float k = 1.0f / PF_MAX_CHAN8;
+				p[0] = s->red * k; p[1] = s->green * k; p[2] = s->blue * k; p[3] = s->alpha * k;
+			}
+
+			d[3] = p[3];
+			for (int c = 0; c < 3; c++) {
+				d[c] = p[3] > 0.0f ? p[c] / p[3] : 0.0f;
+			}
+		}
+	}
+}
+
+// ============================================================================
+// Parameter and camera files
+// ============================================================================
+
+// Values of one key on the first and the last frame (equal unless animated)
+struct KeyValues {
+	std::vector<double>	first;
+	std::vector<double>	last;
+
+	double At(size_t i, double t) const {
+		return first[i] + (last[i] - first[i]) * t;
+	}
+};
+
+typedef std::map<std::string, KeyValues> KeyFile;
+
+static bool
+ReadKeyFile(
+	const char	*path,
+	KeyFile		*keys)
+{
+	std::ifstream in(path);
+	if (!in) {
+		fprintf(stderr, "reptall-render: cannot open %s\n", path);
+		return false;
+	}
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+		line = line.substr(0, line.find('#'));
+
+		size_t eq = line.find('=');
+		std::istringstream name(line.substr(0, eq));
+		std::string key;
+		if (!(name >> key)) {
+			continue;
+		}
+
+		KeyValues values;
+		std::vector<double> *target = &values.first;
+		std::istringstream rest(eq == std::string::npos ? "" : line.substr(eq + 1));
+		std::string token;
+
+		while (rest >> token) {
+			char *end = NULL;
+			if (token == "->" && target == &values.first) {
+				target = &values.last;
+				continue;
+			}
+			double v = strtod(token.c_str(), &end);
+			if (*end) {
+				target = NULL;
+				break;
+			}
+			target->push_back(v);
+		}
+
+		if (!target || values.first.empty() ||
+			(target == &values.last && values.last.size() != values.first.size())) {
+			fprintf(stderr, "reptall-render: %s:%d: expected \"key = values [-> values]\"\n", path, lineNumber);
+			return false;
+		}
+		if (values.last.empty()) {
+			values.last = values.first;
+		}
+		(*keys)[key] = values;
+	}
+
+	return true;
+}
+
+// Copies count values of key (if present) at frame time t into out
+static bool
+GetKey(
+	const KeyFile&	keys,
+	const char		*key,
+	size_t			count,
+	double			t,
+	double			*out)
+{
+	KeyFile::const_iterator it = keys.find(key);
+	if (it == keys.end()) {
+		return true;
+	}
+	if (it->second.first.size() != count) {
+		fprintf(stderr, "reptall-render: %s takes %d value(s)\n", key, (int)count);
+		return false;
+	}
+	for (size_t i = 0; i < count; i++) {
+		out[i] = it->second.At(i, t);
+	}
+	return true;
+}
+
+// State of the frame at t in [0, 1] (first to last frame)
+static bool
+MakeState(
+	const KeyFile&	keys,
+	double			t,
+	ReptAllState	*state)
+{
+	static const char *known[] = {
+		"copies", "offset", "anchor", "position", "scale", "rotation",
+		"step_position", "step_rotation", "step_scale", "opacity_start",
+		"opacity_end", "camera_aware", "composite_mode", "front_to_back",
+		"random_seed", "random_strength", "random_distribution",
+		"spatial_field_type", "spatial_field_center", "spatial_field_size",
+		"spatial_field_curve", "spatial_field_invert", "index_field_type",
+		"index_field_start", "index_field_end", "index_field_curve", "field_combine"
+	};
+	static const char *effectorKnown[] = {
+		"enable", "strength", "seed_offset", "probability",
+		"position", "rotation", "scale", "opacity"
+	};
+
+	for (KeyFile::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+		const std::string& name = it->first;
+		const bool isEffector = name.size() > 10 && name.compare(0, 8, "effector") == 0 &&
+								name[8] >= '1' && name[8] < '1' + REPTALL_EFFECTOR_COUNT && name[9] == '_' &&
+								std::find_if(std::begin(effectorKnown), std::end(effectorKnown),
+											 [&](const char *k) { return name.compare(10, std::string::npos, k) == 0; }) != std::end(effectorKnown);
+		if (!isEffector &&
+			std::find_if(std::begin(known), std::end(known),
+						 [&](const char *k) { return name == k; }) == std::end(known)) {
+			fprintf(stderr, "reptall-render: unknown parameter %s\n", it->first.c_str());
+			return false;
+		}
+	}
+
+	double copies[3] = {(double)REPTALL_COUNT_DFLT, 1.0, 1.0};
+	double flags[3] = {1.0, 0.0, (double)REPTALL_FRONT_TO_BACK_DFLT};
+	bool ok = true;
+
+	state->Clear();
+	ok = ok && GetKey(keys, "copies", 3, t, copies);
+	ok = ok && GetKey(keys, "offset", 1, t, &state->offset);
+	ok = ok && GetKey(keys, "anchor", 3, t, state->anchor);
+	ok = ok && GetKey(keys, "position", 3, t, state->position);
+	ok = ok && GetKey(keys, "scale", 1, t, &state->scale);
+	ok = ok && GetKey(keys, "rotation", 3, t, state->rotation);
+	ok = ok && GetKey(keys, "step_position", 3, t, state->step_position);
+	ok = ok && GetKey(keys, "step_rotation", 3, t, state->step_rotation);
+	ok = ok && GetKey(keys, "step_scale", 1, t, &state->step_scale);
+	ok = ok && GetKey(keys, "opacity_start", 1, t, &state->opacity_start);
+	ok = ok && GetKey(keys, "opacity_end", 1, t, &state->opacity_end);
+	ok = ok && GetKey(keys, "camera_aware", 1, t, &flags[0]);
+	ok = ok && GetKey(keys, "composite_mode", 1, t, &flags[1]);
+	ok = ok && GetKey(keys, "front_to_back", 1, t, &flags[2]);
+
+	double random[2] = {(double)state->random_seed, (double)state->random_distribution};
+	ok = ok && GetKey(keys, "random_seed", 1, t, &random[0]);
+	ok = ok && GetKey(keys, "random_strength", 1, t, &state->random_strength);
+	ok = ok && GetKey(keys, "random_distribution", 1, t, &random[1]);
+	state->random_seed = (A_long)std::floor(random[0] + 0.5);
+	state->random_distribution = (A_long)random[1];
+
+	double fieldModes[6] = {(double)state->spatial_field.shape, (double)state->spatial_field.curve, 0.0,
+							(double)state->index_field.type, (double)state->index_field.curve,
+							(double)state->field_combine};
+	ok = ok && GetKey(keys, "spatial_field_type", 1, t, &fieldModes[0]);
+	ok = ok && GetKey(keys, "spatial_field_center", 3, t, state->spatial_field.center);
+	ok = ok && GetKey(keys, "spatial_field_size", 3, t, state->spatial_field.size);
+	ok = ok && GetKey(keys, "spatial_field_curve", 1, t, &fieldModes[1]);
+	ok = ok && GetKey(keys, "spatial_field_invert", 1, t, &fieldModes[2]);
+	ok = ok && GetKey(keys, "index_field_type", 1, t, &fieldModes[3]);
+	ok = ok && GetKey(keys, "index_field_start", 1, t, &state->index_field.start);
+	ok = ok && GetKey(keys, "index_field_end", 1, t, &state->index_field.end);
+	ok = ok && GetKey(keys, "index_field_curve", 1, t, &fieldModes[4]);
+	ok = ok && GetKey(keys, "field_combine", 1, t, &fieldModes[5]);
+	state->spatial_field.shape = (A_long)fieldModes[0];
+	state->spatial_field.curve = (A_long)fieldModes[1];
+	state->spatial_field.invert = fieldModes[2] != 0.0;
+	state->index_field.type = (A_long)fieldModes[3];
+	state->index_field.curve = (A_long)fieldModes[4];
+	state->field_combine = (A_long)fieldModes[5];
+
+	for (int e = 0; e < REPTALL_EFFECTOR_COUNT && ok; e++) {
+		CopyEffector& effector = state->effector[e];
+		const std::string prefix = "effector" + std::to_string(e + 1) + "_";
+		double enable = 0.0;
+		double seedOffset = (double)effector.seed_offset;
+
+		ok = ok && GetKey(keys, (prefix + "enable").c_str(), 1, t, &enable);
+		ok = ok && GetKey(keys, (prefix + "strength").c_str(), 1, t, &effector.strength);
+		ok = ok && GetKey(keys, (prefix + "seed_offset").c_str(), 1, t, &seedOffset);
+		ok = ok && GetKey(keys, (prefix + "probability").c_str(), 1, t, &effector.probability);
+		ok = ok && GetKey(keys, (prefix + "position").c_str(), 3, t, effector.position);
+		ok = ok && GetKey(keys, (prefix + "rotation").c_str(), 3, t, effector.rotation);
+		ok = ok && GetKey(keys, (prefix + "scale").c_str(), 3, t, effector.scale);
+		ok = ok && GetKey(keys, (prefix + "opacity").c_str(), 1, t, &effector.opacity);
+		effector.enabled = enable != 0.0;
+		effector.seed_offset = (A_long)std::floor(seedOffset + 0.5);
+	}
+
+	for (int i = 0; i < 3; i++) {
+		state->copies[i] = (A_long)std::floor(copies[i] + 0.5);
+	}
+	state->camera_aware = flags[0] != 0.0;
+	state->composite_mode = (A_long)flags[1];
+	state->front_to_back = flags[2] != 0.0;
+
+	return ok;
+}
+
+// Camera of the frame at t for a layer of the given size
+static bool
+MakeCamera(
+	const KeyFile&	keys,
+	double			t,
+	A_long			layerWidth,
+	A_long			layerHeight,
+	CopyCamera		*camera)
+{
+	double zoom = 0.0;
+	double position[3] = {layerWidth / 2.0, layerHeight / 2.0, 0.0};
+	double orientation[3] = {0.0, 0.0, 0.0};
+	double matrix[16];
+	double center[2] = {layerWidth / 2.0, layerHeight / 2.0};
+	bool ok = true;
+
+	camera->Clear();
+	if (keys.empty()) {
+		return true;
+	}
+
+	for (KeyFile::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+		if (it->first != "zoom" && it->first != "position" && it->first != "orientation" &&
+			it->first != "matrix" && it->first != "layer_center") {
+			fprintf(stderr, "reptall-render: unknown camera key %s\n", it->first.c_str());
+			return false;
+		}
+	}
+
+	ok = ok && GetKey(keys, "zoom", 1, t, &zoom);
+	ok = ok && GetKey(keys, "position", 3, t, position);
+	ok = ok && GetKey(keys, "orientation", 3, t, orientation);
+	ok = ok && GetKey(keys, "layer_center", 2, t, center);
+	if (!ok) {
+		return false;
+	}
+	if (!(zoom > 0.0)) {
+		fprintf(stderr, "reptall-render: the camera needs a positive zoom\n");
+		return false;
+	}
+
+	if (keys.count("matrix")) {
+		if (!GetKey(keys, "matrix", 16, t, matrix)) {
+			return false;
+		}
+		for (int r = 0; r < 4; r++) {
+			for (int c = 0; c < 4; c++) {
+				camera->matrix.mat[r][c] = matrix[4 * r + c];
+			}
+		}
+	} else {
+		// Row-vector rotation: X first, then Y, then Z
+		double axes[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+		for (int a = 0; a < 3; a++) {
+			const double angle = orientation[a] * M_PI / 180.0;
+			const double cs = cos(angle), sn = sin(angle);
+			const int i = (a + 1) % 3, j = (a + 2) % 3;
+
+			for (int r = 0; r < 3; r++) {
+				const double vi = axes[r][i], vj = axes[r][j];
+				axes[r][i] = vi * cs - vj * sn;
+				axes[r][j] = vi * sn + vj * cs;
+			}
+		}
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 3; c++) {
+				camera->matrix.mat[r][c] = axes[r][c];
+			}
+			camera->matrix.mat[r][3] = 0.0;
+			camera->matrix.mat[3][r] = position[r];
+		}
+		camera->matrix.mat[3][3] = 1.0;
+	}
+
+	camera->has_camera = TRUE;
+	camera->focal_length = zoom;
+	camera->layer_center[0] = center[0];
+	camera->layer_center[1] = center[1];
+
+	return true;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static void
+Usage(void)
+{
+	fprintf(stderr,
+			"usage: reptall-render [--frames N] [--depth 8|16|32] [--threads N]\n"
+			"                      [--camera FILE] [--draft] [--shutter A [--shutter-phase P]]\n"
+			"                      [--quiet] SOURCE PARAMS OUTPUT\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	A_long frames = 1;
+	A_long depth = 8;
+	A_long threadCount = (A_long)std::max(1u, std::thread::hardware_concurrency());
+	const char *cameraPath = NULL;
+	bool quiet = false;
+	bool draft = false;
+	double shutterAngle = 0.0;
+	double shutterPhase = 0.0;
+	bool hasShutterPhase = false;
+	std::vector<const char*> files;
+
+	for (int a = 1; a < argc; a++) {
+		std::string arg = argv[a];
+		bool hasValue = a + 1 < argc;
+
+		if (arg == "--frames" && hasValue) {
+			frames = atoi(argv[++a]);
+		} else if (arg == "--depth" && hasValue) {
+			depth = atoi(argv[++a]);
+		} else if (arg == "--threads" && hasValue) {
+			threadCount = atoi(argv[++a]);
+		} else if (arg == "--camera" && hasValue) {
+			cameraPath = argv[++a];
+		} else if (arg == "--shutter" && hasValue) {
+			shutterAngle = atof(argv[++a]);
+		} else if (arg == "--shutter-phase" && hasValue) {
+			shutterPhase = atof(argv[++a]);
+			hasShutterPhase = true;
+		} else if (arg == "--draft") {
+			draft = true;
+		} else if (arg == "--quiet") {
+			quiet = true;
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			Usage();
+			return 2;
+		} else {
+			files.push_back(argv[a]);
+		}
+	}
+
+	if (files.size() != 3 || frames < 1 || threadCount < 1 ||
+		(depth != 8 && depth != 16 && depth != 32) || !(shutterAngle >= 0.0 && shutterAngle <= 720.0)) {
+		Usage();
+		return 2;
+	}
+
+	Image sourceImage;
+	KeyFile params, cameraKeys;
+	if (!ReadImage(files[0], &sourceImage) ||
+		!ReadKeyFile(files[1], &params) ||
+		(cameraPath && !ReadKeyFile(cameraPath, &cameraKeys))) {
+		return 1;
+	}
+
+	RenderWorld source, output;
+	ImageToWorld(sourceImage, depth, &source);
+	output.Allocate(sourceImage.width, sourceImage.height, depth);
+
+	RenderGeometry geometry;
+	geometry.Clear(sourceImage.width, sourceImage.height);
+
+	RenderThreadPool *pool = NULL;
+	if (CreateRenderThreadPool(threadCount, &pool) != PF_Err_NONE) {
+		fprintf(stderr, "reptall-render: cannot start %d render threads\n", (int)threadCount);
+		return 1;
+	}
+
+	RenderHost host;
+	GetRenderThreadPoolHost(pool, &host);
+
+	// REPTALL_TRACE / REPTALL_STATS_OVERLAY work as in the plug-in
+	RenderStats stats;
+	host.stats = IsRenderStatsEnabled() ? &stats : NULL;
+
+	if (!hasShutterPhase) {
+		shutterPhase = -0.5 * shutterAngle;
+	}
+
+	CopyInstanceList previous;
+	double totalMs = 0.0;
+	int status = 0;
+
+	for (A_long frame = 0; frame < frames; frame++) {
+		const double t = frames > 1 ? (double)frame / (frames - 1) : 0.0;
+		ReptAllState state;
+		CopyCamera camera;
+
+		stats.Clear();
+		BeginRenderPhase(host.stats, RENDER_PHASE_PARAMS);
+		if (!MakeState(params, t, &state) ||
+			!MakeCamera(cameraKeys, t, sourceImage.width, sourceImage.height, &camera)) {
+			status = 1;
+			break;
+		}
+		state.draft = draft;
+		EndRenderPhase(host.stats, RENDER_PHASE_PARAMS);
+
+		const long long totalCopies = (long long)state.copies[0] * state.copies[1] * state.copies[2];
+		if (state.copies[0] < 1 || state.copies[1] < 1 || state.copies[2] < 1 || totalCopies > MAX_COPIES) {
+			fprintf(stderr, "reptall-render: copies must be >= 1 and at most %d in total\n", MAX_COPIES);
+			status = 1;
+			break;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		PF_Err err = PF_Err_NONE;
+
+		// Phases 2-4, as the effect runs them for a full-layer render
+		std::shared_ptr<CopyInstanceBuffer> instances;
+		BeginRenderPhase(host.stats, RENDER_PHASE_TRANSFORMS);
+		ERR(AcquireCopyInstances((A_long)totalCopies, &instances));
+		ERR(ComputeCopyTransforms(&state, &camera, instances.get()));
+		EndRenderPhase(host.stats, RENDER_PHASE_TRANSFORMS);
+		BeginRenderPhase(host.stats, RENDER_PHASE_SORT);
+		ERR(SortCopiesByDepth(instances.get(), state.camera_aware,
+							  previous && previous->count == totalCopies ? previous->order : NULL));
+		EndRenderPhase(host.stats, RENDER_PHASE_SORT);
+
+		// Copy transforms at shutter open and close, a fraction of a frame
+		// from t
+		std::shared_ptr<CopyInstanceBuffer> shutter[2];
+		CopyMotion motion = {NULL, NULL};
+		if (!err && shutterAngle > 0.0 && frames > 1) {
+			const double frameT = 1.0 / (frames - 1);
+			const double shutterT[2] = {t + frameT * shutterPhase / 360.0,
+										t + frameT * (shutterPhase + shutterAngle) / 360.0};
+			bool sameGrid = true;
+
+			for (int e = 0; e < 2 && !err && sameGrid; e++) {
+				ReptAllState shutterState;
+				CopyCamera shutterCamera;
+				if (!MakeState(params, shutterT[e], &shutterState) ||
+					!MakeCamera(cameraKeys, shutterT[e], sourceImage.width, sourceImage.height, &shutterCamera)) {
+					err = PF_Err_BAD_CALLBACK_PARAM;
+					break;
+				}
+				sameGrid = std::equal(shutterState.copies, shutterState.copies + 3, state.copies);
+				if (sameGrid) {
+					ERR(AcquireCopyInstances((A_long)totalCopies, &shutter[e]));
+					ERR(ComputeCopyTransforms(&shutterState, &shutterCamera, shutter[e].get()));
+				}
+			}
+			if (sameGrid) {
+				motion.open = shutter[0].get();
+				motion.close = shutter[1].get();
+			}
+		}
+
+		ERR(RenderCopies(&host, &state, instances.get(), motion.open ? &motion : NULL, &geometry,
+						 depth, &source.world, &output.world));
+
+		const double ms = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+
+		if (err) {
+			fprintf(stderr, "reptall-render: frame %d failed with error %d\n", (int)frame, (int)err);
+			status = 1;
+			break;
+		}
+		previous = instances;
+		totalMs += ms;
+
+		if (host.stats) {
+			if (IsRenderStatsOverlayEnabled()) {
+				DrawRenderStatsOverlay(stats, depth, geometry.layer_size[0], geometry.layer_size[1],
+									   geometry.dst_origin, &output.world);
+			}
+			AppendRenderTrace("reptall-render", stats);
+		}
+
+		char path[4096];
+		snprintf(path, sizeof(path), files[2], (int)frame);
+
+		Image frameImage;
+		WorldToImage(output.world, depth, &frameImage);
+		if (!WriteImage(path, frameImage, depth)) {
+			status = 1;
+			break;
+		}
+
+		if (!quiet) {
+			printf("frame %d: %lld copies, %.2f ms\n", (int)frame, totalCopies, ms);
+		}
+	}
+
+	DisposeRenderThreadPool(pool);
+
+	if (!status && !quiet && frames > 1) {
+		printf("%d frames, %.2f ms per frame\n", (int)frames, totalMs / frames);
+	}
+
+	return status;
+}
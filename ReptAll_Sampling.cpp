@@ -0,0 +1,672 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*	ReptAll_Sampling.cpp
+
+	Single-precision bilinear sampling kernels for 8, 16 and 32 bpc.
+
+	Every kernel evaluates the same expression in the same order,
+	  c = ((c00 * w00 + c10 * w10) + c01 * w01) + c11 * w11
+	with separate multiplies and adds, so the SIMD kernels reproduce the
+	scalar reference kernels bit for bit. That holds only while the
+	compiler does not fuse the scalar expression into FMAs, so this file
+	is built with -ffp-contract=off (/fp:precise on MSVC). Each pixel's four channels are
+	blended in one vector register; the loops handle 4 (SSE4.1, NEON) or
+	8 (AVX2) output pixels per iteration.
+*/
+
+#include "ReptAll_Sampling.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	#define REPTALL_SIMD_X86 1
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	#define REPTALL_SIMD_NEON 1
+	#include <arm_neon.h>
+#endif
+
+// GCC/Clang only emit SSE4.1/AVX2 instructions inside functions that ask
+// for them; MSVC accepts the intrinsics anywhere
+#if defined(REPTALL_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+	#define REPTALL_TARGET_SSE41	__attribute__((target("sse4.1")))
+	#define REPTALL_TARGET_AVX2		__attribute__((target("avx2")))
+#else
+	#define REPTALL_TARGET_SSE41
+	#define REPTALL_TARGET_AVX2
+#endif
+
+// ============================================================================
+// Scalar reference kernels
+// ============================================================================
+
+static inline A_u_long
+LoadU32(const char *p)
+{
+	A_u_long v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline void
+ComputeWeights(
+	float	fx,
+	float	fy,
+	float	*w00,
+	float	*w10,
+	float	*w01,
+	float	*w11)
+{
+	float gx = 1.0f - fx;
+	float gy = 1.0f - fy;
+	*w00 = gx * gy;
+	*w10 = fx * gy;
+	*w01 = gx * fy;
+	*w11 = fx * fy;
+}
+
+// One pixel, used by the scalar kernels and for SIMD tails
+template<typename PixelType, int MaxChannelInt>
+static inline void
+SamplePixelScalar(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				i,
+	PixelType			*out)
+{
+	const PixelType *row0 = (const PixelType*)(srcData + batch->offset[i]);
+	const PixelType *row1 = (const PixelType*)(srcData + batch->offset[i] + rowbytes);
+	const PixelType& p00 = row0[0];
+	const PixelType& p10 = row0[1];
+	const PixelType& p01 = row1[0];
+	const PixelType& p11 = row1[1];
+
+	float w00, w10, w01, w11;
+	ComputeWeights(batch->fx[i], batch->fy[i], &w00, &w10, &w01, &w11);
+
+	// MaxChannelInt == 1 indicates float (1.0), other values indicate integer
+	if constexpr (MaxChannelInt == 1) {
+		out->alpha = ((p00.alpha * w00 + p10.alpha * w10) + p01.alpha * w01) + p11.alpha * w11;
+		out->red   = ((p00.red * w00 + p10.red * w10) + p01.red * w01) + p11.red * w11;
+		out->green = ((p00.green * w00 + p10.green * w10) + p01.green * w01) + p11.green * w11;
+		out->blue  = ((p00.blue * w00 + p10.blue * w10) + p01.blue * w01) + p11.blue * w11;
+	} else {
+		// Integer: round; a convex blend never leaves the channel range
+		out->alpha = (decltype(out->alpha))(((p00.alpha * w00 + p10.alpha * w10) + p01.alpha * w01) + p11.alpha * w11 + 0.5f);
+		out->red   = (decltype(out->red))(((p00.red * w00 + p10.red * w10) + p01.red * w01) + p11.red * w11 + 0.5f);
+		out->green = (decltype(out->green))(((p00.green * w00 + p10.green * w10) + p01.green * w01) + p11.green * w11 + 0.5f);
+		out->blue  = (decltype(out->blue))(((p00.blue * w00 + p10.blue * w10) + p01.blue * w01) + p11.blue * w11 + 0.5f);
+	}
+}
+
+template<typename PixelType, int MaxChannelInt>
+static void
+SampleBatchScalarTmpl(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PixelType			*out)
+{
+	for (A_long i = 0; i < count; i++) {
+		SamplePixelScalar<PixelType, MaxChannelInt>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+static const SampleKernels kScalarKernels = {
+	SAMPLE_KERNEL_SCALAR,
+	SampleBatchScalarTmpl<PF_Pixel, PF_MAX_CHAN8>,
+	SampleBatchScalarTmpl<PF_Pixel16, PF_MAX_CHAN16>,
+	SampleBatchScalarTmpl<PF_PixelFloat, 1>
+};
+
+#ifdef REPTALL_SIMD_X86
+
+// ============================================================================
+// SSE4.1 kernels - one pixel (4 channels) per register, 4 pixels per loop
+// ============================================================================
+
+REPTALL_TARGET_SSE41 static inline void
+ComputeWeights4_SSE41(
+	const SampleBatch	*batch,
+	A_long				i,
+	float				w00[4],
+	float				w10[4],
+	float				w01[4],
+	float				w11[4])
+{
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 fx = _mm_loadu_ps(&batch->fx[i]);
+	__m128 fy = _mm_loadu_ps(&batch->fy[i]);
+	__m128 gx = _mm_sub_ps(one, fx);
+	__m128 gy = _mm_sub_ps(one, fy);
+
+	_mm_storeu_ps(w00, _mm_mul_ps(gx, gy));
+	_mm_storeu_ps(w10, _mm_mul_ps(fx, gy));
+	_mm_storeu_ps(w01, _mm_mul_ps(gx, fy));
+	_mm_storeu_ps(w11, _mm_mul_ps(fx, fy));
+}
+
+REPTALL_TARGET_SSE41 static inline __m128
+Blend4_SSE41(
+	__m128	c00,
+	__m128	c10,
+	__m128	c01,
+	__m128	c11,
+	float	w00,
+	float	w10,
+	float	w01,
+	float	w11)
+{
+	__m128 acc = _mm_add_ps(_mm_mul_ps(c00, _mm_set1_ps(w00)), _mm_mul_ps(c10, _mm_set1_ps(w10)));
+	acc = _mm_add_ps(acc, _mm_mul_ps(c01, _mm_set1_ps(w01)));
+	return _mm_add_ps(acc, _mm_mul_ps(c11, _mm_set1_ps(w11)));
+}
+
+REPTALL_TARGET_SSE41 static inline __m128
+Load8_SSE41(const char *p)
+{
+	return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)LoadU32(p))));
+}
+
+REPTALL_TARGET_SSE41 static inline __m128
+Load16_SSE41(const char *p)
+{
+	return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+REPTALL_TARGET_SSE41 static void
+SampleBatch8_SSE41(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_Pixel			*out)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		float w00[4], w10[4], w01[4], w11[4];
+		ComputeWeights4_SSE41(batch, i, w00, w10, w01, w11);
+
+		for (A_long k = 0; k < 4; k++) {
+			const char *p0 = srcData + batch->offset[i + k];
+			const char *p1 = p0 + rowbytes;
+
+			__m128 acc = Blend4_SSE41(Load8_SSE41(p0), Load8_SSE41(p0 + 4),
+									  Load8_SSE41(p1), Load8_SSE41(p1 + 4),
+									  w00[k], w10[k], w01[k], w11[k]);
+
+			__m128i v = _mm_cvttps_epi32(_mm_add_ps(acc, half));
+			v = _mm_packus_epi32(v, v);
+			v = _mm_packus_epi16(v, v);
+			A_u_long packed = (A_u_long)_mm_cvtsi128_si32(v);
+			memcpy(&out[i + k], &packed, sizeof(packed));
+		}
+	}
+
+	for (; i < count; i++) {
+		SamplePixelScalar<PF_Pixel, PF_MAX_CHAN8>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+REPTALL_TARGET_SSE41 static void
+SampleBatch16_SSE41(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_Pixel16			*out)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		float w00[4], w10[4], w01[4], w11[4];
+		ComputeWeights4_SSE41(batch, i, w00, w10, w01, w11);
+
+		for (A_long k = 0; k < 4; k++) {
+			const char *p0 = srcData + batch->offset[i + k];
+			const char *p1 = p0 + rowbytes;
+
+			__m128 acc = Blend4_SSE41(Load16_SSE41(p0), Load16_SSE41(p0 + 8),
+									  Load16_SSE41(p1), Load16_SSE41(p1 + 8),
+									  w00[k], w10[k], w01[k], w11[k]);
+
+			__m128i v = _mm_cvttps_epi32(_mm_add_ps(acc, half));
+			v = _mm_packus_epi32(v, v);
+			_mm_storel_epi64((__m128i*)&out[i + k], v);
+		}
+	}
+
+	for (; i < count; i++) {
+		SamplePixelScalar<PF_Pixel16, PF_MAX_CHAN16>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+REPTALL_TARGET_SSE41 static void
+SampleBatchFloat_SSE41(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_PixelFloat		*out)
+{
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		float w00[4], w10[4], w01[4], w11[4];
+		ComputeWeights4_SSE41(batch, i, w00, w10, w01, w11);
+
+		for (A_long k = 0; k < 4; k++) {
+			const float *p0 = (const float*)(srcData + batch->offset[i + k]);
+			const float *p1 = (const float*)(srcData + batch->offset[i + k] + rowbytes);
+
+			__m128 acc = Blend4_SSE41(_mm_loadu_ps(p0), _mm_loadu_ps(p0 + 4),
+									  _mm_loadu_ps(p1), _mm_loadu_ps(p1 + 4),
+									  w00[k], w10[k], w01[k], w11[k]);
+			_mm_storeu_ps((float*)&out[i + k], acc);
+		}
+	}
+
+	for (; i < count; i++) {
+		SamplePixelScalar<PF_PixelFloat, 1>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+static const SampleKernels kSSE41Kernels = {
+	SAMPLE_KERNEL_SSE41,
+	SampleBatch8_SSE41,
+	SampleBatch16_SSE41,
+	SampleBatchFloat_SSE41
+};
+
+// ============================================================================
+// AVX2 kernels - two pixels per register, 8 pixels per loop
+// ============================================================================
+
+REPTALL_TARGET_AVX2 static inline void
+ComputeWeights8_AVX2(
+	const SampleBatch	*batch,
+	A_long				i,
+	float				w00[8],
+	float				w10[8],
+	float				w01[8],
+	float				w11[8])
+{
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 fx = _mm256_loadu_ps(&batch->fx[i]);
+	__m256 fy = _mm256_loadu_ps(&batch->fy[i]);
+	__m256 gx = _mm256_sub_ps(one, fx);
+	__m256 gy = _mm256_sub_ps(one, fy);
+
+	_mm256_storeu_ps(w00, _mm256_mul_ps(gx, gy));
+	_mm256_storeu_ps(w10, _mm256_mul_ps(fx, gy));
+	_mm256_storeu_ps(w01, _mm256_mul_ps(gx, fy));
+	_mm256_storeu_ps(w11, _mm256_mul_ps(fx, fy));
+}
+
+// Weight of pixel a in the low lane, pixel b in the high lane
+REPTALL_TARGET_AVX2 static inline __m256
+PairWeight_AVX2(float wa, float wb)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(wa)), _mm_set1_ps(wb), 1);
+}
+
+REPTALL_TARGET_AVX2 static inline __m256
+Blend8_AVX2(
+	__m256			c00,
+	__m256			c10,
+	__m256			c01,
+	__m256			c11,
+	const float		*w00,
+	const float		*w10,
+	const float		*w01,
+	const float		*w11,
+	A_long			k)
+{
+	__m256 acc = _mm256_add_ps(_mm256_mul_ps(c00, PairWeight_AVX2(w00[k], w00[k + 1])),
+							   _mm256_mul_ps(c10, PairWeight_AVX2(w10[k], w10[k + 1])));
+	acc = _mm256_add_ps(acc, _mm256_mul_ps(c01, PairWeight_AVX2(w01[k], w01[k + 1])));
+	return _mm256_add_ps(acc, _mm256_mul_ps(c11, PairWeight_AVX2(w11[k], w11[k + 1])));
+}
+
+REPTALL_TARGET_AVX2 static inline __m256
+LoadPair8_AVX2(const char *pa, const char *pb)
+{
+	__m128i v = _mm_set_epi32(0, 0, (int)LoadU32(pb), (int)LoadU32(pa));
+	return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+}
+
+REPTALL_TARGET_AVX2 static inline __m256
+LoadPair16_AVX2(const char *pa, const char *pb)
+{
+	__m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)pa),
+								   _mm_loadl_epi64((const __m128i*)pb));
+	return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v));
+}
+
+REPTALL_TARGET_AVX2 static inline __m256
+LoadPairFloat_AVX2(const char *pa, const char *pb)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps((const float*)pa)),
+								_mm_loadu_ps((const float*)pb), 1);
+}
+
+REPTALL_TARGET_AVX2 static void
+SampleBatch8_AVX2(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_Pixel			*out)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	A_long i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		float w00[8], w10[8], w01[8], w11[8];
+		ComputeWeights8_AVX2(batch, i, w00, w10, w01, w11);
+
+		for (A_long k = 0; k < 8; k += 2) {
+			A_long a = i + k;
+			const char *pa = srcData + batch->offset[a];
+			const char *pb = srcData + batch->offset[a + 1];
+
+			__m256 acc = Blend8_AVX2(LoadPair8_AVX2(pa, pb),
+									 LoadPair8_AVX2(pa + 4, pb + 4),
+									 LoadPair8_AVX2(pa + rowbytes, pb + rowbytes),
+									 LoadPair8_AVX2(pa + rowbytes + 4, pb + rowbytes + 4),
+									 w00, w10, w01, w11, k);
+
+			__m256i v = _mm256_cvttps_epi32(_mm256_add_ps(acc, half));
+			v = _mm256_packus_epi32(v, v);
+			v = _mm256_packus_epi16(v, v);
+			A_u_long packedA = (A_u_long)_mm256_extract_epi32(v, 0);
+			A_u_long packedB = (A_u_long)_mm256_extract_epi32(v, 4);
+			memcpy(&out[a], &packedA, sizeof(packedA));
+			memcpy(&out[a + 1], &packedB, sizeof(packedB));
+		}
+	}
+
+	for (; i < count; i++) {
+		SamplePixelScalar<PF_Pixel, PF_MAX_CHAN8>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+REPTALL_TARGET_AVX2 static void
+SampleBatch16_AVX2(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_Pixel16			*out)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	A_long i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		float w00[8], w10[8], w01[8], w11[8];
+		ComputeWeights8_AVX2(batch, i, w00, w10, w01, w11);
+
+		for (A_long k = 0; k < 8; k += 2) {
+			A_long a = i + k;
+			const char *pa = srcData + batch->offset[a];
+			const char *pb = srcData + batch->offset[a + 1];
+
+			__m256 acc = Blend8_AVX2(LoadPair16_AVX2(pa, pb),
+									 LoadPair16_AVX2(pa + 8, pb + 8),
+									 LoadPair16_AVX2(pa + rowbytes, pb + rowbytes),
+									 LoadPair16_AVX2(pa + rowbytes + 8, pb + rowbytes + 8),
+									 w00, w10, w01, w11, k);
+
+			__m256i v = _mm256_cvttps_epi32(_mm256_add_ps(acc, half));
+			v = _mm256_packus_epi32(v, v);
+			_mm_storel_epi64((__m128i*)&out[a], _mm256_castsi256_si128(v));
+			_mm_storel_epi64((__m128i*)&out[a + 1], _mm256_extracti128_si256(v, 1));
+		}
+	}
+
+	for (; i < count; i++) {
+		SamplePixelScalar<PF_Pixel16, PF_MAX_CHAN16>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+REPTALL_TARGET_AVX2 static void
+SampleBatchFloat_AVX2(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_PixelFloat		*out)
+{
+	A_long i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		float w00[8], w10[8], w01[8], w11[8];
+		ComputeWeights8_AVX2(batch, i, w00, w10, w01, w11);
+
+		for (A_long k = 0; k < 8; k += 2) {
+			A_long a = i + k;
+			const char *pa = srcData + batch->offset[a];
+			const char *pb = srcData + batch->offset[a + 1];
+
+			__m256 acc = Blend8_AVX2(LoadPairFloat_AVX2(pa, pb),
+									 LoadPairFloat_AVX2(pa + 16, pb + 16),
+									 LoadPairFloat_AVX2(pa + rowbytes, pb + rowbytes),
+									 LoadPairFloat_AVX2(pa + rowbytes + 16, pb + rowbytes + 16),
+									 w00, w10, w01, w11, k);
+
+			_mm_storeu_ps((float*)&out[a], _mm256_castps256_ps128(acc));
+			_mm_storeu_ps((float*)&out[a + 1], _mm256_extractf128_ps(acc, 1));
+		}
+	}
+
+	for (; i < count; i++) {
+		SamplePixelScalar<PF_PixelFloat, 1>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+static const SampleKernels kAVX2Kernels = {
+	SAMPLE_KERNEL_AVX2,
+	SampleBatch8_AVX2,
+	SampleBatch16_AVX2,
+	SampleBatchFloat_AVX2
+};
+
+static SampleKernelLevel
+DetectKernelLevel(void)
+{
+#ifdef _MSC_VER
+	int info[4] = {0, 0, 0, 0};
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool avx2 = false;
+
+	// AVX2 also needs the OS to save the YMM state
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse41 = __builtin_cpu_supports("sse4.1") != 0;
+	bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+
+	if (avx2) return SAMPLE_KERNEL_AVX2;
+	if (sse41) return SAMPLE_KERNEL_SSE41;
+	return SAMPLE_KERNEL_SCALAR;
+}
+
+#endif // REPTALL_SIMD_X86
+
+#ifdef REPTALL_SIMD_NEON
+
+// ============================================================================
+// NEON kernels - one pixel (4 channels) per register, 4 pixels per loop
+// ============================================================================
+
+static inline float32x4_t
+Blend4_NEON(
+	float32x4_t	c00,
+	float32x4_t	c10,
+	float32x4_t	c01,
+	float32x4_t	c11,
+	float		w00,
+	float		w10,
+	float		w01,
+	float		w11)
+{
+	// vmulq_n/vaddq rather than vmlaq so no fused multiply-add is formed
+	float32x4_t acc = vaddq_f32(vmulq_n_f32(c00, w00), vmulq_n_f32(c10, w10));
+	acc = vaddq_f32(acc, vmulq_n_f32(c01, w01));
+	return vaddq_f32(acc, vmulq_n_f32(c11, w11));
+}
+
+static inline float32x4_t
+Load8_NEON(const char *p)
+{
+	uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32((uint32_t)LoadU32(p)));
+	return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(b))));
+}
+
+static inline float32x4_t
+Load16_NEON(const char *p)
+{
+	return vcvtq_f32_u32(vmovl_u16(vld1_u16((const uint16_t*)p)));
+}
+
+template<typename PixelType, int MaxChannelInt>
+static void
+SampleBatchNEONTmpl(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PixelType			*out)
+{
+	A_long i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		float w00[4], w10[4], w01[4], w11[4];
+		float32x4_t one = vdupq_n_f32(1.0f);
+		float32x4_t fx = vld1q_f32(&batch->fx[i]);
+		float32x4_t fy = vld1q_f32(&batch->fy[i]);
+		float32x4_t gx = vsubq_f32(one, fx);
+		float32x4_t gy = vsubq_f32(one, fy);
+		vst1q_f32(w00, vmulq_f32(gx, gy));
+		vst1q_f32(w10, vmulq_f32(fx, gy));
+		vst1q_f32(w01, vmulq_f32(gx, fy));
+		vst1q_f32(w11, vmulq_f32(fx, fy));
+
+		for (A_long k = 0; k < 4; k++) {
+			const char *p0 = srcData + batch->offset[i + k];
+			const char *p1 = p0 + rowbytes;
+
+			if constexpr (MaxChannelInt == 1) {
+				float32x4_t acc = Blend4_NEON(vld1q_f32((const float*)p0), vld1q_f32((const float*)(p0 + 16)),
+											  vld1q_f32((const float*)p1), vld1q_f32((const float*)(p1 + 16)),
+											  w00[k], w10[k], w01[k], w11[k]);
+				vst1q_f32((float*)&out[i + k], acc);
+			} else if constexpr (MaxChannelInt == PF_MAX_CHAN16) {
+				float32x4_t acc = Blend4_NEON(Load16_NEON(p0), Load16_NEON(p0 + 8),
+											  Load16_NEON(p1), Load16_NEON(p1 + 8),
+											  w00[k], w10[k], w01[k], w11[k]);
+				uint32x4_t v = vcvtq_u32_f32(vaddq_f32(acc, vdupq_n_f32(0.5f)));
+				vst1_u16((uint16_t*)&out[i + k], vmovn_u32(v));
+			} else {
+				float32x4_t acc = Blend4_NEON(Load8_NEON(p0), Load8_NEON(p0 + 4),
+											  Load8_NEON(p1), Load8_NEON(p1 + 4),
+											  w00[k], w10[k], w01[k], w11[k]);
+				uint32x4_t v = vcvtq_u32_f32(vaddq_f32(acc, vdupq_n_f32(0.5f)));
+				uint16x4_t h = vmovn_u32(v);
+				uint8x8_t b = vmovn_u16(vcombine_u16(h, h));
+				A_u_long packed = (A_u_long)vget_lane_u32(vreinterpret_u32_u8(b), 0);
+				memcpy(&out[i + k], &packed, sizeof(packed));
+			}
+		}
+	}
+
+	for (; i < count; i++) {
+		SamplePixelScalar<PixelType, MaxChannelInt>(srcData, rowbytes, batch, i, &out[i]);
+	}
+}
+
+static const SampleKernels kNEONKernels = {
+	SAMPLE_KERNEL_NEON,
+	SampleBatchNEONTmpl<PF_Pixel, PF_MAX_CHAN8>,
+	SampleBatchNEONTmpl<PF_Pixel16, PF_MAX_CHAN16>,
+	SampleBatchNEONTmpl<PF_PixelFloat, 1>
+};
+
+#endif // REPTALL_SIMD_NEON
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+static const SampleKernels*
+SelectSampleKernels(void)
+{
+	const char *force = getenv("REPTALL_FORCE_SCALAR");
+	if (force && force[0] && force[0] != '0') {
+		return &kScalarKernels;
+	}
+
+#if defined(REPTALL_SIMD_X86)
+	switch (DetectKernelLevel()) {
+		case SAMPLE_KERNEL_AVX2:	return &kAVX2Kernels;
+		case SAMPLE_KERNEL_SSE41:	return &kSSE41Kernels;
+		default:					break;
+	}
+#elif defined(REPTALL_SIMD_NEON)
+	// NEON is part of the ARMv8-A baseline
+	return &kNEONKernels;
+#endif
+
+	return &kScalarKernels;
+}
+
+const SampleKernels*
+GetSampleKernels(void)
+{
+	// Thread-safe one-time initialization (C++11 magic statics)
+	static const SampleKernels *kernels = SelectSampleKernels();
+	return kernels;
+}
+
+const SampleKernels*
+GetScalarSampleKernels(void)
+{
+	return &kScalarKernels;
+}
@@ -0,0 +1,98 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*
+	ReptAll_Sampling.h
+
+	Bilinear sampling kernels (scalar, SSE4.1, AVX2, NEON) with runtime
+	CPU dispatch.
+*/
+
+#ifndef REPTALL_SAMPLING_H
+#define REPTALL_SAMPLING_H
+
+#include "ReptAll_Types.h"
+#include <cstddef>
+
+// Largest number of output pixels handed to a sampling kernel in one call
+#define SAMPLE_BATCH_MAX	64
+
+// Bilinear tap positions for a batch of output pixels
+// The caller resolves each sample position (in double precision) into the
+// byte offset of its top-left tap plus single-precision fractions. Sources
+// are padded (see SourceMipPyramid), so every offset has a readable 2x2
+// quad: lanes outside the source point at an all-zero quad and sample
+// transparent without any per-lane test in the kernels.
+struct SampleBatch {
+	std::ptrdiff_t	offset[SAMPLE_BATCH_MAX];   // byte offset of tap (x0, y0)
+	float			fx[SAMPLE_BATCH_MAX];       // x - x0
+	float			fy[SAMPLE_BATCH_MAX];       // y - y0
+};
+
+// Instruction set used by the active kernels
+enum SampleKernelLevel {
+	SAMPLE_KERNEL_SCALAR = 0,
+	SAMPLE_KERNEL_SSE41,
+	SAMPLE_KERNEL_AVX2,
+	SAMPLE_KERNEL_NEON
+};
+
+// Samples count (<= SAMPLE_BATCH_MAX) pixels of batch into out
+typedef void (*SampleBatch8Func)(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_Pixel			*out);
+
+typedef void (*SampleBatch16Func)(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_Pixel16			*out);
+
+typedef void (*SampleBatchFloatFunc)(
+	const char			*srcData,
+	A_long				rowbytes,
+	const SampleBatch	*batch,
+	A_long				count,
+	PF_PixelFloat		*out);
+
+struct SampleKernels {
+	SampleKernelLevel		level;
+	SampleBatch8Func		sample8;
+	SampleBatch16Func		sample16;
+	SampleBatchFloatFunc	sampleFloat;
+};
+
+// Kernels for the best instruction set this CPU supports
+// Detected once and immutable afterwards, so safe to share between MFR
+// render threads. Setting the environment variable REPTALL_FORCE_SCALAR=1
+// selects the scalar reference kernels for verification.
+const SampleKernels*
+GetSampleKernels(void);
+
+// Scalar reference kernels, always available
+const SampleKernels*
+GetScalarSampleKernels(void);
+
+#endif // REPTALL_SAMPLING_H
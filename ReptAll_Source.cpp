@@ -0,0 +1,444 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*	ReptAll_Source.cpp
+
+	Source layer preprocessing shared by all copies of a render.
+*/
+
+#include "ReptAll_Source.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#ifdef _MSC_VER
+// Suppress C4984: 'if constexpr' is a C++17 language extension
+#pragma warning(disable : 4984)
+#elif defined(__clang__)
+#pragma clang diagnostic ignored "-Wc++17-extensions"
+#endif
+
+A_long
+GetSourceMipLevelLimit(
+	A_long	width,
+	A_long	height)
+{
+	A_long level = 0;
+
+	while (level < SOURCE_MIP_MAX_LEVEL) {
+		A_long w = (width + (1 << (level + 1)) - 1) >> (level + 1);
+		A_long h = (height + (1 << (level + 1)) - 1) >> (level + 1);
+		if (w < 2 || h < 2) {
+			break;
+		}
+		level++;
+	}
+
+	return level;
+}
+
+// 2x2 box filter of padded srcP into the texels of dstP inside rect
+// (dstP is ceil(w/2) x ceil(h/2)). Taps past the source edge read the
+// transparent apron, so edge texels stay premultiplied-correct rather than
+// smearing the border outward.
+template<typename PixelType, int MaxChannelInt>
+static void
+DownsampleLevelTmpl(
+	const PF_EffectWorld	*srcP,
+	const PF_LRect&			rect,
+	PF_EffectWorld			*dstP)
+{
+	typedef decltype(PixelType().alpha) ChannelType;
+
+	for (A_long y = rect.top; y < rect.bottom; y++) {
+		const PixelType *row0 = (const PixelType*)((const char*)srcP->data + (y * 2) * srcP->rowbytes);
+		const PixelType *row1 = (const PixelType*)((const char*)row0 + srcP->rowbytes);
+		PixelType *dstRow = (PixelType*)((char*)dstP->data + y * dstP->rowbytes);
+
+		for (A_long x = rect.left; x < rect.right; x++) {
+			const PixelType& p00 = row0[x * 2];
+			const PixelType& p10 = row0[x * 2 + 1];
+			const PixelType& p01 = row1[x * 2];
+			const PixelType& p11 = row1[x * 2 + 1];
+
+			if constexpr (MaxChannelInt == 1) {
+				dstRow[x].alpha = (((p00.alpha + p10.alpha) + p01.alpha) + p11.alpha) * 0.25f;
+				dstRow[x].red   = (((p00.red + p10.red) + p01.red) + p11.red) * 0.25f;
+				dstRow[x].green = (((p00.green + p10.green) + p01.green) + p11.green) * 0.25f;
+				dstRow[x].blue  = (((p00.blue + p10.blue) + p01.blue) + p11.blue) * 0.25f;
+			} else {
+				// Round to nearest
+				dstRow[x].alpha = (ChannelType)(((A_u_long)p00.alpha + p10.alpha + p01.alpha + p11.alpha + 2) >> 2);
+				dstRow[x].red   = (ChannelType)(((A_u_long)p00.red + p10.red + p01.red + p11.red + 2) >> 2);
+				dstRow[x].green = (ChannelType)(((A_u_long)p00.green + p10.green + p01.green + p11.green + 2) >> 2);
+				dstRow[x].blue  = (ChannelType)(((A_u_long)p00.blue + p10.blue + p01.blue + p11.blue + 2) >> 2);
+			}
+		}
+	}
+}
+
+// Copy the pixels of srcP inside rect into padded dstP
+static void
+CopyLevelRect(
+	const PF_EffectWorld	*srcP,
+	const PF_LRect&			rect,
+	A_long					pixelSize,
+	PF_EffectWorld			*dstP)
+{
+	for (A_long y = rect.top; y < rect.bottom; y++) {
+		memcpy((char*)dstP->data + y * dstP->rowbytes + rect.left * pixelSize,
+			   (const char*)srcP->data + y * srcP->rowbytes + rect.left * pixelSize,
+			   (size_t)(rect.right - rect.left) * pixelSize);
+	}
+}
+
+// Zeroed padded buffer for a width x height level in storage; world gets
+// the geometry and points data at its pixel (0, 0)
+static PF_Err
+AllocatePaddedLevel(
+	A_long				width,
+	A_long				height,
+	A_long				pixelSize,
+	std::vector<char>	*storage,
+	PF_EffectWorld		*world)
+{
+	const A_long rowbytes = ((width + 2 * SOURCE_APRON) * pixelSize + SOURCE_ROW_ALIGN - 1) / SOURCE_ROW_ALIGN * SOURCE_ROW_ALIGN;
+	const size_t rows = (size_t)height + 2 * SOURCE_APRON + 1;
+
+	try {
+		storage->assign(rows * rowbytes + SOURCE_ROW_ALIGN, 0);
+	} catch (const std::bad_alloc&) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	const std::uintptr_t base = (std::uintptr_t)storage->data();
+	char *aligned = storage->data() + (SOURCE_ROW_ALIGN - base % SOURCE_ROW_ALIGN) % SOURCE_ROW_ALIGN;
+
+	world->width = width;
+	world->height = height;
+	world->rowbytes = rowbytes;
+	world->data = (PF_PixelPtr)(aligned + SOURCE_APRON * rowbytes + SOURCE_APRON * pixelSize);
+
+	return PF_Err_NONE;
+}
+
+namespace {
+
+struct SourceCoverageEntry {
+	SourceFrameKey		key;
+	SourceCoverageRef	coverage;
+	A_u_longlong		lastUse;
+};
+
+std::mutex							g_coverageMutex;
+std::vector<SourceCoverageEntry>	g_coverageEntries;
+A_u_longlong						g_coverageTick = 0;
+
+bool
+FrameKeysEqual(
+	const SourceFrameKey&	a,
+	const SourceFrameKey&	b)
+{
+	return memcmp(&a.state, &b.state, sizeof(PF_State)) == 0 &&
+		   a.origin[0] == b.origin[0] && a.origin[1] == b.origin[1] &&
+		   a.width == b.width && a.height == b.height && a.depth == b.depth &&
+		   a.downsample[0].num == b.downsample[0].num && a.downsample[0].den == b.downsample[0].den &&
+		   a.downsample[1].num == b.downsample[1].num && a.downsample[1].den == b.downsample[1].den;
+}
+
+} // namespace
+
+// Close row y of coverage with the runs in row (sorted and disjoint)
+static void
+AppendCoverageRow(
+	std::vector<SourceRun>&	row,
+	A_long					y,
+	SourceCoverage			*coverage)
+{
+	if ((A_long)row.size() > SOURCE_COVERAGE_MAX_ROW_RUNS) {
+		SourceRun all = {row.front().begin, row.back().end};
+		row.assign(1, all);
+	}
+
+	coverage->runs.insert(coverage->runs.end(), row.begin(), row.end());
+	coverage->rowStart[y + 1] = (A_long)coverage->runs.size();
+}
+
+// Non-zero alpha runs of every row of srcP
+// Float alpha counts unless it is <= 0, which the compositors skip anyway.
+template<typename PixelType, int MaxChannelInt>
+static void
+ScanCoverageTmpl(
+	const PF_EffectWorld	*srcP,
+	SourceCoverage			*coverage)
+{
+	std::vector<SourceRun> row;
+	PF_LRect& bounds = coverage->bounds;
+
+	for (A_long y = 0; y < srcP->height; y++) {
+		const PixelType *pixels = (const PixelType*)((const char*)srcP->data + y * srcP->rowbytes);
+		A_long x = 0;
+
+		row.clear();
+		while (x < srcP->width) {
+			if constexpr (MaxChannelInt == 1) {
+				while (x < srcP->width && pixels[x].alpha <= 0.0f) x++;
+			} else {
+				while (x < srcP->width && pixels[x].alpha == 0) x++;
+			}
+			if (x >= srcP->width) {
+				break;
+			}
+
+			SourceRun run;
+			run.begin = x;
+			if constexpr (MaxChannelInt == 1) {
+				while (x < srcP->width && !(pixels[x].alpha <= 0.0f)) x++;
+			} else {
+				while (x < srcP->width && pixels[x].alpha != 0) x++;
+			}
+			run.end = x;
+			row.push_back(run);
+		}
+
+		if (!row.empty()) {
+			bounds.left = std::min(bounds.left, row.front().begin);
+			bounds.right = std::max(bounds.right, row.back().end);
+			bounds.top = std::min(bounds.top, y);
+			bounds.bottom = y + 1;
+		}
+		AppendCoverageRow(row, y, coverage);
+	}
+}
+
+PF_Err
+BuildSourceCoverage(
+	const PF_EffectWorld	*srcP,
+	PF_Boolean				floatB,
+	PF_Boolean				deepB,
+	SourceCoverage			*coverage)
+{
+	if (!srcP || !coverage) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	coverage->width = srcP->width;
+	coverage->height = srcP->height;
+	coverage->bounds.left = srcP->width;
+	coverage->bounds.top = srcP->height;
+	coverage->bounds.right = 0;
+	coverage->bounds.bottom = 0;
+
+	try {
+		coverage->rowStart.assign(srcP->height + 1, 0);
+		coverage->runs.clear();
+
+		if (floatB) {
+			ScanCoverageTmpl<PF_PixelFloat, 1>(srcP, coverage);
+		} else if (deepB) {
+			ScanCoverageTmpl<PF_Pixel16, PF_MAX_CHAN16>(srcP, coverage);
+		} else {
+			ScanCoverageTmpl<PF_Pixel, PF_MAX_CHAN8>(srcP, coverage);
+		}
+	} catch (const std::bad_alloc&) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	if (coverage->bounds.right <= coverage->bounds.left) {
+		coverage->bounds.left = coverage->bounds.top = 0;
+		coverage->bounds.right = coverage->bounds.bottom = 0;
+	}
+
+	return PF_Err_NONE;
+}
+
+// Coverage of the next mip level: texel (x, y) may be non-zero if any of
+// parent pixels (2x..2x+1, 2y..2y+1) is
+static void
+DownsampleCoverage(
+	const SourceCoverage&	parent,
+	SourceCoverage			*coverage)
+{
+	coverage->width = (parent.width + 1) / 2;
+	coverage->height = (parent.height + 1) / 2;
+	coverage->bounds.left = parent.bounds.left / 2;
+	coverage->bounds.top = parent.bounds.top / 2;
+	coverage->bounds.right = (parent.bounds.right + 1) / 2;
+	coverage->bounds.bottom = (parent.bounds.bottom + 1) / 2;
+	coverage->rowStart.assign(coverage->height + 1, 0);
+	coverage->runs.clear();
+
+	std::vector<SourceRun> row;
+
+	for (A_long y = 0; y < coverage->height; y++) {
+		const A_long py = y * 2;
+		const SourceRun *a = parent.runs.data() + parent.rowStart[py];
+		const SourceRun *aEnd = parent.runs.data() + parent.rowStart[py + 1];
+		const SourceRun *b = aEnd;
+		const SourceRun *bEnd = aEnd;
+		if (py + 1 < parent.height) {
+			b = parent.runs.data() + parent.rowStart[py + 1];
+			bEnd = parent.runs.data() + parent.rowStart[py + 2];
+		}
+
+		// Merge both sorted rows, halving and coalescing as we go
+		row.clear();
+		while (a < aEnd || b < bEnd) {
+			const SourceRun *next = (b >= bEnd || (a < aEnd && a->begin <= b->begin)) ? a++ : b++;
+			SourceRun run = {next->begin / 2, (next->end + 1) / 2};
+
+			if (!row.empty() && run.begin <= row.back().end) {
+				row.back().end = std::max(row.back().end, run.end);
+			} else {
+				row.push_back(run);
+			}
+		}
+
+		AppendCoverageRow(row, y, coverage);
+	}
+}
+
+PF_Err
+BuildSourceMipPyramid(
+	PF_EffectWorld				*srcP,
+	PF_Boolean					floatB,
+	PF_Boolean					deepB,
+	A_long						maxLevel,
+	const SourceCoverageRef&	coverage,
+	SourceMipPyramid			*pyramid)
+{
+	PF_Err err = PF_Err_NONE;
+
+	if (!srcP || !coverage || !pyramid) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+
+	const A_long pixelSize = floatB ? (A_long)sizeof(PF_PixelFloat) :
+							 deepB ? (A_long)sizeof(PF_Pixel16) : (A_long)sizeof(PF_Pixel);
+
+	// Level 0: only the alpha bounds hold non-zero pixels
+	pyramid->level[0] = *srcP;
+	ERR(AllocatePaddedLevel(srcP->width, srcP->height, pixelSize, &pyramid->storage[0], &pyramid->level[0]));
+	if (err) {
+		return err;
+	}
+	CopyLevelRect(srcP, coverage->bounds, pixelSize, &pyramid->level[0]);
+	pyramid->coverage[0] = coverage;
+	pyramid->levelCount = 1;
+
+	maxLevel = std::min(maxLevel, GetSourceMipLevelLimit(srcP->width, srcP->height));
+
+	for (A_long l = 1; l <= maxLevel && !err; l++) {
+		const PF_EffectWorld& parent = pyramid->level[l - 1];
+		PF_EffectWorld& world = pyramid->level[l];
+
+		world = parent;
+		ERR(AllocatePaddedLevel((parent.width + 1) / 2, (parent.height + 1) / 2, pixelSize, &pyramid->storage[l], &world));
+
+		// Texels outside the level's alpha bounds stay zero
+		std::shared_ptr<SourceCoverage> levelCoverage;
+		if (!err) {
+			try {
+				levelCoverage = std::make_shared<SourceCoverage>();
+				DownsampleCoverage(*pyramid->coverage[l - 1], levelCoverage.get());
+			} catch (const std::bad_alloc&) {
+				err = PF_Err_OUT_OF_MEMORY;
+			}
+		}
+
+		if (!err) {
+			if (floatB) {
+				DownsampleLevelTmpl<PF_PixelFloat, 1>(&parent, levelCoverage->bounds, &world);
+			} else if (deepB) {
+				DownsampleLevelTmpl<PF_Pixel16, PF_MAX_CHAN16>(&parent, levelCoverage->bounds, &world);
+			} else {
+				DownsampleLevelTmpl<PF_Pixel, PF_MAX_CHAN8>(&parent, levelCoverage->bounds, &world);
+			}
+
+			pyramid->coverage[l] = levelCoverage;
+			pyramid->levelCount = l + 1;
+		}
+	}
+
+	return err;
+}
+
+SourceCoverageRef
+LookupSourceCoverage(const SourceFrameKey& key)
+{
+	std::lock_guard<std::mutex> lock(g_coverageMutex);
+
+	for (SourceCoverageEntry& entry : g_coverageEntries) {
+		if (FrameKeysEqual(entry.key, key)) {
+			entry.lastUse = ++g_coverageTick;
+			return entry.coverage;
+		}
+	}
+
+	return SourceCoverageRef();
+}
+
+void
+StoreSourceCoverage(
+	const SourceFrameKey&		key,
+	const SourceCoverageRef&	coverage)
+{
+	if (!coverage) {
+		return;
+	}
+
+	SourceCoverageEntry entry;
+	entry.key = key;
+	entry.coverage = coverage;
+
+	std::lock_guard<std::mutex> lock(g_coverageMutex);
+	entry.lastUse = ++g_coverageTick;
+
+	// Another render may have stored the same frame meanwhile
+	for (SourceCoverageEntry& existing : g_coverageEntries) {
+		if (FrameKeysEqual(existing.key, key)) {
+			existing = entry;
+			return;
+		}
+	}
+
+	if (g_coverageEntries.size() >= SOURCE_COVERAGE_CACHE_ENTRIES) {
+		size_t oldest = 0;
+		for (size_t i = 1; i < g_coverageEntries.size(); i++) {
+			if (g_coverageEntries[i].lastUse < g_coverageEntries[oldest].lastUse) {
+				oldest = i;
+			}
+		}
+		g_coverageEntries[oldest] = entry;
+		return;
+	}
+
+	g_coverageEntries.push_back(entry);
+}
+
+void
+ClearSourceCoverageCache(void)
+{
+	std::lock_guard<std::mutex> lock(g_coverageMutex);
+	g_coverageEntries.clear();
+}
@@ -0,0 +1,162 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*
+	ReptAll_Source.h
+
+	Derived representations of the source layer: the mip pyramid for
+	minified copies, built once per render, and the alpha coverage index,
+	cached across renders of the same source frame.
+*/
+
+#ifndef REPTALL_SOURCE_H
+#define REPTALL_SOURCE_H
+
+#include "ReptAll_Types.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Deepest mip level ever built (1/4096 of the source size)
+#define SOURCE_MIP_MAX_LEVEL	12
+
+// Transparent border around every padded pyramid level
+#define SOURCE_APRON			1
+
+// Row stride and start of padded levels are multiples of this many bytes
+#define SOURCE_ROW_ALIGN		64
+
+// Rows with more alpha runs than this are indexed as one run spanning them
+#define SOURCE_COVERAGE_MAX_ROW_RUNS	64
+
+// Source frames whose coverage is kept for later renders
+#define SOURCE_COVERAGE_CACHE_ENTRIES	8
+
+// Half-open run [begin, end) of source columns
+struct SourceRun {
+	A_long	begin;
+	A_long	end;
+};
+
+// Where a source buffer has non-zero alpha
+// bounds is the alpha bounding box (empty when the buffer is transparent).
+// The runs of row y are runs[rowStart[y]] .. runs[rowStart[y + 1] - 1],
+// sorted and disjoint. The index may over-cover (mip levels, rows with many
+// runs) but never misses a pixel with alpha; premultiplied pixels outside it
+// are zero in every channel.
+struct SourceCoverage {
+	A_long					width;
+	A_long					height;
+	PF_LRect				bounds;
+	std::vector<A_long>		rowStart;     // height + 1 entries
+	std::vector<SourceRun>	runs;
+};
+
+// Immutable, shareable coverage of one source buffer
+typedef std::shared_ptr<const SourceCoverage> SourceCoverageRef;
+
+// Identity of a source frame for the coverage cache
+// state is PF_GetCurrentState of the layer parameter over the rendered
+// frame; the rest pins down the buffer it was checked out into.
+struct SourceFrameKey {
+	PF_State		state;
+	A_long			origin[2];    // layer position of buffer pixel (0,0)
+	A_long			width;
+	A_long			height;
+	A_long			depth;        // 8, 16 or 32 bits per channel
+	PF_RationalScale	downsample[2];
+};
+
+// Premultiplied mip chain of a source buffer, 2x2 box filtered per level
+// Level 0 is a copy of the source. Level l is ceil(w / 2^l) x ceil(h / 2^l)
+// and its texel i covers level-0 pixels [i * 2^l, (i + 1) * 2^l); pixels
+// past the source edge count as transparent.
+// Every level is padded: data points at pixel (0, 0) of a buffer with a
+// transparent apron of SOURCE_APRON pixels on each side and one more
+// transparent row below it. Bilinear taps of any position in
+// [-1, w) x [-1, h) stay inside the buffer, so edges fade out over one
+// pixel, and the all-zero quad at (-1, h) is where samples outside the
+// source read from (see GetSourceNullQuadOffset).
+struct SourceMipPyramid {
+	PF_EffectWorld		level[SOURCE_MIP_MAX_LEVEL + 1];
+	std::vector<char>	storage[SOURCE_MIP_MAX_LEVEL + 1];
+	SourceCoverageRef	coverage[SOURCE_MIP_MAX_LEVEL + 1];
+	A_long				levelCount;       // levels built, >= 1
+
+	SourceMipPyramid() : levelCount(0) {}
+};
+
+// Deepest level a width x height source supports
+// Every level keeps at least 2x2 pixels so bilinear sampling has a quad.
+A_long
+GetSourceMipLevelLimit(
+	A_long	width,
+	A_long	height);
+
+// Byte offset from pixel (0, 0) of the all-zero 2x2 quad of a padded level
+inline std::ptrdiff_t
+GetSourceNullQuadOffset(
+	const PF_EffectWorld&	level,
+	A_long					pixelSize)
+{
+	return (std::ptrdiff_t)level.height * level.rowbytes - pixelSize;
+}
+
+// Copy srcP into padded level 0 and build levels 1..maxLevel (clamped to
+// GetSourceMipLevelLimit). coverage is the index of srcP; each level gets
+// one derived from it, and only pixels inside a level's alpha bounds are
+// copied or filtered (the rest are 0).
+PF_Err
+BuildSourceMipPyramid(
+	PF_EffectWorld				*srcP,
+	PF_Boolean					floatB,
+	PF_Boolean					deepB,
+	A_long						maxLevel,
+	const SourceCoverageRef&	coverage,
+	SourceMipPyramid			*pyramid);
+
+// Scan the alpha channel of srcP into its coverage index
+PF_Err
+BuildSourceCoverage(
+	const PF_EffectWorld	*srcP,
+	PF_Boolean				floatB,
+	PF_Boolean				deepB,
+	SourceCoverage			*coverage);
+
+// Coverage cache shared by all effect instances and render threads
+// A source frame is indexed once and reused while the host reports the
+// layer unchanged. All functions are thread-safe.
+
+// Returns the cached coverage of key, or an empty pointer
+SourceCoverageRef
+LookupSourceCoverage(const SourceFrameKey& key);
+
+// Records the coverage computed for key
+void
+StoreSourceCoverage(
+	const SourceFrameKey&		key,
+	const SourceCoverageRef&	coverage);
+
+// Drops all entries
+void
+ClearSourceCoverageCache(void);
+
+#endif // REPTALL_SOURCE_H
@@ -0,0 +1,319 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Stats.cpp
+*/
+
+#include "ReptAll_Stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+static const char *kPhaseNames[RENDER_PHASE_COUNT] = {
+	"Parameters", "Transforms", "DepthSort", "RenderCopies"
+};
+
+A_u_longlong
+GetStatsClock(void)
+{
+	return (A_u_longlong)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char*
+GetTracePath(void)
+{
+	// Thread-safe one-time initialization (C++11 magic statics)
+	static const std::string path = [] {
+		const char *value = getenv("REPTALL_TRACE");
+		return std::string(value ? value : "");
+	}();
+	return path.empty() ? NULL : path.c_str();
+}
+
+PF_Boolean
+IsRenderStatsOverlayEnabled(void)
+{
+	static const PF_Boolean enabled = [] {
+		const char *value = getenv("REPTALL_STATS_OVERLAY");
+		return (PF_Boolean)(value && value[0] && value[0] != '0');
+	}();
+	return enabled;
+}
+
+PF_Boolean
+IsRenderStatsEnabled(void)
+{
+	return GetTracePath() != NULL || IsRenderStatsOverlayEnabled();
+}
+
+// ============================================================================
+// Chrome trace
+// ============================================================================
+
+static std::mutex g_traceMutex;
+
+void
+AppendRenderTrace(
+	const char			*label,
+	const RenderStats&	stats)
+{
+	const char *path = GetTracePath();
+	if (!path) {
+		return;
+	}
+
+	const unsigned long long tid = (unsigned long long)(std::hash<std::thread::id>()(std::this_thread::get_id()) & 0xFFFFFFFF);
+	std::lock_guard<std::mutex> lock(g_traceMutex);
+
+	FILE *fp = fopen(path, "a");
+	if (!fp) {
+		return;
+	}
+
+	// New files open the event array; it stays unterminated so later
+	// renders, and other processes, can keep appending
+	fseek(fp, 0, SEEK_END);
+	if (ftell(fp) == 0) {
+		fputs("[\n", fp);
+	}
+
+	A_u_longlong last = 0;
+	for (int p = 0; p < RENDER_PHASE_COUNT; p++) {
+		if (!stats.phaseStart[p]) {
+			continue;
+		}
+		fprintf(fp, "{\"name\": \"%s\", \"cat\": \"reptall\", \"ph\": \"X\", \"ts\": %llu, \"dur\": %llu, "
+				"\"pid\": 1, \"tid\": %llu, \"args\": {\"command\": \"%s\"",
+				kPhaseNames[p], (unsigned long long)stats.phaseStart[p],
+				(unsigned long long)stats.phaseDuration[p], tid, label);
+		if (p == RENDER_PHASE_TRANSFORMS || p == RENDER_PHASE_SORT) {
+			fprintf(fp, ", \"cached\": %s", stats.transformsCached ? "true" : "false");
+		}
+		fputs("}},\n", fp);
+		last = std::max(last, stats.phaseStart[p] + stats.phaseDuration[p]);
+	}
+
+	// Counters are known once the copies are rendered
+	if (stats.phaseStart[RENDER_PHASE_RENDER]) {
+		fprintf(fp, "{\"name\": \"ReptAll\", \"cat\": \"reptall\", \"ph\": \"C\", \"ts\": %llu, \"pid\": 1, "
+				"\"args\": {\"copies_computed\": %d, \"copies_culled\": %d, \"copies_rendered\": %d, "
+				"\"copies_splatted\": %d, \"copies_blurred\": %d, \"copies_shifted\": %d, \"pixels_sampled\": %llu, \"pixels_composited\": %llu, \"rows_aborted\": %d}},\n",
+				(unsigned long long)last, (int)stats.copiesComputed, (int)stats.copiesCulled,
+				(int)stats.copiesRendered, (int)stats.copiesSplatted, (int)stats.copiesBlurred, (int)stats.copiesShifted,
+				(unsigned long long)stats.pixelsSampled,
+				(unsigned long long)stats.pixelsComposited, (int)stats.rowsAborted);
+	}
+
+	fclose(fp);
+}
+
+// ============================================================================
+// Overlay
+// ============================================================================
+
+#define OVERLAY_GLYPH_W		5
+#define OVERLAY_GLYPH_H		7
+#define OVERLAY_ADVANCE		(OVERLAY_GLYPH_W + 1)
+#define OVERLAY_LINE		(OVERLAY_GLYPH_H + 3)
+#define OVERLAY_MARGIN		4
+#define OVERLAY_COLUMNS		112     // characters per line; longer lines are cut
+#define OVERLAY_LINES		3
+
+// 5x7 glyphs, one byte per row, bit 4 = leftmost column
+static const A_u_char kDigitGlyphs[10][OVERLAY_GLYPH_H] = {
+	{0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E},
+	{0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},
+	{0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F},
+	{0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},
+	{0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02},
+	{0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},
+	{0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E},
+	{0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+	{0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E},
+	{0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}
+};
+
+static const A_u_char kLetterGlyphs[26][OVERLAY_GLYPH_H] = {
+	{0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11},    // A
+	{0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},
+	{0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},
+	{0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},
+	{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},
+	{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},
+	{0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},
+	{0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
+	{0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},
+	{0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},
+	{0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},
+	{0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},
+	{0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},
+	{0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+	{0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+	{0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},
+	{0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},
+	{0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},
+	{0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},
+	{0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+	{0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+	{0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},
+	{0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},
+	{0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},
+	{0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04},
+	{0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}     // Z
+};
+
+static const A_u_char kDotGlyph[OVERLAY_GLYPH_H] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C};
+
+// Glyph of c (upper case letters, digits and '.'), NULL for a blank
+static const A_u_char*
+GetOverlayGlyph(char c)
+{
+	if (c >= '0' && c <= '9') return kDigitGlyphs[c - '0'];
+	if (c >= 'A' && c <= 'Z') return kLetterGlyphs[c - 'A'];
+	if (c >= 'a' && c <= 'z') return kLetterGlyphs[c - 'a'];
+	if (c == '.') return kDotGlyph;
+	return NULL;
+}
+
+// One glyph pixel per 540 layer rows, so the text reads the same at any size
+static A_long
+GetOverlayScale(A_long layerHeight)
+{
+	return std::max<A_long>(1, layerHeight / 540);
+}
+
+// Darkens the layer-space box to 40% and writes the lines in white; output
+// pixel (0, 0) is at layer position origin, scale is the size of one glyph
+// pixel
+template<typename PixelType, int MaxChannelInt>
+static void
+DrawOverlayTmpl(
+	PF_EffectWorld			*output,
+	const A_long			origin[2],
+	const PF_LRect&			box,
+	const std::string		*lines,
+	A_long					lineCount,
+	A_long					scale)
+{
+	typedef decltype(PixelType().alpha) ChannelType;
+	const ChannelType maxChan = (ChannelType)MaxChannelInt;
+
+	const A_long left = std::max(box.left, origin[0]);
+	const A_long top = std::max(box.top, origin[1]);
+	const A_long right = std::min(box.right, origin[0] + output->width);
+	const A_long bottom = std::min(box.bottom, origin[1] + output->height);
+
+	for (A_long y = top; y < bottom; y++) {
+		PixelType *row = (PixelType*)((char*)output->data + (std::ptrdiff_t)(y - origin[1]) * output->rowbytes) - origin[0];
+		const A_long gy = y / scale - OVERLAY_MARGIN;
+		const A_long line = gy >= 0 ? gy / OVERLAY_LINE : -1;
+		const A_long glyphRow = gy - line * OVERLAY_LINE;
+
+		for (A_long x = left; x < right; x++) {
+			PixelType& p = row[x];
+			const A_long gx = x / scale - OVERLAY_MARGIN;
+			bool ink = false;
+
+			if (line >= 0 && line < lineCount && glyphRow < OVERLAY_GLYPH_H && gx >= 0) {
+				const size_t ch = (size_t)(gx / OVERLAY_ADVANCE);
+				const A_long col = gx - (A_long)ch * OVERLAY_ADVANCE;
+				const A_u_char *glyph = ch < lines[line].size() ? GetOverlayGlyph(lines[line][ch]) : NULL;
+				ink = glyph && col < OVERLAY_GLYPH_W && ((glyph[glyphRow] >> (OVERLAY_GLYPH_W - 1 - col)) & 1);
+			}
+
+			if (ink) {
+				p.alpha = p.red = p.green = p.blue = maxChan;
+			} else {
+				// Premultiplied "over" of 60% black
+				p.alpha = (ChannelType)(p.alpha * 0.4f + MaxChannelInt * 0.6f);
+				p.red = (ChannelType)(p.red * 0.4f);
+				p.green = (ChannelType)(p.green * 0.4f);
+				p.blue = (ChannelType)(p.blue * 0.4f);
+			}
+		}
+	}
+}
+
+void
+GetRenderStatsOverlayRect(
+	A_long				layerWidth,
+	A_long				layerHeight,
+	PF_LRect			*rect)
+{
+	const A_long scale = GetOverlayScale(layerHeight);
+
+	rect->left = 0;
+	rect->top = 0;
+	rect->right = std::min<A_long>(layerWidth, (2 * OVERLAY_MARGIN + OVERLAY_COLUMNS * OVERLAY_ADVANCE) * scale);
+	rect->bottom = std::min<A_long>(layerHeight, (2 * OVERLAY_MARGIN + OVERLAY_LINES * OVERLAY_LINE) * scale);
+}
+
+void
+DrawRenderStatsOverlay(
+	const RenderStats&	stats,
+	A_long				depth,
+	A_long				layerWidth,
+	A_long				layerHeight,
+	const A_long		origin[2],
+	PF_EffectWorld		*output)
+{
+	if (!output || !output->data || output->width <= 0 || output->height <= 0) {
+		return;
+	}
+
+	char buffer[256];
+	std::string lines[OVERLAY_LINES];
+
+	snprintf(buffer, sizeof(buffer), "PARAMS %.3f  TRANSFORMS %.3f  SORT %.3f  RENDER %.3f MS",
+			 stats.phaseDuration[RENDER_PHASE_PARAMS] / 1000.0,
+			 stats.phaseDuration[RENDER_PHASE_TRANSFORMS] / 1000.0,
+			 stats.phaseDuration[RENDER_PHASE_SORT] / 1000.0,
+			 stats.phaseDuration[RENDER_PHASE_RENDER] / 1000.0);
+	lines[0] = buffer;
+	snprintf(buffer, sizeof(buffer), "COPIES %d  CULLED %d  RENDERED %d  SPLATTED %d  BLURRED %d  SHIFTED %d%s",
+			 (int)stats.copiesComputed, (int)stats.copiesCulled, (int)stats.copiesRendered,
+			 (int)stats.copiesSplatted, (int)stats.copiesBlurred, (int)stats.copiesShifted, stats.transformsCached ? "  CACHED" : "");
+	lines[1] = buffer;
+	snprintf(buffer, sizeof(buffer), "SAMPLED %llu  COMPOSITED %llu  ABORTED ROWS %d",
+			 (unsigned long long)stats.pixelsSampled, (unsigned long long)stats.pixelsComposited,
+			 (int)stats.rowsAborted);
+	lines[2] = buffer;
+
+	PF_LRect box;
+	GetRenderStatsOverlayRect(layerWidth, layerHeight, &box);
+	const A_long scale = GetOverlayScale(layerHeight);
+
+	if (depth == 32) {
+		DrawOverlayTmpl<PF_PixelFloat, 1>(output, origin, box, lines, OVERLAY_LINES, scale);
+	} else if (depth == 16) {
+		DrawOverlayTmpl<PF_Pixel16, PF_MAX_CHAN16>(output, origin, box, lines, OVERLAY_LINES, scale);
+	} else {
+		DrawOverlayTmpl<PF_Pixel, PF_MAX_CHAN8>(output, origin, box, lines, OVERLAY_LINES, scale);
+	}
+}
@@ -0,0 +1,145 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Stats.h
+
+	Render instrumentation: phase timers and counters, written as Chrome
+	trace events when REPTALL_TRACE names a file, and drawn over the output
+	when REPTALL_STATS_OVERLAY=1. With neither set the render passes NULL
+	stats and pays one pointer test per phase.
+*/
+
+#ifndef REPTALL_STATS_H
+#define REPTALL_STATS_H
+
+#include "ReptAll_Types.h"
+
+// Timed phases, numbered as in ReptAll.cpp
+enum RenderPhase {
+	RENDER_PHASE_PARAMS = 0,      // 1: parameters into ReptAllState
+	RENDER_PHASE_TRANSFORMS,      // 2: camera and copy transforms
+	RENDER_PHASE_SORT,            // 3: depth order
+	RENDER_PHASE_RENDER,          // 4: compositing
+	RENDER_PHASE_COUNT
+};
+
+// Timings and counters of one render
+// Times are microseconds of GetStatsClock; a phase that did not run has
+// duration 0 and start 0.
+struct RenderStats {
+	A_u_longlong	phaseStart[RENDER_PHASE_COUNT];
+	A_u_longlong	phaseDuration[RENDER_PHASE_COUNT];
+	A_long			copiesComputed;       // copies of the grid
+	A_long			copiesCulled;         // invisible, or nothing in the output
+	A_long			copiesRendered;       // composited into the output
+	A_long			copiesSplatted;       // of those, drawn as sub-pixel splats
+	A_long			copiesBlurred;        // of those, sampled over the shutter
+	A_long			copiesShifted;        // of those, pure translations of their source
+	A_u_longlong	pixelsSampled;        // pixels run through the sampling kernels
+	A_u_longlong	pixelsComposited;     // of those, pixels inside a copy's source
+	A_long			rowsAborted;          // output rows left undone by a cancel or error
+	A_Boolean		transformsCached;     // phases 2-3 came from the transform cache
+
+	void Clear() {
+		for (int i = 0; i < RENDER_PHASE_COUNT; i++) {
+			phaseStart[i] = 0;
+			phaseDuration[i] = 0;
+		}
+		copiesComputed = 0;
+		copiesCulled = 0;
+		copiesRendered = 0;
+		copiesSplatted = 0;
+		copiesBlurred = 0;
+		copiesShifted = 0;
+		pixelsSampled = 0;
+		pixelsComposited = 0;
+		rowsAborted = 0;
+		transformsCached = FALSE;
+	}
+};
+
+// Monotonic microseconds
+A_u_longlong
+GetStatsClock(void);
+
+// Phase timers; both do nothing when stats is NULL
+inline void
+BeginRenderPhase(
+	RenderStats		*stats,
+	RenderPhase		phase)
+{
+	if (stats) {
+		stats->phaseStart[phase] = GetStatsClock();
+	}
+}
+
+inline void
+EndRenderPhase(
+	RenderStats		*stats,
+	RenderPhase		phase)
+{
+	if (stats) {
+		stats->phaseDuration[phase] = GetStatsClock() - stats->phaseStart[phase];
+	}
+}
+
+// Whether renders collect stats: REPTALL_TRACE or REPTALL_STATS_OVERLAY is
+// set. Read once from the environment.
+PF_Boolean
+IsRenderStatsEnabled(void);
+
+PF_Boolean
+IsRenderStatsOverlayEnabled(void);
+
+// Appends the phases that ran as complete ("X") events named after them,
+// and the counters as a counter ("C") event, to the REPTALL_TRACE file
+// The file is a JSON array left open for appending, which chrome://tracing
+// and Perfetto load as is. label names the host command (e.g. "SmartRender").
+// Thread-safe; does nothing without REPTALL_TRACE.
+void
+AppendRenderTrace(
+	const char			*label,
+	const RenderStats&	stats);
+
+// Layer-space rect the overlay covers in the top-left corner of a
+// layerWidth x layerHeight layer; SmartFX renders include it in their
+// result rect so the overlay shows wherever the copies are
+void
+GetRenderStatsOverlayRect(
+	A_long				layerWidth,
+	A_long				layerHeight,
+	PF_LRect			*rect);
+
+// Draws the stats into the top-left corner of the layer (depth 8, 16 or 32)
+// output pixel (0, 0) is at layer position origin; only the part of the
+// overlay rect inside output is drawn.
+void
+DrawRenderStatsOverlay(
+	const RenderStats&	stats,
+	A_long				depth,
+	A_long				layerWidth,
+	A_long				layerHeight,
+	const A_long		origin[2],
+	PF_EffectWorld		*output);
+
+#endif // REPTALL_STATS_H
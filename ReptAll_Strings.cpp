@@ -39,6 +39,51 @@ const TableString		g_strs[StrID_NUMTYPES] = {
 	StrID_StepRotateY_Param_Name,	"Step Rotate Y",
 	StrID_StepRotateZ_Param_Name,	"Step Rotate Z",
 	StrID_StepScale_Param_Name,		"Step Scale",
+	StrID_FrontToBack_Param_Name,	"Front to Back",
+	StrID_FrontToBack_Checkbox,		"Skip covered pixels",
+	StrID_Random_Topic_Name,		"Random",
+	StrID_RandomSeed_Param_Name,	"Master Seed",
+	StrID_RandomStrength_Param_Name,	"Master Strength",
+	StrID_RandomDistribution_Param_Name,	"Distribution",
+	StrID_RandomDistribution_Choices,	"Uniform|Centered",
+	StrID_Fields_Topic_Name,		"Fields",
+	StrID_SpatialField_Topic_Name,	"Spatial Field",
+	StrID_SpatialFieldType_Choices,	"None|Box|Sphere",
+	StrID_FieldType_Param_Name,		"Type",
+	StrID_FieldCenterX_Param_Name,	"Center X",
+	StrID_FieldCenterY_Param_Name,	"Center Y",
+	StrID_FieldCenterZ_Param_Name,	"Center Z",
+	StrID_FieldSizeX_Param_Name,	"Size X",
+	StrID_FieldSizeY_Param_Name,	"Size Y",
+	StrID_FieldSizeZ_Param_Name,	"Size Z",
+	StrID_FieldCurve_Param_Name,	"Curve",
+	StrID_FieldCurve_Choices,		"Linear|Ease In Out",
+	StrID_FieldInvert_Param_Name,	"Invert",
+	StrID_FieldInvert_Checkbox,		"On",
+	StrID_IndexField_Topic_Name,	"Index Field",
+	StrID_IndexFieldType_Choices,	"None|Range",
+	StrID_FieldStart_Param_Name,	"Start",
+	StrID_FieldEnd_Param_Name,		"End",
+	StrID_FieldCombine_Param_Name,	"Combine",
+	StrID_FieldCombine_Choices,		"Multiply|Min|Max",
+	StrID_Effector1_Topic_Name,		"Effector 1",
+	StrID_Effector2_Topic_Name,		"Effector 2",
+	StrID_Effector3_Topic_Name,		"Effector 3",
+	StrID_EffectorEnable_Param_Name,	"Enable",
+	StrID_EffectorEnable_Checkbox,	"On",
+	StrID_EffectorStrength_Param_Name,	"Strength",
+	StrID_EffectorSeedOffset_Param_Name,	"Seed Offset",
+	StrID_EffectorProbability_Param_Name,	"Probability",
+	StrID_EffectorPositionX_Param_Name,	"Position Amount X",
+	StrID_EffectorPositionY_Param_Name,	"Position Amount Y",
+	StrID_EffectorPositionZ_Param_Name,	"Position Amount Z",
+	StrID_EffectorRotationX_Param_Name,	"Rotation Amount X",
+	StrID_EffectorRotationY_Param_Name,	"Rotation Amount Y",
+	StrID_EffectorRotationZ_Param_Name,	"Rotation Amount Z",
+	StrID_EffectorScaleX_Param_Name,	"Scale Amount X",
+	StrID_EffectorScaleY_Param_Name,	"Scale Amount Y",
+	StrID_EffectorScaleZ_Param_Name,	"Scale Amount Z",
+	StrID_EffectorOpacity_Param_Name,	"Opacity Amount",
 };
 
 
@@ -33,6 +33,51 @@ typedef enum {
 	StrID_StepRotateY_Param_Name,
 	StrID_StepRotateZ_Param_Name,
 	StrID_StepScale_Param_Name,
+	StrID_FrontToBack_Param_Name,
+	StrID_FrontToBack_Checkbox,
+	StrID_Random_Topic_Name,
+	StrID_RandomSeed_Param_Name,
+	StrID_RandomStrength_Param_Name,
+	StrID_RandomDistribution_Param_Name,
+	StrID_RandomDistribution_Choices,
+	StrID_Fields_Topic_Name,
+	StrID_SpatialField_Topic_Name,
+	StrID_SpatialFieldType_Choices,
+	StrID_FieldType_Param_Name,
+	StrID_FieldCenterX_Param_Name,
+	StrID_FieldCenterY_Param_Name,
+	StrID_FieldCenterZ_Param_Name,
+	StrID_FieldSizeX_Param_Name,
+	StrID_FieldSizeY_Param_Name,
+	StrID_FieldSizeZ_Param_Name,
+	StrID_FieldCurve_Param_Name,
+	StrID_FieldCurve_Choices,
+	StrID_FieldInvert_Param_Name,
+	StrID_FieldInvert_Checkbox,
+	StrID_IndexField_Topic_Name,
+	StrID_IndexFieldType_Choices,
+	StrID_FieldStart_Param_Name,
+	StrID_FieldEnd_Param_Name,
+	StrID_FieldCombine_Param_Name,
+	StrID_FieldCombine_Choices,
+	StrID_Effector1_Topic_Name,
+	StrID_Effector2_Topic_Name,
+	StrID_Effector3_Topic_Name,
+	StrID_EffectorEnable_Param_Name,
+	StrID_EffectorEnable_Checkbox,
+	StrID_EffectorStrength_Param_Name,
+	StrID_EffectorSeedOffset_Param_Name,
+	StrID_EffectorProbability_Param_Name,
+	StrID_EffectorPositionX_Param_Name,
+	StrID_EffectorPositionY_Param_Name,
+	StrID_EffectorPositionZ_Param_Name,
+	StrID_EffectorRotationX_Param_Name,
+	StrID_EffectorRotationY_Param_Name,
+	StrID_EffectorRotationZ_Param_Name,
+	StrID_EffectorScaleX_Param_Name,
+	StrID_EffectorScaleY_Param_Name,
+	StrID_EffectorScaleZ_Param_Name,
+	StrID_EffectorOpacity_Param_Name,
 	StrID_NUMTYPES
 } StrIDType;
 
@@ -0,0 +1,177 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_ThreadPool.cpp
+*/
+
+#include "ReptAll_ThreadPool.h"
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+struct RenderThreadPool {
+	std::vector<std::thread>	threads;
+	std::mutex					mutex;
+	std::condition_variable		wake;          // workers: new pass or shutdown
+	std::condition_variable		finished;      // caller: all workers done
+
+	// Current pass, guarded by mutex
+	A_u_long					generation;
+	A_long						pending;       // workers still running it
+	void						*workerRefcon;
+	RenderWorkerFunc			worker;
+	PF_Err						err;           // first worker error
+	bool						shutdown;
+
+	RenderThreadPool() : generation(0), pending(0), workerRefcon(NULL), worker(NULL),
+						 err(PF_Err_NONE), shutdown(false) {}
+};
+
+static void
+RunPoolThread(
+	RenderThreadPool	*pool,
+	A_long				threadIndex)
+{
+	A_u_long seen = 0;
+
+	for (;;) {
+		void *refcon;
+		RenderWorkerFunc worker;
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex);
+			pool->wake.wait(lock, [&] { return pool->shutdown || pool->generation != seen; });
+			if (pool->shutdown) {
+				return;
+			}
+			seen = pool->generation;
+			refcon = pool->workerRefcon;
+			worker = pool->worker;
+		}
+
+		PF_Err err = worker(refcon, threadIndex, threadIndex, (A_long)pool->threads.size() + 1);
+
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		if (err && !pool->err) {
+			pool->err = err;
+		}
+		if (--pool->pending == 0) {
+			pool->finished.notify_one();
+		}
+	}
+}
+
+static PF_Err
+IteratePool(
+	void				*refcon,
+	void				*workerRefcon,
+	RenderWorkerFunc	worker)
+{
+	RenderThreadPool *pool = reinterpret_cast<RenderThreadPool*>(refcon);
+	const A_long workerCount = (A_long)pool->threads.size();
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->workerRefcon = workerRefcon;
+		pool->worker = worker;
+		pool->pending = workerCount;
+		pool->err = PF_Err_NONE;
+		pool->generation++;
+	}
+	pool->wake.notify_all();
+
+	// The calling thread takes the last index
+	PF_Err err = worker(workerRefcon, workerCount, workerCount, workerCount + 1);
+
+	std::unique_lock<std::mutex> lock(pool->mutex);
+	pool->finished.wait(lock, [&] { return pool->pending == 0; });
+
+	return err ? err : pool->err;
+}
+
+PF_Err
+CreateRenderThreadPool(
+	A_long				threadCount,
+	RenderThreadPool	**poolP)
+{
+	if (!poolP || threadCount < 1) {
+		return PF_Err_BAD_CALLBACK_PARAM;
+	}
+	*poolP = NULL;
+
+	RenderThreadPool *pool = new (std::nothrow) RenderThreadPool;
+	if (!pool) {
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	try {
+		pool->threads.reserve(threadCount - 1);
+		for (A_long i = 0; i < threadCount - 1; i++) {
+			pool->threads.emplace_back(RunPoolThread, pool, i);
+		}
+	} catch (const std::exception&) {
+		DisposeRenderThreadPool(pool);
+		return PF_Err_OUT_OF_MEMORY;
+	}
+
+	*poolP = pool;
+	return PF_Err_NONE;
+}
+
+void
+DisposeRenderThreadPool(RenderThreadPool *pool)
+{
+	if (!pool) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->shutdown = true;
+	}
+	pool->wake.notify_all();
+
+	for (std::thread& thread : pool->threads) {
+		thread.join();
+	}
+	delete pool;
+}
+
+A_long
+GetRenderThreadCount(const RenderThreadPool *pool)
+{
+	return pool ? (A_long)pool->threads.size() + 1 : 1;
+}
+
+void
+GetRenderThreadPoolHost(
+	RenderThreadPool	*pool,
+	RenderHost			*host)
+{
+	host->refcon = pool;
+	host->iterate = pool ? IteratePool : NULL;
+	host->abort = NULL;
+	host->acquire_coverage = NULL;
+	host->stats = NULL;
+}
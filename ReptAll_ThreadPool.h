@@ -0,0 +1,59 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_ThreadPool.h
+
+	Render threads for hosts that bring none of their own (reptall-render,
+	reptall-bench). Inside After Effects RenderCopies runs on the host's
+	threads through iterate_generic instead.
+*/
+
+#ifndef REPTALL_THREADPOOL_H
+#define REPTALL_THREADPOOL_H
+
+#include "ReptAll_Core.h"
+
+// Persistent worker threads, started once and reused by every render
+struct RenderThreadPool;
+
+// Starts threadCount - 1 workers; the calling thread is the last one
+PF_Err
+CreateRenderThreadPool(
+	A_long				threadCount,
+	RenderThreadPool	**pool);
+
+// Joins the workers; no render may be running
+void
+DisposeRenderThreadPool(RenderThreadPool *pool);
+
+A_long
+GetRenderThreadCount(const RenderThreadPool *pool);
+
+// RenderHost whose iterate runs the worker once on every pool thread
+// abort, acquire_coverage and stats are NULL. One render at a time per pool.
+void
+GetRenderThreadPoolHost(
+	RenderThreadPool	*pool,
+	RenderHost			*host);
+
+#endif // REPTALL_THREADPOOL_H
@@ -0,0 +1,245 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*	ReptAll_TransformCache.cpp
+
+	Small LRU table of sorted copy transforms, keyed by the parameter
+	state and camera they were computed from.
+*/
+
+#include "ReptAll_TransformCache.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Flattened inputs of phases 2-3
+struct TransformCacheKey {
+	std::vector<PF_FpLong>	values;
+	A_u_longlong			hash;
+};
+
+struct TransformCacheEntry {
+	TransformCacheKey	key;
+	CopyInstanceList	instances;
+	A_u_longlong		lastUse;
+};
+
+std::mutex							g_cacheMutex;
+std::vector<TransformCacheEntry>	g_cacheEntries;
+A_long								g_cacheCopies = 0;
+A_u_longlong						g_cacheTick = 0;
+std::atomic<A_u_longlong>			g_cacheHits(0);
+std::atomic<A_u_longlong>			g_cacheMisses(0);
+
+void
+AppendValues(
+	std::vector<PF_FpLong>	*values,
+	const PF_FpLong			*src,
+	int						count)
+{
+	values->insert(values->end(), src, src + count);
+}
+
+// Every field ComputeCopyTransforms / SortCopiesByDepth read
+void
+BuildCacheKey(
+	const ReptAllState	*state,
+	const CopyCamera	*camera,
+	TransformCacheKey	*key)
+{
+	std::vector<PF_FpLong>& v = key->values;
+	v.clear();
+	v.reserve(128);
+
+	for (int i = 0; i < 3; i++) {
+		v.push_back((PF_FpLong)state->copies[i]);
+	}
+	v.push_back(state->offset);
+	AppendValues(&v, state->anchor, 3);
+	AppendValues(&v, state->position, 3);
+	v.push_back(state->scale);
+	AppendValues(&v, state->rotation, 3);
+	AppendValues(&v, state->step_position, 3);
+	AppendValues(&v, state->step_rotation, 3);
+	v.push_back(state->step_scale);
+	v.push_back(state->opacity_start);
+	v.push_back(state->opacity_end);
+	v.push_back(state->camera_aware ? 1.0 : 0.0);
+	v.push_back((PF_FpLong)state->random_seed);
+	v.push_back(state->random_strength);
+	v.push_back((PF_FpLong)state->random_distribution);
+	v.push_back((PF_FpLong)state->spatial_field.shape);
+	AppendValues(&v, state->spatial_field.center, 3);
+	AppendValues(&v, state->spatial_field.size, 3);
+	v.push_back((PF_FpLong)state->spatial_field.curve);
+	v.push_back(state->spatial_field.invert ? 1.0 : 0.0);
+	v.push_back((PF_FpLong)state->index_field.type);
+	v.push_back(state->index_field.start);
+	v.push_back(state->index_field.end);
+	v.push_back((PF_FpLong)state->index_field.curve);
+	v.push_back((PF_FpLong)state->field_combine);
+	for (int e = 0; e < REPTALL_EFFECTOR_COUNT; e++) {
+		const CopyEffector& effector = state->effector[e];
+		v.push_back(effector.enabled ? 1.0 : 0.0);
+		v.push_back(effector.strength);
+		v.push_back((PF_FpLong)effector.seed_offset);
+		v.push_back(effector.probability);
+		AppendValues(&v, effector.position, 3);
+		AppendValues(&v, effector.rotation, 3);
+		AppendValues(&v, effector.scale, 3);
+		v.push_back(effector.opacity);
+	}
+
+	v.push_back(camera->has_camera ? 1.0 : 0.0);
+	if (camera->has_camera) {
+		for (int r = 0; r < 4; r++) {
+			AppendValues(&v, camera->matrix.mat[r], 4);
+		}
+		v.push_back(camera->focal_length);
+		AppendValues(&v, camera->layer_center, 2);
+	}
+
+	// FNV-1a over the value bytes
+	A_u_longlong hash = 14695981039346656037ULL;
+	const unsigned char *bytes = (const unsigned char*)v.data();
+	for (size_t i = 0; i < v.size() * sizeof(PF_FpLong); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	key->hash = hash;
+}
+
+bool
+KeysEqual(
+	const TransformCacheKey&	a,
+	const TransformCacheKey&	b)
+{
+	return a.hash == b.hash &&
+		   a.values.size() == b.values.size() &&
+		   memcmp(a.values.data(), b.values.data(), a.values.size() * sizeof(PF_FpLong)) == 0;
+}
+
+} // namespace
+
+CopyInstanceList
+LookupCachedTransforms(
+	const ReptAllState	*state,
+	const CopyCamera	*camera)
+{
+	TransformCacheKey key;
+	BuildCacheKey(state, camera, &key);
+
+	std::lock_guard<std::mutex> lock(g_cacheMutex);
+
+	for (TransformCacheEntry& entry : g_cacheEntries) {
+		if (KeysEqual(entry.key, key)) {
+			entry.lastUse = ++g_cacheTick;
+			g_cacheHits++;
+			return entry.instances;
+		}
+	}
+
+	g_cacheMisses++;
+	return CopyInstanceList();
+}
+
+CopyInstanceList
+LookupRecentTransforms(A_long count)
+{
+	std::lock_guard<std::mutex> lock(g_cacheMutex);
+
+	const TransformCacheEntry *recent = NULL;
+	for (const TransformCacheEntry& entry : g_cacheEntries) {
+		if (entry.instances->count == count &&
+			(!recent || entry.lastUse > recent->lastUse)) {
+			recent = &entry;
+		}
+	}
+
+	return recent ? recent->instances : CopyInstanceList();
+}
+
+void
+StoreCachedTransforms(
+	const ReptAllState			*state,
+	const CopyCamera			*camera,
+	const CopyInstanceList&		instances)
+{
+	if (!instances || instances->count > TRANSFORM_CACHE_MAX_COPIES) {
+		return;
+	}
+
+	TransformCacheEntry entry;
+	BuildCacheKey(state, camera, &entry.key);
+	entry.instances = instances;
+
+	std::lock_guard<std::mutex> lock(g_cacheMutex);
+	entry.lastUse = ++g_cacheTick;
+
+	// Another render may have stored the same key meanwhile
+	for (TransformCacheEntry& existing : g_cacheEntries) {
+		if (KeysEqual(existing.key, entry.key)) {
+			g_cacheCopies += instances->count - existing.instances->count;
+			existing = entry;
+			return;
+		}
+	}
+
+	// Evict least recently used entries until the new one fits
+	while (!g_cacheEntries.empty() &&
+		   (g_cacheEntries.size() >= TRANSFORM_CACHE_ENTRIES ||
+			g_cacheCopies + instances->count > TRANSFORM_CACHE_MAX_COPIES)) {
+		size_t oldest = 0;
+		for (size_t i = 1; i < g_cacheEntries.size(); i++) {
+			if (g_cacheEntries[i].lastUse < g_cacheEntries[oldest].lastUse) {
+				oldest = i;
+			}
+		}
+		g_cacheCopies -= g_cacheEntries[oldest].instances->count;
+		g_cacheEntries[oldest] = g_cacheEntries.back();
+		g_cacheEntries.pop_back();
+	}
+
+	g_cacheEntries.push_back(entry);
+	g_cacheCopies += instances->count;
+}
+
+void
+GetTransformCacheStats(TransformCacheStats *stats)
+{
+	if (stats) {
+		stats->hits = g_cacheHits.load();
+		stats->misses = g_cacheMisses.load();
+	}
+}
+
+void
+ClearTransformCache(void)
+{
+	std::lock_guard<std::mutex> lock(g_cacheMutex);
+	g_cacheEntries.clear();
+	g_cacheCopies = 0;
+	g_cacheHits = 0;
+	g_cacheMisses = 0;
+}
@@ -0,0 +1,77 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+/*
+	ReptAll_TransformCache.h
+
+	Cache of depth-sorted copy transforms (phases 2-3) across renders.
+*/
+
+#ifndef REPTALL_TRANSFORMCACHE_H
+#define REPTALL_TRANSFORMCACHE_H
+
+#include "ReptAll_Core.h"
+#include "ReptAll_Instances.h"
+
+// Number of (state, camera) results kept; least recently used is evicted
+#define TRANSFORM_CACHE_ENTRIES		32
+
+// Total copies held by all entries (~60 bytes each); older entries are
+// evicted to stay below it and larger results are not cached
+#define TRANSFORM_CACHE_MAX_COPIES	(2 * 1024 * 1024)
+
+struct TransformCacheStats {
+	A_u_longlong	hits;
+	A_u_longlong	misses;
+};
+
+// Side table shared by all effect instances and render threads
+// Entries are keyed by the exact ReptAllState + CopyCamera values that
+// phases 2-3 read (hashed for lookup, compared in full), so instances with
+// identical settings share an entry and a hit is always a correct result.
+// All functions are thread-safe.
+
+// Returns the cached list for (state, camera), or an empty pointer
+CopyInstanceList
+LookupCachedTransforms(
+	const ReptAllState	*state,
+	const CopyCamera	*camera);
+
+// Returns the most recently used list of count copies, or an empty pointer
+// Only a hint for SortCopiesByDepth: the inputs may differ arbitrarily.
+CopyInstanceList
+LookupRecentTransforms(A_long count);
+
+// Records the list computed for (state, camera)
+void
+StoreCachedTransforms(
+	const ReptAllState			*state,
+	const CopyCamera			*camera,
+	const CopyInstanceList&	instances);
+
+void
+GetTransformCacheStats(TransformCacheStats *stats);
+
+// Drops all entries and resets the counters
+void
+ClearTransformCache(void);
+
+#endif // REPTALL_TRANSFORMCACHE_H
@@ -0,0 +1,153 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Types.h
+
+	Basic types shared by the effect and the host-independent render core.
+	Plug-in builds take them from the After Effects SDK. Standalone builds
+	of the core (REPTALL_STANDALONE, see CMakeLists.txt) define the few SDK
+	types the core uses themselves. Pixel types keep the SDK layout;
+	PF_LayerDef has only the buffer fields the core reads.
+*/
+
+#ifndef REPTALL_TYPES_H
+#define REPTALL_TYPES_H
+
+#ifndef REPTALL_STANDALONE
+
+typedef unsigned char		u_char;
+typedef unsigned short		u_short;
+typedef unsigned short		u_int16;
+typedef unsigned long		u_long;
+typedef short int			int16;
+#define PF_TABLE_BITS	12
+#define PF_TABLE_SZ_16	4096
+
+#define PF_DEEP_COLOR_AWARE 1	// make sure we get 16bpc pixels; 
+								// AE_Effect.h checks for this.
+
+#include "AEConfig.h"
+
+#ifdef AE_OS_WIN
+	typedef unsigned short PixelType;
+	#include <Windows.h>
+#endif
+
+#include "entry.h"
+#include "AE_Effect.h"
+#include "AE_EffectCB.h"
+#include "AE_Macros.h"
+
+#else // REPTALL_STANDALONE
+
+#include <cstdint>
+
+typedef int32_t				A_long;
+typedef uint32_t			A_u_long;
+typedef uint64_t			A_u_longlong;
+typedef uint8_t				A_u_char;
+typedef uint16_t			A_u_short;
+typedef uint8_t				A_Boolean;
+typedef double				A_FpLong;
+
+typedef A_Boolean			PF_Boolean;
+typedef double				PF_FpLong;
+typedef float				PF_FpShort;
+typedef A_long				PF_Err;
+
+#ifndef TRUE
+	#define TRUE	1
+#endif
+#ifndef FALSE
+	#define FALSE	0
+#endif
+
+enum {
+	PF_Err_NONE = 0,
+	PF_Err_OUT_OF_MEMORY = 4,
+	PF_Err_INTERNAL_STRUCT_DAMAGED = 512,
+	PF_Err_INVALID_INDEX,
+	PF_Err_UNRECOGNIZED_PARAM_TYPE,
+	PF_Err_INVALID_CALLBACK,
+	PF_Err_BAD_CALLBACK_PARAM,
+	PF_Interrupt_CANCEL
+};
+
+#define PF_MAX_CHAN8	255
+#define PF_MAX_CHAN16	32768
+
+typedef struct {
+	A_u_char	alpha, red, green, blue;
+} PF_Pixel;
+
+typedef struct {
+	A_u_short	alpha, red, green, blue;
+} PF_Pixel16;
+
+typedef struct {
+	PF_FpShort	alpha, red, green, blue;
+} PF_PixelFloat;
+
+typedef PF_Pixel			*PF_PixelPtr;
+
+typedef struct {
+	A_long	left, top, right, bottom;
+} PF_LRect;
+
+typedef struct {
+	A_long		num;
+	A_u_long	den;
+} PF_RationalScale;
+
+typedef struct {
+	A_FpLong	mat[4][4];
+} A_Matrix4;
+
+// Opaque identity of a parameter's value over a time span
+typedef struct {
+	A_u_longlong	reserved[4];
+} PF_State;
+
+// The image buffer fields of PF_LayerDef the core reads and writes
+typedef struct PF_LayerDef {
+	PF_PixelPtr	data;
+	A_long		rowbytes;
+	A_long		width;
+	A_long		height;
+} PF_LayerDef;
+
+typedef PF_LayerDef			PF_EffectWorld;
+
+#ifndef MIN
+	#define MIN(A, B)	((A) < (B) ? (A) : (B))
+#endif
+#ifndef MAX
+	#define MAX(A, B)	((A) > (B) ? (A) : (B))
+#endif
+
+#define ERR(FUNC)	do { if (!err) { err = (FUNC); } } while (0)
+#define ERR2(FUNC)	do { if (((err2 = (FUNC)) != PF_Err_NONE) && !err) err = err2; } while (0)
+
+#endif // REPTALL_STANDALONE
+
+#endif // REPTALL_TYPES_H
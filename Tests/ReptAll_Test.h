@@ -0,0 +1,166 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_Test.h
+
+	Helpers shared by the regression tests of the render core. Every test
+	is a small executable run by ctest: it prints each failed check and
+	exits non-zero if there was one.
+*/
+
+#ifndef REPTALL_TEST_H
+#define REPTALL_TEST_H
+
+#include "ReptAll_Core.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Failed checks of this test
+static int g_testFailures = 0;
+
+// Reports a failed check with a printf message and counts it
+#define TEST_CHECK(condition, ...) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+			fprintf(stderr, __VA_ARGS__); \
+			fputc('\n', stderr); \
+			g_testFailures++; \
+		} \
+	} while (0)
+
+// Exit status of the test, with a summary line
+inline int
+FinishTest(const char *name)
+{
+	if (g_testFailures) {
+		fprintf(stderr, "%s: %d check(s) failed\n", name, g_testFailures);
+		return 1;
+	}
+	printf("%s: passed\n", name);
+	return 0;
+}
+
+// xorshift64*: reproducible inputs without depending on the library's
+// std::rand or distributions
+struct TestRandom {
+	A_u_longlong	state;
+
+	explicit TestRandom(A_u_longlong seed) : state(seed * 2654435761ull + 0x9E3779B97F4A7C15ull) {}
+
+	A_u_long Next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return (A_u_long)((state * 0x2545F4914F6CDD1Dull) >> 32);
+	}
+
+	// Uniform in [lo, hi)
+	double Uniform(double lo, double hi) {
+		return lo + (hi - lo) * (Next() * (1.0 / 4294967296.0));
+	}
+};
+
+inline A_long
+GetTestPixelSize(A_long depth)
+{
+	return depth == 32 ? (A_long)sizeof(PF_PixelFloat) :
+		   depth == 16 ? (A_long)sizeof(PF_Pixel16) : (A_long)sizeof(PF_Pixel);
+}
+
+// Buffer in the core's pixel layout, rows padded to show rowbytes is honoured
+struct TestWorld {
+	std::vector<char>	storage;
+	PF_EffectWorld		world;
+	A_long				depth;
+
+	void Allocate(A_long width, A_long height, A_long bitDepth) {
+		depth = bitDepth;
+		world.rowbytes = (width + 3) * GetTestPixelSize(depth);
+		world.width = width;
+		world.height = height;
+		storage.assign((size_t)world.rowbytes * height, 0);
+		world.data = (PF_PixelPtr)storage.data();
+	}
+
+	bool operator==(const TestWorld& other) const {
+		return storage == other.storage;
+	}
+};
+
+// Premultiplied test source: an opaque disc with a soft edge, a
+// semi-transparent ramp and noisy color over a transparent border, so
+// copies have edges, partial alpha and empty rows to skip
+inline void
+FillTestSource(
+	A_long			width,
+	A_long			height,
+	A_long			depth,
+	A_u_long		seed,
+	TestWorld		*source)
+{
+	TestRandom random(seed);
+	source->Allocate(width, height, depth);
+
+	for (A_long y = 0; y < height; y++) {
+		char *row = (char*)source->world.data + (std::ptrdiff_t)y * source->world.rowbytes;
+
+		for (A_long x = 0; x < width; x++) {
+			const double dx = (x + 0.5) / width - 0.5;
+			const double dy = (y + 0.5) / height - 0.5;
+			const double r = sqrt(dx * dx + dy * dy);
+			double alpha = std::min(1.0, std::max(0.0, (0.35 - r) * 20.0));
+			if (y > height * 3 / 4 && x > width / 8 && x < width * 7 / 8) {
+				alpha = std::max(alpha, (double)x / width);
+			}
+			double color[3];
+			for (int c = 0; c < 3; c++) {
+				color[c] = alpha * random.Uniform(0.0, 1.0);
+			}
+
+			if (depth == 32) {
+				PF_PixelFloat& p = ((PF_PixelFloat*)row)[x];
+				p.alpha = (PF_FpShort)alpha;
+				p.red = (PF_FpShort)color[0];
+				p.green = (PF_FpShort)color[1];
+				p.blue = (PF_FpShort)color[2];
+			} else if (depth == 16) {
+				PF_Pixel16& p = ((PF_Pixel16*)row)[x];
+				p.alpha = (A_u_short)(alpha * PF_MAX_CHAN16 + 0.5);
+				p.red = (A_u_short)(color[0] * PF_MAX_CHAN16 + 0.5);
+				p.green = (A_u_short)(color[1] * PF_MAX_CHAN16 + 0.5);
+				p.blue = (A_u_short)(color[2] * PF_MAX_CHAN16 + 0.5);
+			} else {
+				PF_Pixel& p = ((PF_Pixel*)row)[x];
+				p.alpha = (A_u_char)(alpha * PF_MAX_CHAN8 + 0.5);
+				p.red = (A_u_char)(color[0] * PF_MAX_CHAN8 + 0.5);
+				p.green = (A_u_char)(color[1] * PF_MAX_CHAN8 + 0.5);
+				p.blue = (A_u_char)(color[2] * PF_MAX_CHAN8 + 0.5);
+			}
+		}
+	}
+}
+
+#endif // REPTALL_TEST_H
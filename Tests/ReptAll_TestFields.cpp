@@ -0,0 +1,108 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_TestFields.cpp
+
+	The dispatched field kernel (SSE2 or NEON) against the scalar reference
+	on random field programs: every shape, curve, combine mode, invert and
+	index ramp (rising, falling and empty), with positions inside, on and
+	outside the field and batch lengths that leave scalar tails. Every
+	weight must match bit for bit.
+*/
+
+#include "ReptAll_Test.h"
+#include "ReptAll_Fields.h"
+#include <cstring>
+
+#define TEST_PROGRAMS		2000
+#define TEST_BATCHES		20
+
+static void
+MakeRandomFields(
+	TestRandom&		random,
+	SpatialField	*spatial,
+	IndexField		*index)
+{
+	spatial->Clear();
+	spatial->shape = (A_long)(random.Next() % 3);
+	for (int i = 0; i < 3; i++) {
+		spatial->center[i] = random.Uniform(-500.0, 500.0);
+		// Some degenerate extents, clamped to FIELD_MIN_SIZE
+		spatial->size[i] = random.Next() % 16 ? random.Uniform(-2000.0, 3000.0) : 0.0;
+	}
+	spatial->curve = (A_long)(random.Next() % 2);
+	spatial->invert = (A_Boolean)(random.Next() % 2);
+
+	index->Clear();
+	index->type = (A_long)(random.Next() % 2);
+	index->start = random.Uniform(-20.0, 120.0);
+	index->end = random.Next() % 8 ? random.Uniform(-20.0, 120.0) : index->start;
+	index->curve = (A_long)(random.Next() % 2);
+}
+
+int
+main(void)
+{
+	const FieldBatchFunc kernel = GetFieldBatchKernel();
+	const FieldBatchFunc scalar = GetScalarFieldBatchKernel();
+	printf("fields: dispatched kernel is %s\n", kernel == scalar ? "scalar" : "SIMD");
+
+	TestRandom random(24);
+	A_long mismatches = 0, batches = 0;
+	for (int p = 0; p < TEST_PROGRAMS; p++) {
+		SpatialField spatial;
+		IndexField index;
+		MakeRandomFields(random, &spatial, &index);
+		const A_long copies = 1 + (A_long)(random.Next() % 5000);
+		const A_long combine = (A_long)(random.Next() % 3);
+
+		FieldProgram program;
+		PrepareFieldProgram(spatial, index, combine, copies, &program);
+
+		for (int n = 0; n < TEST_BATCHES; n++) {
+			const A_long first = (A_long)(random.Next() % copies);
+			const A_long count = std::min<A_long>(1 + (A_long)(random.Next() % FIELD_BATCH_MAX), copies - first);
+
+			float x[FIELD_BATCH_MAX], y[FIELD_BATCH_MAX], z[FIELD_BATCH_MAX];
+			for (A_long i = 0; i < count; i++) {
+				// Mostly around the field, some exactly at its center
+				const bool atCenter = random.Next() % 16 == 0;
+				x[i] = atCenter ? program.center[0] : program.center[0] + (float)random.Uniform(-1500.0, 1500.0);
+				y[i] = atCenter ? program.center[1] : program.center[1] + (float)random.Uniform(-1500.0, 1500.0);
+				z[i] = atCenter ? program.center[2] : program.center[2] + (float)random.Uniform(-1500.0, 1500.0);
+			}
+
+			float weight[FIELD_BATCH_MAX], expected[FIELD_BATCH_MAX];
+			kernel(program, x, y, z, first, count, weight);
+			scalar(program, x, y, z, first, count, expected);
+			if (memcmp(weight, expected, count * sizeof(float)) != 0) {
+				mismatches++;
+			}
+			batches++;
+		}
+	}
+
+	TEST_CHECK(mismatches == 0, "%d of %d batches differ from the scalar kernel", (int)mismatches, (int)batches);
+
+	return FinishTest("fields");
+}
@@ -0,0 +1,78 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_TestFixedPoint.cpp
+
+	The integer compositing helpers against the exact rational reference
+	over their whole input domain: MulDiv255 must be round(x * a / 255)
+	for x, a in [0, 255] and MulDiv32768 round(x * a / 32768) for x, a in
+	[0, 32768], halves rounding up.
+
+	This test builds ReptAll_Core.cpp into itself to reach its internal
+	helpers; the library's copy of that object is then never linked.
+*/
+
+#include "ReptAll_Core.cpp"
+#include "ReptAll_Test.h"
+
+// round(x * a / d), halves up, in exact integer arithmetic
+static A_u_long
+RoundedQuotient(
+	A_u_long	x,
+	A_u_long	a,
+	A_u_long	d)
+{
+	return (A_u_long)((2 * (A_u_longlong)x * a + d) / (2 * (A_u_longlong)d));
+}
+
+template<int MaxChannelInt>
+static void
+TestMulDiv(void)
+{
+	A_u_longlong mismatches = 0;
+	A_u_long firstX = 0, firstA = 0;
+
+	for (A_u_long x = 0; x <= (A_u_long)MaxChannelInt; x++) {
+		for (A_u_long a = 0; a <= (A_u_long)MaxChannelInt; a++) {
+			if (MulDivMaxChan<MaxChannelInt>(x, a) != RoundedQuotient(x, a, MaxChannelInt)) {
+				if (!mismatches) {
+					firstX = x;
+					firstA = a;
+				}
+				mismatches++;
+			}
+		}
+	}
+
+	TEST_CHECK(mismatches == 0, "MulDiv%d: %llu mismatches, first at x = %u, a = %u",
+			   MaxChannelInt, (unsigned long long)mismatches, (unsigned)firstX, (unsigned)firstA);
+}
+
+int
+main(void)
+{
+	TestMulDiv<PF_MAX_CHAN8>();
+	TestMulDiv<PF_MAX_CHAN16>();
+
+	return FinishTest("fixed_point");
+}
@@ -0,0 +1,275 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_TestMultiFrame.cpp
+
+	Multi-Frame Rendering stress test: renders a sequence of frames on many
+	threads at once, each frame through phases 2-4 the way the effect runs
+	them (transform cache, previous-order sort hint, cached source coverage,
+	motion blur, banded rendering on its own worker threads), and requires
+	every frame to match a serial render of it byte for byte.
+*/
+
+#include "ReptAll_Test.h"
+#include "ReptAll_Instances.h"
+#include "ReptAll_ThreadPool.h"
+#include "ReptAll_TransformCache.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#define TEST_FRAMES				24
+#define TEST_THREADS			8
+#define TEST_ROUNDS				3         // times each thread renders every frame
+#define TEST_BAND_THREADS		2         // RenderCopies workers per render
+#define TEST_LAYER_WIDTH		192
+#define TEST_LAYER_HEIGHT		144
+
+// Parameters of frame f: a grid animated in every transform, random
+// effectors reseeded per frame, a camera on odd frames and draft, back to
+// front and motion blur on some of the others
+static void
+MakeFrameState(
+	A_long			frame,
+	PF_FpLong		time,
+	ReptAllState	*state,
+	CopyCamera		*camera)
+{
+	state->Clear();
+	state->copies[0] = 6;
+	state->copies[1] = 4;
+	state->copies[2] = 3;
+	state->position[0] = -80.0 + 4.0 * time;
+	state->position[1] = -50.0;
+	state->step_position[0] = 32.0;
+	state->step_position[1] = 28.0 + time;
+	state->step_position[2] = -40.0;
+	state->rotation[2] = 5.0 * time;
+	state->step_rotation[0] = (frame & 1) ? 6.0 : 0.0;
+	state->step_rotation[2] = 7.0 + time;
+	state->scale = 60.0 + time;
+	state->step_scale = 97.0;
+	state->opacity_end = 40.0;
+	state->front_to_back = (frame % 4) != 2;
+	state->draft = (frame % 5) == 4;
+	state->random_seed = frame / 3;
+	state->effector[0].enabled = TRUE;
+	state->effector[0].position[0] = 12.0;
+	state->effector[0].rotation[2] = 20.0;
+	state->effector[0].opacity = 30.0;
+
+	camera->Clear();
+	if (frame & 1) {
+		camera->has_camera = TRUE;
+		camera->focal_length = 400.0;
+		for (int i = 0; i < 4; i++) {
+			camera->matrix.mat[i][i] = 1.0;
+		}
+		camera->matrix.mat[3][0] = TEST_LAYER_WIDTH / 2.0 + time;
+		camera->matrix.mat[3][1] = TEST_LAYER_HEIGHT / 2.0;
+		camera->matrix.mat[3][2] = -400.0;
+		camera->layer_center[0] = TEST_LAYER_WIDTH / 2.0;
+		camera->layer_center[1] = TEST_LAYER_HEIGHT / 2.0;
+	}
+}
+
+static A_long
+GetFrameDepth(A_long frame)
+{
+	static const A_long depths[3] = {8, 16, 32};
+	return depths[frame % 3];
+}
+
+// Sources shared read-only by every render, one per depth
+static TestWorld g_sources[3];
+
+static const TestWorld&
+GetFrameSource(A_long frame)
+{
+	return g_sources[frame % 3];
+}
+
+// Coverage through the process-wide cache, keyed by the source's depth as
+// the effect keys it by the layer's state
+static PF_Err
+AcquireTestCoverage(
+	void					*refcon,
+	const PF_EffectWorld	*srcP,
+	A_long					depth,
+	SourceCoverageRef		*coverage)
+{
+	SourceFrameKey key;
+	memset(&key, 0, sizeof(key));
+	key.state.reserved[0] = (A_u_longlong)depth;
+	key.width = srcP->width;
+	key.height = srcP->height;
+	key.depth = depth;
+
+	*coverage = LookupSourceCoverage(key);
+	if (*coverage) {
+		return PF_Err_NONE;
+	}
+
+	std::shared_ptr<SourceCoverage> scanned = std::make_shared<SourceCoverage>();
+	PF_Err err = BuildSourceCoverage(srcP, depth == 32, depth == 16, scanned.get());
+	if (!err) {
+		*coverage = scanned;
+		StoreSourceCoverage(key, *coverage);
+	}
+	return err;
+}
+
+// Phase 2-3 result of (state, camera): cached, or computed with the most
+// recent result of the same size as the sort hint
+static PF_Err
+GetFrameCopies(
+	const ReptAllState	*state,
+	const CopyCamera	*camera,
+	PF_Boolean			useCache,
+	CopyInstanceList	*instances)
+{
+	PF_Err err = PF_Err_NONE;
+	const A_long count = state->copies[0] * state->copies[1] * state->copies[2];
+
+	if (useCache) {
+		*instances = LookupCachedTransforms(state, camera);
+		if (*instances) {
+			return err;
+		}
+	}
+
+	CopyInstanceList previous = useCache ? LookupRecentTransforms(count) : CopyInstanceList();
+	std::shared_ptr<CopyInstanceBuffer> storage;
+	ERR(AcquireCopyInstances(count, &storage));
+	ERR(ComputeCopyTransforms(state, camera, storage.get()));
+	ERR(SortCopiesByDepth(storage.get(), state->camera_aware,
+						  previous && previous->count == count ? previous->order : NULL));
+	if (!err) {
+		*instances = storage;
+		if (useCache) {
+			StoreCachedTransforms(state, camera, *instances);
+		}
+	}
+	return err;
+}
+
+// Frame f into output; pool may be NULL for a render on this thread only
+static PF_Err
+RenderFrame(
+	A_long				frame,
+	RenderThreadPool	*pool,
+	PF_Boolean			useCache,
+	TestWorld			*output)
+{
+	PF_Err err = PF_Err_NONE;
+	ReptAllState state;
+	CopyCamera camera;
+	MakeFrameState(frame, (PF_FpLong)frame, &state, &camera);
+
+	CopyInstanceList instances;
+	ERR(GetFrameCopies(&state, &camera, useCache, &instances));
+
+	// Motion blur over a short shutter on every third frame
+	CopyInstanceList shutter[2];
+	CopyMotion motion = {NULL, NULL};
+	for (int e = 0; e < 2 && !err && frame % 3 == 0; e++) {
+		ReptAllState shutterState;
+		CopyCamera shutterCamera;
+		MakeFrameState(frame, frame + (e ? 0.05 : -0.05), &shutterState, &shutterCamera);
+		ERR(GetFrameCopies(&shutterState, &shutterCamera, useCache, &shutter[e]));
+		motion.open = shutter[0].get();
+		motion.close = shutter[1].get();
+	}
+
+	RenderHost host = {NULL, NULL, NULL, NULL, NULL};
+	if (pool) {
+		GetRenderThreadPoolHost(pool, &host);
+	}
+	if (useCache) {
+		host.acquire_coverage = AcquireTestCoverage;
+	}
+
+	const TestWorld& source = GetFrameSource(frame);
+	RenderGeometry geometry;
+	geometry.Clear(source.world.width, source.world.height);
+	output->Allocate(source.world.width, source.world.height, source.depth);
+
+	ERR(RenderCopies(&host, &state, instances.get(), motion.close ? &motion : NULL, &geometry,
+					 source.depth, const_cast<PF_EffectWorld*>(&source.world), &output->world));
+	return err;
+}
+
+int
+main(void)
+{
+	for (A_long i = 0; i < 3; i++) {
+		FillTestSource(TEST_LAYER_WIDTH, TEST_LAYER_HEIGHT, GetFrameDepth(i), 7 + i, &g_sources[i]);
+	}
+
+	// Reference: every frame alone, on this thread, without any cache
+	std::vector<TestWorld> reference(TEST_FRAMES);
+	for (A_long f = 0; f < TEST_FRAMES; f++) {
+		PF_Err err = RenderFrame(f, NULL, FALSE, &reference[f]);
+		TEST_CHECK(err == PF_Err_NONE, "serial frame %d failed with error %d", (int)f, (int)err);
+	}
+
+	ClearTransformCache();
+	ClearSourceCoverageCache();
+
+	// Every thread renders all frames TEST_ROUNDS times, each thread
+	// starting at a different frame, so the same and different frames
+	// overlap in time and share the caches
+	std::atomic<int> mismatches(0);
+	std::atomic<int> failures(0);
+	std::vector<std::thread> threads;
+
+	for (A_long t = 0; t < TEST_THREADS; t++) {
+		threads.emplace_back([t, &reference, &mismatches, &failures]() {
+			RenderThreadPool *pool = NULL;
+			if (CreateRenderThreadPool(TEST_BAND_THREADS, &pool) != PF_Err_NONE) {
+				failures++;
+				return;
+			}
+
+			TestWorld output;
+			for (A_long k = 0; k < TEST_ROUNDS * TEST_FRAMES; k++) {
+				const A_long frame = (t * 5 + k) % TEST_FRAMES;
+				if (RenderFrame(frame, (k & 1) ? pool : NULL, TRUE, &output) != PF_Err_NONE) {
+					failures++;
+				} else if (!(output == reference[frame])) {
+					mismatches++;
+				}
+			}
+			DisposeRenderThreadPool(pool);
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	TEST_CHECK(failures == 0, "%d concurrent renders failed", failures.load());
+	TEST_CHECK(mismatches == 0, "%d of %d concurrent frames differ from the serial render",
+			   mismatches.load(), TEST_THREADS * TEST_ROUNDS * TEST_FRAMES);
+
+	return FinishTest("multiframe");
+}
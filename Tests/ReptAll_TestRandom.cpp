@@ -0,0 +1,101 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_TestRandom.cpp
+
+	The counter-based generator: GenerateRandomWords against the Philox4x32-10
+	known-answer vector of the Random123 distribution, and the dispatched
+	batch kernel (SSE4.1, AVX2 or NEON) against both the scalar batch kernel
+	and GenerateRandomWords on random keys, counters, blocks and batch
+	lengths, including counters that wrap around 2^32.
+*/
+
+#include "ReptAll_Test.h"
+#include "ReptAll_Random.h"
+#include "ReptAll_Sampling.h"
+#include <cstring>
+
+#define TEST_BATCHES	20000
+
+static void
+TestKnownAnswer(void)
+{
+	static const A_u_long expected[RANDOM_BLOCK_WORDS] = {
+		0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u
+	};
+	const RandomKey key = {0, 0};
+	A_u_long words[RANDOM_BLOCK_WORDS];
+	GenerateRandomWords(key, 0, 0, words);
+
+	TEST_CHECK(memcmp(words, expected, sizeof(words)) == 0,
+			   "Philox4x32-10 of counter 0, key 0 is %08x %08x %08x %08x",
+			   (unsigned)words[0], (unsigned)words[1], (unsigned)words[2], (unsigned)words[3]);
+}
+
+static void
+TestBatchKernels(void)
+{
+	const RandomBatchFunc kernel = GetRandomBatchKernel();
+	const RandomBatchFunc scalar = GetScalarRandomBatchKernel();
+	TestRandom random(23);
+
+	A_long kernelMismatches = 0, scalarMismatches = 0;
+	for (int n = 0; n < TEST_BATCHES; n++) {
+		RandomKey key;
+		key.seed = random.Next();
+		key.stream = random.Next() % 4 ? random.Next() % 16 : random.Next();
+		const A_long count = 1 + (A_long)(random.Next() % RANDOM_BATCH_MAX);
+		const A_u_long first = random.Next() % 4 ? random.Next() % 100000 : random.Next();
+		const A_u_long block = random.Next() % 8;
+
+		A_u_long out[RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX], reference[RANDOM_BLOCK_WORDS][RANDOM_BATCH_MAX];
+		kernel(key, first, count, block, out);
+		scalar(key, first, count, block, reference);
+
+		for (A_long i = 0; i < count; i++) {
+			A_u_long words[RANDOM_BLOCK_WORDS];
+			GenerateRandomWords(key, first + (A_u_long)i, block, words);
+			for (int w = 0; w < RANDOM_BLOCK_WORDS; w++) {
+				kernelMismatches += out[w][i] != words[w];
+				scalarMismatches += reference[w][i] != words[w];
+			}
+		}
+	}
+
+	TEST_CHECK(kernelMismatches == 0, "dispatched batch kernel: %d words differ from GenerateRandomWords",
+			   (int)kernelMismatches);
+	TEST_CHECK(scalarMismatches == 0, "scalar batch kernel: %d words differ from GenerateRandomWords",
+			   (int)scalarMismatches);
+}
+
+int
+main(void)
+{
+	static const char *levels[] = {"scalar", "SSE4.1", "AVX2", "NEON"};
+	printf("random: dispatched kernel is %s\n", levels[GetSampleKernels()->level]);
+
+	TestKnownAnswer();
+	TestBatchKernels();
+
+	return FinishTest("random");
+}
@@ -0,0 +1,346 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_TestRenderPaths.cpp
+
+	The specialized span paths of RenderCopies against the generic ones
+	they stand in for, within the tolerances their comments state:
+
+	- incremental (DDA) sample positions against positions evaluated
+	  directly for every pixel
+	- shifted copies (integer and subpixel translations) against the same
+	  copies sampled through the bilinear kernels
+
+	This test builds ReptAll_Core.cpp into itself to reach its internal
+	templates; the library's copy of that object is then never linked.
+*/
+
+#include "ReptAll_Core.cpp"
+#include "ReptAll_Test.h"
+
+template<typename PixelType>
+static void (*GetTestSampleKernel(const SampleKernels *kernels))(const char*, A_long, const SampleBatch*, A_long, PixelType*)
+{
+	if constexpr (std::is_same<PixelType, PF_PixelFloat>::value) {
+		return kernels->sampleFloat;
+	} else if constexpr (std::is_same<PixelType, PF_Pixel16>::value) {
+		return kernels->sample16;
+	} else {
+		return kernels->sample8;
+	}
+}
+
+// Padded level 0 of a test source, as RenderCopies builds it
+struct TestLevel {
+	TestWorld			source;
+	SourceMipPyramid	pyramid;
+
+	PF_Err Build(A_long width, A_long height, A_long depth, A_u_long seed) {
+		FillTestSource(width, height, depth, seed, &source);
+		std::shared_ptr<SourceCoverage> coverage = std::make_shared<SourceCoverage>();
+		PF_Err err = BuildSourceCoverage(&source.world, depth == 32, depth == 16, coverage.get());
+		ERR(BuildSourceMipPyramid(&source.world, depth == 32, depth == 16, 0, coverage, &pyramid));
+		return err;
+	}
+};
+
+// Largest channel difference of two pixels
+template<typename PixelType>
+static double
+GetPixelDifference(
+	const PixelType&	a,
+	const PixelType&	b)
+{
+	return std::max(std::max(fabs((double)a.alpha - b.alpha), fabs((double)a.red - b.red)),
+					std::max(fabs((double)a.green - b.green), fabs((double)a.blue - b.blue)));
+}
+
+// Position of a resolved lane in level texels, false for the zero quad
+static bool
+GetLanePosition(
+	const PF_EffectWorld&	level,
+	A_long					pixelSize,
+	const SampleBatch&		batch,
+	A_long					i,
+	double					*x,
+	double					*y)
+{
+	if (batch.offset[i] == GetSourceNullQuadOffset(level, pixelSize)) {
+		return false;
+	}
+	// Taps are in [-1, w) x [-1, h) and a row holds more than w + 1 texels
+	const std::ptrdiff_t shifted = batch.offset[i] + level.rowbytes + pixelSize;
+	*y = (double)(shifted / level.rowbytes - 1) + batch.fy[i];
+	*x = (double)((shifted % level.rowbytes) / pixelSize - 1) + batch.fx[i];
+	return true;
+}
+
+// Random output -> source map of a copy over output row y that crosses a
+// width x height source somewhere along a 300 pixel span
+static void
+MakeTestHomography(
+	TestRandom&			random,
+	A_long				width,
+	A_long				height,
+	A_long				y,
+	bool				projective,
+	CopyHomography		*h)
+{
+	const double angle = random.Uniform(-M_PI, M_PI);
+	const double scale = random.Uniform(0.3, 3.0);
+	double *m = h->m;
+
+	m[0] = scale * cos(angle);
+	m[1] = -scale * sin(angle);
+	m[3] = scale * sin(angle);
+	m[4] = scale * cos(angle);
+	m[2] = width * random.Uniform(0.2, 0.8) - (m[0] * 150.0 + m[1] * y);
+	m[5] = height * random.Uniform(0.2, 0.8) - (m[3] * 150.0 + m[4] * y);
+	m[6] = projective ? random.Uniform(-1.0e-3, 1.0e-3) : 0.0;
+	m[7] = 0.0;
+	m[8] = projective ? 1.0 - m[6] * 150.0 : 1.0;
+}
+
+// DDA: RenderSpanTmpl steps positions along the row from the start of each
+// SAMPLE_BATCH_MAX batch. Resolving every pixel as a batch of its own
+// evaluates its position directly; lanes must land within single-precision
+// rounding of each other, and composited pixels within one code value
+// (8/16 bpc) or 1e-6 (32 bpc).
+template<typename PixelType, int MaxChannelInt>
+static void
+TestIncrementalSpans(
+	A_long	depth,
+	double	tolerance)
+{
+	const A_long spanWidth = 300;
+	TestLevel source;
+	PF_Err err = source.Build(97, 71, depth, 3);
+	TEST_CHECK(err == PF_Err_NONE, "%d bpc: building the source failed", (int)depth);
+	if (err) {
+		return;
+	}
+
+	PF_EffectWorld *level = &source.pyramid.level[0];
+	const char *srcData = (const char*)level->data;
+	const A_long pixelSize = (A_long)sizeof(PixelType);
+	void (*sampleBatch)(const char*, A_long, const SampleBatch*, A_long, PixelType*) =
+		GetTestSampleKernel<PixelType>(GetSampleKernels());
+	const A_u_long opFixed = OpacityToFixed<MaxChannelInt>(100.0);
+
+	TestRandom random((A_u_long)depth);
+	std::vector<PixelType> stepped(spanWidth), direct(spanWidth);
+	double worstPosition = 0.0, worstPixel = 0.0;
+	A_long lanes = 0;
+
+	for (int n = 0; n < 400; n++) {
+		const A_long y = (A_long)random.Uniform(0.0, 200.0);
+		CopyHomography h;
+		MakeTestHomography(random, level->width, level->height, y, (n & 1) != 0, &h);
+
+		std::fill(stepped.begin(), stepped.end(), PixelType());
+		std::fill(direct.begin(), direct.end(), PixelType());
+		RenderPixelCounts counts;
+		RenderSpanTmpl<PixelType, MaxChannelInt, false, false>(
+			level, stepped.data(), 0, spanWidth, h, y, 100.0, sampleBatch, &counts);
+
+		for (A_long x0 = 0; x0 < spanWidth; x0 += SAMPLE_BATCH_MAX) {
+			const A_long count = std::min<A_long>(SAMPLE_BATCH_MAX, spanWidth - x0);
+			SampleBatch batch;
+			ResolveSampleBatchTmpl<PixelType, MaxChannelInt, false, false>(
+				level, stepped.data(), x0, count, h, y, &batch);
+
+			for (A_long i = 0; i < count; i++) {
+				SampleBatch single;
+				PixelType sample;
+				ResolveSampleBatchTmpl<PixelType, MaxChannelInt, false, false>(
+					level, direct.data(), x0 + i, 1, h, y, &single);
+				SampleResolvedBatchTmpl<PixelType, false>(srcData, level->rowbytes, &single, 1, sampleBatch, &sample);
+				CompositeSamplesTmpl<PixelType, MaxChannelInt, false>(&direct[x0 + i], &sample, 1, 100.0, opFixed);
+
+				double sx, sy, dx, dy;
+				const bool steppedIn = GetLanePosition(*level, pixelSize, batch, i, &sx, &sy);
+				const bool directIn = GetLanePosition(*level, pixelSize, single, 0, &dx, &dy);
+				if (steppedIn && directIn) {
+					worstPosition = std::max(worstPosition, std::max(fabs(sx - dx), fabs(sy - dy)));
+					lanes++;
+				} else if (steppedIn != directIn) {
+					// Only a position on the sample area's edge may flip
+					const double *m = h.m;
+					const double w = m[6] * (x0 + i) + m[7] * y + m[8];
+					const double px = (m[0] * (x0 + i) + m[1] * y + m[2]) / w;
+					const double py = (m[3] * (x0 + i) + m[4] * y + m[5]) / w;
+					const double edge = std::min(std::min(fabs(px + 1.0), fabs(px - level->width)),
+												 std::min(fabs(py + 1.0), fabs(py - level->height)));
+					TEST_CHECK(edge < 1.0e-9, "%d bpc: pixel (%d, %d) is %s the source stepped, %s directly",
+							   (int)depth, (int)(x0 + i), (int)y, steppedIn ? "inside" : "outside",
+							   directIn ? "inside" : "outside");
+				}
+			}
+		}
+
+		for (A_long x = 0; x < spanWidth; x++) {
+			worstPixel = std::max(worstPixel, GetPixelDifference(stepped[x], direct[x]));
+		}
+	}
+
+	TEST_CHECK(lanes > 10000, "%d bpc: only %d lanes sampled the source", (int)depth, (int)lanes);
+	TEST_CHECK(worstPosition <= 1.0e-6, "%d bpc: stepped positions are off by %g px", (int)depth, worstPosition);
+	TEST_CHECK(worstPixel <= tolerance, "%d bpc: stepped pixels differ by %g (tolerance %g)",
+			   (int)depth, worstPixel, tolerance);
+}
+
+// Random premultiplied pixel, some of them empty and some opaque
+template<typename PixelType, int MaxChannelInt>
+static PixelType
+MakeTestBackdropPixel(TestRandom& random)
+{
+	typedef decltype(PixelType().alpha) ChannelType;
+	const double maxChan = MaxChannelInt;
+	const A_u_long kind = random.Next() % 4;
+	const double alpha = kind == 0 ? 0.0 : kind == 1 ? maxChan : random.Uniform(0.0, maxChan);
+	PixelType p;
+
+	if constexpr (MaxChannelInt == 1) {
+		p.alpha = (ChannelType)alpha;
+		p.red = (ChannelType)random.Uniform(0.0, alpha);
+		p.green = (ChannelType)random.Uniform(0.0, alpha);
+		p.blue = (ChannelType)random.Uniform(0.0, alpha);
+	} else {
+		p.alpha = (ChannelType)alpha;
+		p.red = (ChannelType)(random.Next() % (p.alpha + 1));
+		p.green = (ChannelType)(random.Next() % (p.alpha + 1));
+		p.blue = (ChannelType)(random.Next() % (p.alpha + 1));
+	}
+	return p;
+}
+
+// Shifted copies: a translated copy that ClassifyCopyTranslation marks
+// shifted must render as the bilinear (or, in draft, nearest) kernels
+// render it with the translation ignored. Integer shifts read the texels
+// the kernels would and must match exactly; subpixel shifts filter with
+// the same weights in a different order and must agree within one code
+// value (8/16 bpc) or 1e-6 (32 bpc).
+template<typename PixelType, int MaxChannelInt, bool FrontToBack, bool Nearest>
+static void
+TestShiftedCopies(
+	A_long	depth,
+	double	tolerance)
+{
+	const A_long outWidth = 160;
+	const A_long outHeight = 120;
+	const char *mode = Nearest ? "nearest" : FrontToBack ? "under" : "over";
+	TestLevel source;
+	PF_Err err = source.Build(97, 71, depth, 5);
+	TEST_CHECK(err == PF_Err_NONE, "%d bpc: building the source failed", (int)depth);
+	if (err) {
+		return;
+	}
+
+	void (*sampleBatch)(const char*, A_long, const SampleBatch*, A_long, PixelType*) =
+		GetTestSampleKernel<PixelType>(GetSampleKernels());
+	const PF_LRect outputRect = {0, 0, outWidth, outHeight};
+
+	TestRandom random((A_u_long)depth * 4 + (FrontToBack ? 1 : 0) + (Nearest ? 2 : 0));
+	std::vector<PixelType> backdrop((size_t)outWidth * outHeight), shifted, generic;
+	double worstInteger = 0.0, worstSubpixel = 0.0;
+	A_long composited = 0;
+
+	for (int n = 0; n < 200; n++) {
+		const bool whole = (n & 1) != 0;
+		CopyRenderInfo info = CopyRenderInfo();
+		info.source = &source.pyramid.level[0];
+		info.coverage = source.pyramid.coverage[0].get();
+		info.area = GetSourceSampleArea(info.source->width, info.source->height, &info.coverage->bounds);
+		info.opacity = (n % 3) ? 100.0 : random.Uniform(0.0, 100.0);
+
+		// Copies partly off the output as well as inside it
+		const double tx = floor(random.Uniform(-80.0, 130.0)) + (whole ? 0.0 : random.Uniform(0.01, 0.99));
+		const double ty = floor(random.Uniform(-60.0, 100.0)) + (whole ? 0.0 : random.Uniform(0.01, 0.99));
+		const CopyHomography h = {{1.0, 0.0, -tx, 0.0, 1.0, -ty, 0.0, 0.0, 1.0}};
+		info.homography = h;
+		ComputeCopyLayerBounds(info.homography, info.area, &info.rect);
+		IntersectRect(outputRect, &info.rect);
+		if (IsRectEmpty(info.rect)) {
+			continue;
+		}
+
+		ClassifyCopyTranslation(Nearest, &info);
+		const A_long expected = (whole || Nearest) ? COPY_TRANSLATION_INTEGER : COPY_TRANSLATION_SUBPIXEL;
+		TEST_CHECK(info.translation == expected, "%d bpc %s: shift (%g, %g) classified as %d, not %d",
+				   (int)depth, mode, tx, ty, (int)info.translation, (int)expected);
+
+		for (size_t i = 0; i < backdrop.size(); i++) {
+			backdrop[i] = MakeTestBackdropPixel<PixelType, MaxChannelInt>(random);
+		}
+		shifted = backdrop;
+		generic = backdrop;
+
+		CopyRenderInfo reference = info;
+		reference.translation = COPY_TRANSLATION_NONE;
+		RenderPixelCounts counts;
+		for (A_long y = info.rect.top; y < info.rect.bottom; y++) {
+			RenderCopyRowTmpl<PixelType, MaxChannelInt, FrontToBack, Nearest>(
+				info, &shifted[(size_t)y * outWidth], y, sampleBatch, &counts);
+			RenderCopyRowTmpl<PixelType, MaxChannelInt, FrontToBack, Nearest>(
+				reference, &generic[(size_t)y * outWidth], y, sampleBatch, &counts);
+		}
+		composited += counts.composited;
+
+		double worst = 0.0;
+		for (size_t i = 0; i < shifted.size(); i++) {
+			worst = std::max(worst, GetPixelDifference(shifted[i], generic[i]));
+		}
+		double& worstKind = (info.translation == COPY_TRANSLATION_INTEGER) ? worstInteger : worstSubpixel;
+		worstKind = std::max(worstKind, worst);
+	}
+
+	TEST_CHECK(composited > 100000, "%d bpc %s: only %d pixels composited", (int)depth, mode, (int)composited);
+	TEST_CHECK(worstInteger == 0.0, "%d bpc %s: integer shifts differ by %g", (int)depth, mode, worstInteger);
+	TEST_CHECK(worstSubpixel <= tolerance, "%d bpc %s: subpixel shifts differ by %g (tolerance %g)",
+			   (int)depth, mode, worstSubpixel, tolerance);
+}
+
+template<typename PixelType, int MaxChannelInt>
+static void
+TestShiftedCopiesAllModes(
+	A_long	depth,
+	double	tolerance)
+{
+	TestShiftedCopies<PixelType, MaxChannelInt, false, false>(depth, tolerance);
+	TestShiftedCopies<PixelType, MaxChannelInt, true, false>(depth, tolerance);
+	TestShiftedCopies<PixelType, MaxChannelInt, false, true>(depth, tolerance);
+}
+
+int
+main(void)
+{
+	TestIncrementalSpans<PF_Pixel, PF_MAX_CHAN8>(8, 1.0);
+	TestIncrementalSpans<PF_Pixel16, PF_MAX_CHAN16>(16, 1.0);
+	TestIncrementalSpans<PF_PixelFloat, 1>(32, 1.0e-6);
+
+	TestShiftedCopiesAllModes<PF_Pixel, PF_MAX_CHAN8>(8, 1.0);
+	TestShiftedCopiesAllModes<PF_Pixel16, PF_MAX_CHAN16>(16, 1.0);
+	TestShiftedCopiesAllModes<PF_PixelFloat, 1>(32, 1.0e-6);
+
+	return FinishTest("render_paths");
+}
@@ -0,0 +1,116 @@
+/*******************************************************************/
+/*                                                                 */
+/*                      ADOBE CONFIDENTIAL                         */
+/*                   _ _ _ _ _ _ _ _ _ _ _ _ _                     */
+/*                                                                 */
+/* Copyright 2007-2023 Adobe Inc.                                  */
+/* All Rights Reserved.                                            */
+/*                                                                 */
+/* NOTICE:  All information contained herein is, and remains the   */
+/* property of Adobe Inc. and its suppliers, if                    */
+/* any.  The intellectual and technical concepts contained         */
+/* herein are proprietary to Adobe Inc. and its                    */
+/* suppliers and may be covered by U.S. and Foreign Patents,       */
+/* patents in process, and are protected by trade secret or        */
+/* copyright law.  Dissemination of this information or            */
+/* reproduction of this material is strictly forbidden unless      */
+/* prior written permission is obtained from Adobe Inc.            */
+/* Incorporated.                                                   */
+/*                                                                 */
+/*******************************************************************/
+
+
+/*
+	ReptAll_TestSampling.cpp
+
+	The dispatched bilinear kernels (SSE4.1, AVX2 or NEON) against the
+	scalar reference kernels on random batches at 8, 16 and 32 bpc: every
+	output pixel must match bit for bit, including the scalar tails of
+	batches whose length is not a multiple of the vector width.
+*/
+
+#include "ReptAll_Test.h"
+#include "ReptAll_Sampling.h"
+#include <cstring>
+
+#define TEST_SOURCE_WIDTH	61
+#define TEST_SOURCE_HEIGHT	37
+#define TEST_BATCHES		20000
+
+// Random channels: the full range for integers, and for float values
+// slightly outside [0, 1] as well (overbright and negative pixels)
+template<typename PixelType, int MaxChannelInt>
+static void
+FillRandomPixels(
+	TestRandom&		random,
+	PixelType		*pixels,
+	size_t			count)
+{
+	typedef decltype(pixels->alpha) ChannelType;
+
+	for (size_t i = 0; i < count; i++) {
+		ChannelType *channel = &pixels[i].alpha;
+		for (int c = 0; c < 4; c++) {
+			if constexpr (MaxChannelInt == 1) {
+				channel[c] = (ChannelType)random.Uniform(-0.25, 1.5);
+			} else {
+				channel[c] = (ChannelType)(random.Next() % (MaxChannelInt + 1));
+			}
+		}
+	}
+}
+
+template<typename PixelType, int MaxChannelInt>
+static void
+TestSampleKernel(
+	A_long	depth,
+	void	(*kernel)(const char*, A_long, const SampleBatch*, A_long, PixelType*),
+	void	(*reference)(const char*, A_long, const SampleBatch*, A_long, PixelType*))
+{
+	const A_long rowPixels = TEST_SOURCE_WIDTH + 1;     // quads at x < width read x + 1
+	const A_long rowbytes = rowPixels * (A_long)sizeof(PixelType);
+	std::vector<PixelType> source((size_t)rowPixels * (TEST_SOURCE_HEIGHT + 1));
+	TestRandom random((A_u_long)depth);
+	FillRandomPixels<PixelType, MaxChannelInt>(random, source.data(), source.size());
+
+	A_long mismatches = 0;
+	for (int n = 0; n < TEST_BATCHES; n++) {
+		SampleBatch batch;
+		const A_long count = 1 + (A_long)(random.Next() % SAMPLE_BATCH_MAX);
+
+		for (A_long i = 0; i < count; i++) {
+			const A_long x = (A_long)(random.Next() % TEST_SOURCE_WIDTH);
+			const A_long y = (A_long)(random.Next() % TEST_SOURCE_HEIGHT);
+			batch.offset[i] = (std::ptrdiff_t)y * rowbytes + (std::ptrdiff_t)x * (std::ptrdiff_t)sizeof(PixelType);
+			// Some lanes on exact texels or edges, as resolved batches have
+			const A_u_long kind = random.Next() % 8;
+			batch.fx[i] = kind == 0 ? 0.0f : (float)random.Uniform(0.0, 1.0);
+			batch.fy[i] = kind == 1 ? 0.0f : (float)random.Uniform(0.0, 1.0);
+		}
+
+		PixelType out[SAMPLE_BATCH_MAX], expected[SAMPLE_BATCH_MAX];
+		kernel((const char*)source.data(), rowbytes, &batch, count, out);
+		reference((const char*)source.data(), rowbytes, &batch, count, expected);
+		if (memcmp(out, expected, count * sizeof(PixelType)) != 0) {
+			mismatches++;
+		}
+	}
+
+	TEST_CHECK(mismatches == 0, "%d bpc: %d of %d batches differ from the scalar kernel",
+			   (int)depth, (int)mismatches, TEST_BATCHES);
+}
+
+int
+main(void)
+{
+	const SampleKernels *kernels = GetSampleKernels();
+	const SampleKernels *scalar = GetScalarSampleKernels();
+	static const char *levels[] = {"scalar", "SSE4.1", "AVX2", "NEON"};
+	printf("sampling: dispatched kernels are %s\n", levels[kernels->level]);
+
+	TestSampleKernel<PF_Pixel, PF_MAX_CHAN8>(8, kernels->sample8, scalar->sample8);
+	TestSampleKernel<PF_Pixel16, PF_MAX_CHAN16>(16, kernels->sample16, scalar->sample16);
+	TestSampleKernel<PF_PixelFloat, 1>(32, kernels->sampleFloat, scalar->sampleFloat);
+
+	return FinishTest("sampling");
+}